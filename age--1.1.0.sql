@@ -4084,6 +4084,15 @@ STABLE
 PARALLEL SAFE
 AS 'MODULE_PATHNAME';
 
+-- planner support function for the VLE functions, for their row estimates
+CREATE FUNCTION ag_catalog.age_vle_support(internal)
+RETURNS internal
+LANGUAGE C
+IMMUTABLE
+STRICT
+PARALLEL SAFE
+AS 'MODULE_PATHNAME';
+
 -- original VLE function definition
 CREATE FUNCTION ag_catalog.age_vle(IN agtype, IN agtype, IN agtype, IN agtype,
                                    IN agtype, IN agtype, IN agtype,
@@ -4092,7 +4101,8 @@ RETURNS SETOF agtype
 LANGUAGE C
 STABLE
 CALLED ON NULL INPUT
-PARALLEL UNSAFE
+PARALLEL SAFE
+SUPPORT ag_catalog.age_vle_support
 AS 'MODULE_PATHNAME';
 
 -- This is an overloaded function definition to allow for the VLE local context
@@ -4104,9 +4114,58 @@ RETURNS SETOF agtype
 LANGUAGE C
 STABLE
 CALLED ON NULL INPUT
-PARALLEL UNSAFE
+PARALLEL SAFE
+SUPPORT ag_catalog.age_vle_support
+AS 'MODULE_PATHNAME';
+
+-- This overload adds the path mode, for shortestPath() and allShortestPaths().
+CREATE FUNCTION ag_catalog.age_vle(IN agtype, IN agtype, IN agtype, IN agtype,
+                                   IN agtype, IN agtype, IN agtype, IN agtype,
+                                   IN agtype, OUT edges agtype)
+RETURNS SETOF agtype
+LANGUAGE C
+STABLE
+CALLED ON NULL INPUT
+PARALLEL SAFE
+SUPPORT ag_catalog.age_vle_support
+AS 'MODULE_PATHNAME';
+
+-- This overload adds a row bound, which the planner passes in from a LIMIT.
+CREATE FUNCTION ag_catalog.age_vle(IN agtype, IN agtype, IN agtype, IN agtype,
+                                   IN agtype, IN agtype, IN agtype, IN agtype,
+                                   IN agtype, IN agtype, OUT edges agtype)
+RETURNS SETOF agtype
+LANGUAGE C
+STABLE
+CALLED ON NULL INPUT
+PARALLEL SAFE
+SUPPORT ag_catalog.age_vle_support
+AS 'MODULE_PATHNAME';
+
+-- This overload adds the prototype the intermediate vertices must match.
+CREATE FUNCTION ag_catalog.age_vle(IN agtype, IN agtype, IN agtype, IN agtype,
+                                   IN agtype, IN agtype, IN agtype, IN agtype,
+                                   IN agtype, IN agtype, IN agtype,
+                                   OUT edges agtype)
+RETURNS SETOF agtype
+LANGUAGE C
+STABLE
+CALLED ON NULL INPUT
+PARALLEL SAFE
+SUPPORT ag_catalog.age_vle_support
 AS 'MODULE_PATHNAME';
 
+-- statistics of this backend's VLE local context cache
+CREATE FUNCTION ag_catalog.vle_cache_stats(OUT cache_size integer,
+                                           OUT num_cached bigint,
+                                           OUT hits bigint,
+                                           OUT misses bigint,
+                                           OUT evictions bigint)
+RETURNS record
+LANGUAGE c
+VOLATILE
+AS 'MODULE_PATHNAME', 'age_vle_cache_stats';
+
 -- function to build an edge for a VLE match
 CREATE FUNCTION ag_catalog.age_build_vle_match_edge(agtype, agtype)
 RETURNS agtype
@@ -4115,6 +4174,23 @@ STABLE
 PARALLEL SAFE
 AS 'MODULE_PATHNAME';
 
+-- function to build a vertex for matching the intermediate vertices of a VLE
+CREATE FUNCTION ag_catalog.age_build_vle_match_vertex(agtype, agtype)
+RETURNS agtype
+LANGUAGE C
+STABLE
+PARALLEL SAFE
+AS 'MODULE_PATHNAME';
+
+-- function to turn a value compared to a vle end vertex id into its end vertex
+CREATE FUNCTION ag_catalog.age_vle_end_vertex_id(agtype)
+RETURNS agtype
+LANGUAGE C
+IMMUTABLE
+RETURNS NULL ON NULL INPUT
+PARALLEL SAFE
+AS 'MODULE_PATHNAME';
+
 -- function to match a terminal vle edge
 CREATE FUNCTION ag_catalog.age_match_vle_terminal_edge(variadic "any")
 RETURNS boolean
@@ -4198,11 +4274,21 @@ IMMUTABLE
 PARALLEL SAFE
 AS 'MODULE_PATHNAME', 'agtype_range';
 
+-- planner support function for unnest, for its row estimates
+CREATE FUNCTION ag_catalog.agtype_unnest_support(internal)
+RETURNS internal
+LANGUAGE c
+IMMUTABLE
+STRICT
+PARALLEL SAFE
+AS 'MODULE_PATHNAME';
+
 CREATE FUNCTION ag_catalog.unnest(agtype, block_types boolean = false)
     RETURNS SETOF agtype
     LANGUAGE c
     IMMUTABLE
 PARALLEL SAFE
+SUPPORT ag_catalog.agtype_unnest_support
 AS 'MODULE_PATHNAME', 'agtype_unnest';
 
 CREATE FUNCTION ag_catalog.vertex_stats(agtype, agtype)
@@ -4212,6 +4298,14 @@ STABLE
 PARALLEL SAFE
 AS 'MODULE_PATHNAME', 'age_vertex_stats';
 
+CREATE FUNCTION ag_catalog.weighted_shortest_path(agtype, agtype, agtype,
+                                                  agtype, agtype)
+RETURNS agtype
+LANGUAGE c
+STABLE
+PARALLEL SAFE
+AS 'MODULE_PATHNAME', 'age_weighted_shortest_path';
+
 CREATE FUNCTION ag_catalog.delete_global_graphs(agtype)
 RETURNS boolean
 LANGUAGE c
@@ -4219,6 +4313,31 @@ VOLATILE
 PARALLEL SAFE
 AS 'MODULE_PATHNAME', 'age_delete_global_graphs';
 
+CREATE FUNCTION ag_catalog.save_graph_snapshot(graph_name name)
+RETURNS boolean
+LANGUAGE c
+VOLATILE
+AS 'MODULE_PATHNAME', 'age_save_graph_snapshot';
+
+-- it writes files into the data directory, so it isn't for everyone
+REVOKE EXECUTE ON FUNCTION ag_catalog.save_graph_snapshot(name) FROM PUBLIC;
+
+CREATE FUNCTION ag_catalog.global_graph_stats(OUT graph_name text,
+                                              OUT graph_oid oid,
+                                              OUT bytes_used bigint,
+                                              OUT num_vertices bigint,
+                                              OUT num_edges bigint,
+                                              OUT loaded_at timestamptz,
+                                              OUT load_time_ms double precision,
+                                              OUT hits bigint)
+RETURNS SETOF record
+LANGUAGE c
+VOLATILE
+AS 'MODULE_PATHNAME', 'age_global_graph_stats';
+
+CREATE VIEW ag_catalog.ag_global_graph_stats AS
+SELECT * FROM ag_catalog.global_graph_stats();
+
 --
 -- End
 --
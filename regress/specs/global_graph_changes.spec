@@ -0,0 +1,30 @@
+# A backend that has never loaded a graph must still count its writes, so that
+# the GRAPH global contexts of other backends are rebuilt.
+
+setup
+{
+    SELECT ag_catalog.create_graph('iso_changes');
+    SELECT * FROM ag_catalog.cypher('iso_changes', $$CREATE (:v)-[:e]->(:v)$$) AS (a ag_catalog.agtype);
+}
+
+teardown
+{
+    SELECT ag_catalog.drop_graph('iso_changes', true);
+}
+
+session s1
+setup { SET search_path = ag_catalog, "$user", public; }
+step s1_count { SELECT * FROM cypher('iso_changes', $$MATCH p=(:v)-[*]->(:v) RETURN count(p)$$) AS (c agtype); }
+
+session s2
+setup { SET search_path = ag_catalog, "$user", public; }
+step s2_create { SELECT * FROM cypher('iso_changes', $$CREATE (:v)-[:e]->(:v)$$) AS (a agtype); }
+step s2_delete { SELECT * FROM cypher('iso_changes', $$MATCH (x:v)-[r:e]->(y:v) DETACH DELETE y$$) AS (a agtype); }
+step s2_truncate { TRUNCATE iso_changes.e; }
+
+# s2 creates and deletes without a context of its own
+permutation s1_count s2_create s1_count
+permutation s1_count s2_create s1_count s2_delete s1_count
+
+# TRUNCATE of a label table invalidates the graph that owns it
+permutation s1_count s2_truncate s1_count
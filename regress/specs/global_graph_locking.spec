@@ -0,0 +1,29 @@
+# Loading a graph takes AccessShareLock on its label tables, so it doesn't wait
+# for open transactions that write to them, and it doesn't see their changes
+# until they commit.
+
+setup
+{
+    SELECT ag_catalog.create_graph('iso_locking');
+    SELECT * FROM ag_catalog.cypher('iso_locking', $$CREATE (:v)-[:e]->(:v)$$) AS (a ag_catalog.agtype);
+}
+
+teardown
+{
+    SELECT ag_catalog.drop_graph('iso_locking', true);
+}
+
+session s1
+setup { SET search_path = ag_catalog, "$user", public; }
+step s1_count { SELECT * FROM cypher('iso_locking', $$MATCH p=(:v)-[*]->(:v) RETURN count(p)$$) AS (c agtype); }
+
+session s2
+setup { SET search_path = ag_catalog, "$user", public; }
+step s2_begin { BEGIN; }
+step s2_create { SELECT * FROM cypher('iso_locking', $$CREATE (:v)-[:e]->(:v)$$) AS (a agtype); }
+step s2_commit { COMMIT; }
+
+# s1 loads the graph while s2's insert is in progress
+permutation s2_begin s2_create s1_count s2_commit s1_count
+# s1 has the graph loaded when s2 starts writing
+permutation s1_count s2_begin s2_create s1_count s2_commit s1_count
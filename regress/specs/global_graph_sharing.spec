@@ -0,0 +1,37 @@
+# With age in shared_preload_libraries, a loaded graph is published as a shared
+# image that other backends attach to, until the graph changes.
+
+setup
+{
+    SELECT ag_catalog.create_graph('iso_sharing');
+    SELECT * FROM ag_catalog.cypher('iso_sharing', $$CREATE (a:v)-[:e]->(b:v) SET a.n = 1, b.n = 2$$) AS (a ag_catalog.agtype);
+}
+
+teardown
+{
+    SELECT ag_catalog.drop_graph('iso_sharing', true);
+}
+
+session s1
+setup { SET search_path = ag_catalog, "$user", public; }
+step s1_paths { SELECT * FROM cypher('iso_sharing', $$MATCH p=(a:v)-[*]->(b:v) RETURN a.n, b.n ORDER BY a.n$$) AS (a agtype, b agtype); }
+
+session s2
+setup { SET search_path = ag_catalog, "$user", public; }
+step s2_paths { SELECT * FROM cypher('iso_sharing', $$MATCH p=(a:v)-[*]->(b:v) RETURN a.n, b.n ORDER BY a.n$$) AS (a agtype, b agtype); }
+step s2_create { SELECT * FROM cypher('iso_sharing', $$CREATE (a:v)-[:e]->(b:v) SET a.n = 3, b.n = 4$$) AS (a agtype); }
+
+session s3
+setup { SET search_path = ag_catalog, "$user", public; }
+step s3_paths { SELECT * FROM cypher('iso_sharing', $$MATCH p=(a:v)-[*]->(b:v) RETURN a.n, b.n ORDER BY a.n$$) AS (a agtype, b agtype); }
+step s3_begin { BEGIN; }
+step s3_create { SELECT * FROM cypher('iso_sharing', $$CREATE (a:v)-[:e]->(b:v) SET a.n = 5, b.n = 6$$) AS (a agtype); }
+step s3_commit { COMMIT; }
+
+# s2 attaches to the image s1 published, properties included
+permutation s1_paths s2_paths
+# the image is stale once s2 writes, for s1, s2 and a backend new to the graph
+permutation s1_paths s2_paths s2_create s1_paths s2_paths s3_paths
+# images are keyed on the graph's changes, so one loaded while a write is in
+# progress isn't used once the write commits
+permutation s3_begin s3_create s1_paths s2_paths s3_commit s2_paths s1_paths
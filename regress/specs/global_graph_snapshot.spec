@@ -0,0 +1,33 @@
+# A snapshot file is only used while its graph is unchanged, including by
+# backends that write to the graph without having loaded it.
+
+setup
+{
+    SELECT ag_catalog.create_graph('iso_snapshot');
+    SELECT * FROM ag_catalog.cypher('iso_snapshot', $$CREATE (:v)-[:e]->(:v)$$) AS (a ag_catalog.agtype);
+}
+
+teardown
+{
+    SELECT ag_catalog.drop_graph('iso_snapshot', true);
+}
+
+session s1
+setup { SET search_path = ag_catalog, "$user", public; }
+step s1_save { SELECT save_graph_snapshot('iso_snapshot') AS saved; }
+step s1_files { SELECT count(*) AS files FROM pg_ls_dir('age_graph_snapshots'); }
+
+session s2
+setup { SET search_path = ag_catalog, "$user", public; }
+step s2_create { SELECT * FROM cypher('iso_snapshot', $$CREATE (:v)-[:e]->(:v)$$) AS (a agtype); }
+
+session s3
+setup { SET search_path = ag_catalog, "$user", public; }
+step s3_count { SELECT * FROM cypher('iso_snapshot', $$MATCH p=(:v)-[*]->(:v) RETURN count(p)$$) AS (c agtype); }
+
+# s2 writes from a fresh session, so s3 can't use the saved file
+permutation s1_save s2_create s3_count
+# nothing changed, so s3 loads the graph from the saved file
+permutation s1_save s3_count
+# the files saved above were deleted when their graphs were dropped
+permutation s1_files s1_save s1_files
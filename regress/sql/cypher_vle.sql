@@ -96,14 +96,104 @@ SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin)-[*1..200]-(v:end) RETURN co
 SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin)-[:edge*]-(v:end) RETURN count(*) $$) AS (e agtype);
 SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin)-[:edge* {name: "main edge"}]-(v:end) RETURN count(*) $$) AS (e agtype);
 SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin)-[* {name: "main edge"}]-(v:end) RETURN count(*) $$) AS (e agtype);
+-- Should find 4, nested property constraints are contained
+SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin)-[* {dangerous: {type: "all"}}]->(v:end) RETURN count(*) $$) AS (e agtype);
 -- Each should find 1
 SELECT * FROM cypher('cypher_vle', $$MATCH ()<-[*4..4 {name: "main edge"}]-() RETURN count(*) $$) AS (e agtype);
 SELECT * FROM cypher('cypher_vle', $$MATCH (u)<-[*4..4 {name: "main edge"}]-() RETURN count(*) $$) AS (e agtype);
 SELECT * FROM cypher('cypher_vle', $$MATCH ()<-[*4..4 {name: "main edge"}]-(v) RETURN count(*) $$) AS (e agtype);
+-- Each should find 0, the end is at least 3 edges away, or 4 along :edge
+SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin)-[*1..2]->(v:end) RETURN count(*) $$) AS (e agtype);
+SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin)-[:edge*1..3]->(v:end) RETURN count(*) $$) AS (e agtype);
+-- shortestPath should find 1 path, of length 3
+SELECT * FROM cypher('cypher_vle', $$MATCH p = shortestPath((u:begin)-[*]->(v:end)) RETURN size(relationships(p)) $$) AS (e agtype);
+-- allShortestPaths should find 2
+SELECT * FROM cypher('cypher_vle', $$MATCH p = allShortestPaths((u:begin)-[*]->(v:end)) RETURN count(*) $$) AS (e agtype);
+-- allShortestPaths should find 1, of length 2
+SELECT * FROM cypher('cypher_vle', $$MATCH p = allShortestPaths((u:begin)-[*]-(v:end)) RETURN size(relationships(p)) $$) AS (e agtype);
+-- Should find 0, there is no shortest path within the bound
+SELECT * FROM cypher('cypher_vle', $$MATCH shortestPath((u:begin)-[*..2]->(v:end)) RETURN count(*) $$) AS (e agtype);
+-- Should error, the end vertex is null for some rows, whether or not the VLE context is reused
+SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin), (x) OPTIONAL MATCH (x)-[:edge]->(w:end) MATCH p = shortestPath((u)-[*]->(w)) RETURN count(*) $$) AS (e agtype);
+-- The least cost path by number should be 3 edges long, costing 4
+SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin), (v:end) RETURN size(relationships(weighted_shortest_path(u, v, null, 'number'))) $$) AS (e agtype);
+-- Along :edge only it should be 4 edges long
+SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin), (v:end) RETURN size(relationships(weighted_shortest_path(u, v, 'edge', 'number'))) $$) AS (e agtype);
+-- Should be null, there is no path back along :edge
+SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin), (v:end) RETURN weighted_shortest_path(v, u, 'edge', 'number') $$) AS (e agtype);
+-- EXISTS() of a VLE only checks reachability. Should find 1, 0, 1 and 0
+SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin), (v:end) WHERE EXISTS((u)-[*]->(v)) RETURN count(*) $$) AS (e agtype);
+SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin), (v:end) WHERE EXISTS((v)-[:edge*]->(u)) RETURN count(*) $$) AS (e agtype);
+SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin), (v:end) WHERE EXISTS((u)-[*5..]->(v)) RETURN count(*) $$) AS (e agtype);
+SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin), (v:end) WHERE EXISTS((u)-[*1..2]->(v)) RETURN count(*) $$) AS (e agtype);
 -- Each should find 2922
 SELECT * FROM cypher('cypher_vle', $$MATCH ()-[*]->() RETURN count(*) $$) AS (e agtype);
 SELECT * FROM cypher('cypher_vle', $$MATCH (u)-[*]->() RETURN count(*) $$) AS (e agtype);
 SELECT * FROM cypher('cypher_vle', $$MATCH ()-[*]->(v) RETURN count(*) $$) AS (e agtype);
+-- Should find 2922, with the VLE kept out of the parallel workers as the global graph isn't shared
+SET parallel_setup_cost = 0;
+SET parallel_tuple_cost = 0;
+SET min_parallel_table_scan_size = 0;
+SET max_parallel_workers_per_gather = 2;
+SELECT * FROM cypher('cypher_vle', $$MATCH p=()-[*]->() RETURN count(p) $$) AS (e agtype);
+RESET parallel_setup_cost;
+RESET parallel_tuple_cost;
+RESET min_parallel_table_scan_size;
+RESET max_parallel_workers_per_gather;
+-- Should find 400 with one cached VLE local context
+SET age.vle_local_context_cache_size = 1;
+SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin)-[*]->(v:end) RETURN count(*) $$) AS (e agtype);
+SELECT cache_size, num_cached FROM vle_cache_stats();
+-- Should find 400 with the VLE local context cache turned off
+SET age.vle_local_context_cache_size = 0;
+SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin)-[*]->(v:end) RETURN count(*) $$) AS (e agtype);
+SELECT cache_size, num_cached FROM vle_cache_stats();
+RESET age.vle_local_context_cache_size;
+-- EXPLAIN output, reduced to the part of each line that matches a pattern
+CREATE FUNCTION explain_match(query text, pattern text) RETURNS SETOF text
+LANGUAGE plpgsql AS $fn$
+DECLARE
+    ln text;
+BEGIN
+    FOR ln IN EXECUTE query
+    LOOP
+        IF ln ~ pattern THEN
+            RETURN NEXT substring(ln FROM pattern);
+        END IF;
+    END LOOP;
+END;
+$fn$;
+-- Should find 3 and 2, with the row bound from the LIMIT passed to the VLE
+SELECT count(*) FROM cypher('cypher_vle', $$MATCH p=(u:begin)-[*]->() RETURN p LIMIT 3 $$) AS (p agtype);
+SELECT count(*) FROM cypher('cypher_vle', $$MATCH p=(u:begin)-[*]->() RETURN p SKIP 5 LIMIT 2 $$) AS (p agtype);
+-- the bounded age_vle call takes the LIMIT plus the SKIP as its last argument
+SELECT * FROM explain_match($q$EXPLAIN VERBOSE SELECT * FROM cypher('cypher_vle', $$MATCH p=(u:begin)-[*]->() RETURN p LIMIT 3 $$) AS (p agtype)$q$, 'age_vle\(.*, (''3''::agtype)\)$');
+SELECT * FROM explain_match($q$EXPLAIN VERBOSE SELECT * FROM cypher('cypher_vle', $$MATCH p=(u:begin)-[*]->() RETURN p SKIP 5 LIMIT 2 $$) AS (p agtype)$q$, 'age_vle\(.*, (''7''::agtype)\)$');
+-- Should find 400, the LIMIT isn't passed as the end vertex filters the rows
+SELECT count(*) FROM cypher('cypher_vle', $$MATCH p=(u:begin)-[*]->(v:end) RETURN p LIMIT 1000 $$) AS (p agtype);
+SELECT * FROM explain_match($q$EXPLAIN VERBOSE SELECT * FROM cypher('cypher_vle', $$MATCH p=(u:begin)-[*]->(v:end) RETURN p LIMIT 1000 $$) AS (p agtype)$q$, 'age_vle\(.*, (''1000''::agtype)\)$');
+-- Should find 1710, 1710 and 1710, with the end vertex passed to the VLE in place of the anonymous start vertex
+SELECT * FROM cypher('cypher_vle', $$MATCH ()-[*]->(v:end) RETURN count(*) $$) AS (e agtype);
+SELECT * FROM cypher('cypher_vle', $$MATCH p=()-[*]->(:end) RETURN count(p) $$) AS (e agtype);
+SELECT * FROM cypher('cypher_vle', $$MATCH (v:end) MATCH ()-[*]->(v) RETURN count(*) $$) AS (e agtype);
+-- Should find 5 and 2922, with the start vertices walked again for each end vertex
+SELECT * FROM cypher('cypher_vle', $$MATCH ()-[*0..1]->(v:end) RETURN count(*) $$) AS (e agtype);
+SELECT * FROM cypher('cypher_vle', $$MATCH (v) MATCH ()-[*]->(v) RETURN count(*) $$) AS (e agtype);
+SELECT * FROM explain_match($q$EXPLAIN VERBOSE SELECT * FROM cypher('cypher_vle', $$MATCH ()-[*]->(v:end) RETURN count(*) $$) AS (e agtype)$q$, 'age_vle\(''"cypher_vle"''::agtype, (NULL::agtype), ');
+-- Should find 44, 2, and 0 with every intermediate vertex matching the pattern
+SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin)-[* (:middle)]->(v:end) RETURN count(*) $$) AS (e agtype);
+SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin)-[*..3 (:middle)]->(v:end) RETURN count(*) $$) AS (e agtype);
+SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin)-[* (:middle {unknown: 1})]->(v:end) RETURN count(*) $$) AS (e agtype);
+-- Should find 400, 400, 400, 0, 400, and 400, with the end vertex id from the WHERE clause passed to the VLE
+SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin)-[*]->(v) WHERE id(v) = 1688849860263937 RETURN count(*) $$) AS (e agtype);
+PREPARE vle_end_id(agtype) AS SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin)-[*]->(v) WHERE $end_id = id(v) RETURN count(*) $$, $1) AS (e agtype);
+EXECUTE vle_end_id('{"end_id": 1688849860263937}');
+EXECUTE vle_end_id('{"end_id": 1688849860263937.0}');
+EXECUTE vle_end_id('{"end_id": "1688849860263937"}');
+-- a numeric isn't passed as an end vertex id, but it still matches, before and after an integer
+EXECUTE vle_end_id('{"end_id": 1688849860263937::numeric}');
+EXECUTE vle_end_id('{"end_id": 1688849860263937}');
+DEALLOCATE vle_end_id;
 -- Should find 2
 SELECT * FROM cypher('cypher_vle', $$MATCH (u:begin)<-[e*]-(v:end) RETURN e $$) AS (e agtype);
 -- Should find 5
@@ -290,11 +380,137 @@ DROP FUNCTION show_list_use_vle;
 
 SELECT drop_graph('mygraph', true);
 
+--
+-- VLE after writes, the global graph is patched with the logged changes
+--
+SELECT create_graph('vle_delta');
+SELECT * FROM cypher('vle_delta', $$CREATE (:v {n: 1})-[:e]->(:v {n: 2})$$) AS (a agtype);
+BEGIN;
+SELECT * FROM cypher('vle_delta', $$MATCH p=(:v {n: 1})-[*]->() RETURN count(p)$$) AS (c agtype);
+SELECT * FROM cypher('vle_delta', $$MATCH (a:v {n: 2}) CREATE (a)-[:e]->(:v {n: 3})$$) AS (a agtype);
+SELECT * FROM cypher('vle_delta', $$MATCH p=(:v {n: 1})-[*]->() RETURN count(p)$$) AS (c agtype);
+SELECT * FROM cypher('vle_delta', $$MATCH ()-[e:e]->(:v {n: 3}) SET e.w = 5$$) AS (a agtype);
+SELECT * FROM cypher('vle_delta', $$MATCH p=(:v {n: 2})-[*{w: 5}]->() RETURN count(p)$$) AS (c agtype);
+SELECT * FROM cypher('vle_delta', $$MATCH (:v {n: 2})-[e]->() DELETE e$$) AS (a agtype);
+SELECT * FROM cypher('vle_delta', $$MATCH p=(:v {n: 1})-[*]->() RETURN count(p)$$) AS (c agtype);
+ROLLBACK;
+-- the rolled back changes must not be seen
+SELECT * FROM cypher('vle_delta', $$MATCH p=(:v {n: 1})-[*]->() RETURN count(p)$$) AS (c agtype);
+-- committed changes are seen
+SELECT * FROM cypher('vle_delta', $$MATCH (a:v {n: 2}) CREATE (a)-[:e]->(:v {n: 3})$$) AS (a agtype);
+SELECT * FROM cypher('vle_delta', $$MATCH p=(:v {n: 1})-[*]->() RETURN count(p)$$) AS (c agtype);
+-- a load by parallel workers sees the same graph
+SET age.global_graph_load_workers = 2;
+SELECT * FROM cypher('vle_delta', $$RETURN delete_global_graphs('vle_delta')$$) AS (result agtype);
+SELECT * FROM cypher('vle_delta', $$MATCH p=(:v {n: 1})-[*]->() RETURN count(p)$$) AS (c agtype);
+-- the workers' vertices and edges are put in graphid order
+SELECT * FROM cypher('vle_delta', $$MATCH (a:v)-[*1..1]->(b:v) RETURN a.n, b.n$$) AS (a agtype, b agtype);
+RESET age.global_graph_load_workers;
+-- properties fetched when needed give the same results
+SET age.global_graph_lazy_properties = on;
+SELECT * FROM cypher('vle_delta', $$RETURN delete_global_graphs('vle_delta')$$) AS (result agtype);
+SELECT * FROM cypher('vle_delta', $$MATCH p=(:v {n: 1})-[:e*]->() RETURN count(p)$$) AS (c agtype);
+SELECT * FROM cypher('vle_delta', $$MATCH p=(:v {n: 1})-[*]->() UNWIND nodes(p) AS x RETURN x.n ORDER BY x.n$$) AS (n agtype);
+-- a rewrite of the label tables moves their tuples, so the graph is reloaded
+VACUUM FULL vle_delta.v;
+VACUUM FULL vle_delta.e;
+SELECT * FROM cypher('vle_delta', $$MATCH p=(:v {n: 1})-[*]->() UNWIND nodes(p) AS x RETURN x.n ORDER BY x.n$$) AS (n agtype);
+RESET age.global_graph_lazy_properties;
+-- with no memory budget, loading a graph evicts the others
+SET age.global_graph_memory_limit = 0;
+SELECT * FROM cypher('vle_delta', $$RETURN delete_global_graphs('vle_delta')$$) AS (result agtype);
+SELECT * FROM cypher('vle_delta', $$MATCH p=(:v {n: 1})-[*]->() RETURN count(p)$$) AS (c agtype);
+SELECT graph_name, num_vertices, num_edges, bytes_used > 0 AS has_memory
+FROM ag_catalog.ag_global_graph_stats;
+RESET age.global_graph_memory_limit;
+-- snapshot files need age in shared_preload_libraries
+SELECT save_graph_snapshot('vle_delta');
+SELECT save_graph_snapshot('vle_missing');
+-- they are written into the data directory, so PUBLIC can't save them
+SELECT has_function_privilege('public', 'ag_catalog.save_graph_snapshot(name)', 'EXECUTE');
+SELECT drop_graph('vle_delta', true);
+
+--
+-- VLE and unnest row estimates
+--
+SELECT create_graph('vle_estimate');
+SELECT * FROM cypher('vle_estimate', $$CREATE (:v)-[:e]->(:v)-[:e]->(:v)-[:e]->(:v)$$) AS (a agtype);
+-- the estimates use the statistics of the label tables
+ANALYZE vle_estimate._ag_label_vertex, vle_estimate._ag_label_edge, vle_estimate.v, vle_estimate.e;
+-- from one start vertex, 0.75 + 0.5625 + 0.421875 paths
+SELECT * FROM explain_match($q$EXPLAIN SELECT * FROM age_vle('"vle_estimate"'::agtype, '1'::agtype, 'null'::agtype, '{"id": 1, "label": "", "end_id": 2, "start_id": 3, "properties": {}}::edge'::agtype, '1'::agtype, '3'::agtype, '1'::agtype)$q$, 'Function Scan.*rows=(\d+)');
+-- from each of the 4 vertices
+SELECT * FROM explain_match($q$EXPLAIN SELECT * FROM age_vle('"vle_estimate"'::agtype, 'null'::agtype, 'null'::agtype, '{"id": 1, "label": "", "end_id": 2, "start_id": 3, "properties": {}}::edge'::agtype, '1'::agtype, '3'::agtype, '1'::agtype)$q$, 'Function Scan.*rows=(\d+)');
+-- without a direction, each vertex has twice the degree
+SELECT * FROM explain_match($q$EXPLAIN SELECT * FROM age_vle('"vle_estimate"'::agtype, 'null'::agtype, 'null'::agtype, '{"id": 1, "label": "", "end_id": 2, "start_id": 3, "properties": {}}::edge'::agtype, '1'::agtype, '2'::agtype, '0'::agtype)$q$, 'Function Scan.*rows=(\d+)');
+-- without an upper bound, up to 10 more than the lower bound
+SELECT * FROM explain_match($q$EXPLAIN SELECT * FROM age_vle('"vle_estimate"'::agtype, 'null'::agtype, 'null'::agtype, '{"id": 1, "label": "", "end_id": 2, "start_id": 3, "properties": {}}::edge'::agtype, '1'::agtype, 'null'::agtype, '1'::agtype)$q$, 'Function Scan.*rows=(\d+)');
+-- the number of elements of a known list
+SELECT * FROM explain_match($q$EXPLAIN SELECT * FROM unnest('[1, 2, 3]'::agtype)$q$, 'Function Scan.*rows=(\d+)');
+SELECT drop_graph('vle_estimate', true);
+
+--
+-- VLE spills to disk beyond work_mem
+--
+SELECT create_graph('vle_spill');
+SELECT * FROM cypher('vle_spill', $$CREATE (:hub), (:spoke)$$) AS (a agtype);
+SELECT * FROM cypher('vle_spill', $$MATCH (a:hub), (b:spoke) UNWIND range(1, 5000) AS i CREATE (a)-[:e]->(b)$$) AS (a agtype);
+-- the 5000 edges from the hub don't fit in work_mem, so some of them spill
+SET work_mem = '64kB';
+SELECT * FROM explain_match($q$SELECT * FROM cypher('vle_spill', $$EXPLAIN ANALYZE MATCH (a:hub)-[*1..1]->() RETURN count(*) $$) AS (a agtype)$q$, '^(VLE Spilled: \d+ kB)$');
+-- the same paths are still found
+SELECT * FROM cypher('vle_spill', $$MATCH (a:hub)-[*1..1]->() RETURN count(*) $$) AS (c agtype);
+RESET work_mem;
+SELECT drop_graph('vle_spill', true);
+
+--
+-- VLE traversal of the global graph
+--
+SELECT create_graph('vle_layout');
+SELECT * FROM cypher('vle_layout', $$CREATE (a:v {n: 1})-[:e]->(b:v {n: 2})-[:e]->(c:w {n: 3}), (c)-[:f]->(a), (a)-[:f]->(a)$$) AS (a agtype);
+-- each edge is found with the vertex at its other end, and self loops in either direction
+SELECT * FROM cypher('vle_layout', $$MATCH (a:v {n: 1})-[e*1..1]->(b) RETURN label(e[0]), b.n ORDER BY b.n$$) AS (l agtype, n agtype);
+SELECT * FROM cypher('vle_layout', $$MATCH (a:v {n: 1})<-[e*1..1]-(b) RETURN label(e[0]), b.n ORDER BY b.n$$) AS (l agtype, n agtype);
+SELECT * FROM cypher('vle_layout', $$MATCH (a:v {n: 1})-[e*1..1]-(b) RETURN label(e[0]), b.n ORDER BY b.n$$) AS (l agtype, n agtype);
+-- the vertices of both labels are indexed together. Should find 8, and 2 to :w
+SELECT * FROM cypher('vle_layout', $$MATCH p=(:v {n: 1})-[*]->() RETURN count(p)$$) AS (c agtype);
+SELECT * FROM cypher('vle_layout', $$MATCH p=(:v {n: 1})-[*]->(:w) RETURN count(p)$$) AS (c agtype);
+-- vertices added or deleted after the load. Should find 2, 1, and 3
+BEGIN;
+SELECT * FROM cypher('vle_layout', $$MATCH (c:w {n: 3}) CREATE (c)-[:e]->(:v {n: 4})$$) AS (a agtype);
+SELECT * FROM cypher('vle_layout', $$MATCH p=(:v {n: 1})-[*]->(:v {n: 4}) RETURN count(p)$$) AS (c agtype);
+SELECT * FROM cypher('vle_layout', $$MATCH (b:v {n: 2}) DETACH DELETE b$$) AS (a agtype);
+SELECT * FROM cypher('vle_layout', $$MATCH p=(:v {n: 1})-[*]->() RETURN count(p)$$) AS (c agtype);
+SELECT * FROM cypher('vle_layout', $$MATCH p=(:w {n: 3})-[*]->() RETURN count(p)$$) AS (c agtype);
+ROLLBACK;
+-- Should find 8 again
+SELECT * FROM cypher('vle_layout', $$MATCH p=(:v {n: 1})-[*]->() RETURN count(p)$$) AS (c agtype);
+-- a ring of 101 edges, longer than the initial path edge set
+SELECT * FROM cypher('vle_layout', $$UNWIND range(0, 100) AS i CREATE (:r {n: i})$$) AS (a agtype);
+SELECT * FROM cypher('vle_layout', $$MATCH (x:r), (y:r) WHERE y.n = (x.n + 1) % 101 CREATE (x)-[:e]->(y)$$) AS (a agtype);
+-- Should find 1 path, of length 100
+SELECT * FROM cypher('vle_layout', $$MATCH p=(:r {n: 0})-[*]->(:r {n: 100}) RETURN size(relationships(p))$$) AS (l agtype);
+-- each edge is used once. Should find 101 and 202 paths, up to 101 long
+SELECT * FROM cypher('vle_layout', $$MATCH p=(:r {n: 0})-[*]->() RETURN count(p), max(size(relationships(p)))$$) AS (c agtype, l agtype);
+SELECT * FROM cypher('vle_layout', $$MATCH p=(:r {n: 0})-[*]-() RETURN count(p), max(size(relationships(p)))$$) AS (c agtype, l agtype);
+-- Should find 15 around the triangle and its self loop
+SELECT * FROM cypher('vle_layout', $$MATCH p=(:v {n: 1})-[*]-() RETURN count(p)$$) AS (c agtype);
+-- only edges with the label id are followed. Should find 2, 1, and 3
+SELECT * FROM cypher('vle_layout', $$MATCH p=(:v {n: 1})-[:e*]->() RETURN count(p)$$) AS (c agtype);
+SELECT * FROM cypher('vle_layout', $$MATCH p=(:v {n: 1})-[:f*]->() RETURN count(p)$$) AS (c agtype);
+SELECT * FROM cypher('vle_layout', $$MATCH p=(:v {n: 1})-[:f*]-() RETURN count(p)$$) AS (c agtype);
+-- a search stopped early, then run to the end, with its stacks reused
+SELECT * FROM cypher('vle_layout', $$MATCH p=(:r {n: 0})-[*]->() RETURN size(relationships(p)) LIMIT 3$$) AS (l agtype);
+SELECT * FROM cypher('vle_layout', $$MATCH p=(:r {n: 0})-[*]->() RETURN count(p), max(size(relationships(p)))$$) AS (c agtype, l agtype);
+SELECT * FROM cypher('vle_layout', $$MATCH p=(:r {n: 0})-[*]->() RETURN size(relationships(p)) LIMIT 3$$) AS (l agtype);
+SELECT drop_graph('vle_layout', true);
+
 --
 -- Clean up
 --
 
 DROP TABLE start_and_end_points;
+DROP FUNCTION explain_match;
 
 SELECT drop_graph('cypher_vle', true);
 
@@ -25,6 +25,9 @@
 #include "nodes/ag_nodes.h"
 #include "optimizer/cypher_paths.h"
 #include "parser/cypher_analyze.h"
+#include "utils/ag_guc.h"
+#include "utils/age_global_graph.h"
+#include "utils/age_vle.h"
 
 PG_MODULE_MAGIC;
 
@@ -32,19 +35,28 @@ void _PG_init(void);
 
 void _PG_init(void)
 {
+    define_config_params();
     register_ag_nodes();
+    global_graph_shmem_init();
+    vle_shmem_init();
+    global_graph_hooks_init();
     set_rel_pathlist_init();
     object_access_hook_init();
     process_utility_hook_init();
     post_parse_analyze_init();
+    vle_explain_hook_init();
 }
 
 void _PG_fini(void);
 
 void _PG_fini(void)
 {
+    vle_explain_hook_fini();
     post_parse_analyze_fini();
     process_utility_hook_fini();
     object_access_hook_fini();
     set_rel_pathlist_fini();
+    global_graph_hooks_fini();
+    vle_shmem_fini();
+    global_graph_shmem_fini();
 }
@@ -20,6 +20,7 @@
 #include "postgres.h"
 
 #include "catalog/dependency.h"
+#include "catalog/namespace.h"
 #include "catalog/objectaccess.h"
 #include "catalog/pg_class_d.h"
 #include "catalog/pg_namespace_d.h"
@@ -32,6 +33,7 @@
 #include "catalog/ag_label.h"
 #include "catalog/ag_namespace.h"
 #include "utils/ag_cache.h"
+#include "utils/age_global_graph.h"
 
 static object_access_hook_type prev_object_access_hook;
 static ProcessUtility_hook_type prev_process_utility_hook;
@@ -45,6 +47,8 @@ void ag_ProcessUtility_hook(PlannedStmt *pstmt, const char *queryString, bool re
                             QueryCompletion *qc);
 
 static bool is_age_drop(PlannedStmt *pstmt);
+static void invalidate_utility_graphs(Node *utility_stmt);
+static void invalidate_label_relation_graph(RangeVar *relation);
 static void drop_age_extension(DropStmt *stmt);
 
 void object_access_hook_init(void)
@@ -91,6 +95,8 @@ void ag_ProcessUtility_hook(PlannedStmt *pstmt, const char *queryString, bool re
                              QueryEnvironment *queryEnv, DestReceiver *dest,
                              QueryCompletion *qc)
 {
+    invalidate_utility_graphs(pstmt->utilityStmt);
+
     if (is_age_drop(pstmt))
         drop_age_extension((DropStmt *)pstmt->utilityStmt);
     else if (prev_process_utility_hook)
@@ -101,6 +107,51 @@ void ag_ProcessUtility_hook(PlannedStmt *pstmt, const char *queryString, bool re
                                 dest, qc);
 }
 
+/*
+ * COPY FROM and TRUNCATE change label tables without going through Cypher,
+ * so the GRAPH global contexts can't be patched with logged deltas. Only the
+ * graphs that own the label tables are invalidated. Other tables, and
+ * databases without AGE, are left alone.
+ */
+static void invalidate_utility_graphs(Node *utility_stmt)
+{
+    ListCell *lc;
+
+    if (!IsA(utility_stmt, CopyStmt) && !IsA(utility_stmt, TruncateStmt))
+        return;
+
+    if (!OidIsValid(get_namespace_oid("ag_catalog", true)))
+        return;
+
+    if (IsA(utility_stmt, CopyStmt))
+    {
+        CopyStmt *copy_stmt = (CopyStmt *)utility_stmt;
+
+        if (copy_stmt->is_from && copy_stmt->relation != NULL)
+            invalidate_label_relation_graph(copy_stmt->relation);
+
+        return;
+    }
+
+    foreach (lc, ((TruncateStmt *)utility_stmt)->relations)
+        invalidate_label_relation_graph(lfirst_node(RangeVar, lc));
+}
+
+// Invalidate the graph of the relation, if it is a label table.
+static void invalidate_label_relation_graph(RangeVar *relation)
+{
+    label_cache_data *cache_data;
+    Oid relid;
+
+    relid = RangeVarGetRelid(relation, NoLock, true);
+    if (!OidIsValid(relid))
+        return;
+
+    cache_data = search_label_relation_cache(relid);
+    if (cache_data)
+        invalidate_GRAPH_global_contexts(cache_data->graph);
+}
+
 static void drop_age_extension(DropStmt *stmt)
 {
     // Remove all graphs
@@ -208,6 +259,9 @@ static void object_access(ObjectAccessType access, Oid class_id, Oid object_id,
         if (!cache_data)
             return;
 
+        // The graph's GRAPH global context must be rebuilt.
+        invalidate_GRAPH_global_contexts(cache_data->graph);
+
         if (drop_arg->dropflags & PERFORM_DELETION_INTERNAL)
         {
             /*
@@ -37,6 +37,7 @@
 #include "executor/cypher_executor.h"
 #include "executor/cypher_utils.h"
 #include "nodes/cypher_nodes.h"
+#include "utils/age_global_graph.h"
 #include "utils/agtype.h"
 #include "utils/graphid.h"
 
@@ -318,6 +319,8 @@ static void delete_entity(EState *estate, ResultRelInfo *resultRelInfo,
         switch (delete_result)
         {
         case TM_Ok:
+            /* log the deletion for the GRAPH global context */
+            log_GRAPH_global_delete(resultRelInfo->ri_RelationDesc, tuple);
             break;
         case TM_SelfModified:
             ereport(
@@ -34,6 +34,7 @@
 #include "executor/cypher_executor.h"
 #include "executor/cypher_utils.h"
 #include "nodes/cypher_nodes.h"
+#include "utils/age_global_graph.h"
 #include "utils/agtype.h"
 #include "utils/graphid.h"
 
@@ -173,6 +174,9 @@ static HeapTuple update_entity_tuple(ResultRelInfo *resultRelInfo,
           ExecInsertIndexTuples(resultRelInfo, elemTupleSlot, estate, false, false, NULL, NIL);
         }
 
+        /* log the new properties for the GRAPH global context */
+        log_GRAPH_global_update(resultRelInfo->ri_RelationDesc, elemTupleSlot);
+
             ExecCloseIndices(resultRelInfo);
     }
     else if (lock_result == TM_SelfModified)
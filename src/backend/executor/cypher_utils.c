@@ -46,6 +46,7 @@
 #include "executor/cypher_utils.h"
 #include "utils/agtype.h"
 #include "utils/ag_cache.h"
+#include "utils/age_global_graph.h"
 #include "utils/agtype.h"
 #include "utils/graphid.h"
 
@@ -257,5 +258,8 @@ HeapTuple insert_entity_tuple_cid(ResultRelInfo *resultRelInfo,
         ExecInsertIndexTuples(resultRelInfo, elemTupleSlot, estate, false, false, NULL, NIL);
     }
 
+    // Log the new entity for the GRAPH global context, CREATE and MERGE
+    log_GRAPH_global_insert(resultRelInfo->ri_RelationDesc, elemTupleSlot);
+
     return tuple;
 }
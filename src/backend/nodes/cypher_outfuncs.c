@@ -194,6 +194,7 @@ void out_cypher_path(StringInfo str, const ExtensibleNode *node)
     DEFINE_AG_NODE(cypher_path);
 
     WRITE_NODE_FIELD(path);
+    WRITE_ENUM_FIELD(mode, cypher_path_mode);
     WRITE_LOCATION_FIELD(location);
 }
 
@@ -217,6 +218,7 @@ void out_cypher_relationship(StringInfo str, const ExtensibleNode *node)
     WRITE_STRING_FIELD(label);
     WRITE_NODE_FIELD(props);
     WRITE_NODE_FIELD(varlen);
+    WRITE_NODE_FIELD(vle_vertex);
     WRITE_ENUM_FIELD(dir, cypher_rel_dir);
     WRITE_LOCATION_FIELD(location);
 }
@@ -19,14 +19,22 @@
 
 #include "postgres.h"
 
+#include "nodes/makefuncs.h"
 #include "nodes/parsenodes.h"
 #include "nodes/primnodes.h"
 #include "optimizer/pathnode.h"
 #include "optimizer/paths.h"
 
+#include "nodes/cypher_nodes.h"
 #include "optimizer/cypher_pathnode.h"
 #include "optimizer/cypher_paths.h"
 #include "utils/ag_func.h"
+#include "utils/age_global_graph.h"
+#include "utils/agtype.h"
+
+#define VLE_FUNCTION_NAME "age_vle"
+/* the number of arguments of the age_vle overload with the row bound */
+#define VLE_BOUNDED_FUNCTION_NARGS 10
 
 typedef enum cypher_clause_kind
 {
@@ -50,6 +58,10 @@ static void handle_cypher_delete_clause(PlannerInfo *root, RelOptInfo *rel,
                                         Index rti, RangeTblEntry *rte);
 static void handle_cypher_merge_clause(PlannerInfo *root, RelOptInfo *rel,
                                         Index rti, RangeTblEntry *rte);
+static void bound_vle_function_rows(PlannerInfo *root, RelOptInfo *rel,
+                                    RangeTblEntry *rte);
+static void restrict_vle_function_parallelism(RelOptInfo *rel,
+                                              RangeTblEntry *rte);
 
 void set_rel_pathlist_init(void)
 {
@@ -68,6 +80,13 @@ static void set_rel_pathlist(PlannerInfo *root, RelOptInfo *rel, Index rti,
     if (prev_set_rel_pathlist_hook)
         prev_set_rel_pathlist_hook(root, rel, rti, rte);
 
+    if (rte->rtekind == RTE_FUNCTION)
+    {
+        restrict_vle_function_parallelism(rel, rte);
+        bound_vle_function_rows(root, rel, rte);
+        return;
+    }
+
     switch (get_cypher_clause_kind(rte))
     {
     case CYPHER_CLAUSE_CREATE:
@@ -89,6 +108,144 @@ static void set_rel_pathlist(PlannerInfo *root, RelOptInfo *rel, Index rti,
     }
 }
 
+/*
+ * age_vle is parallel safe, but a parallel worker running it needs the whole
+ * GRAPH global context. Unless the GRAPH global contexts are shared, each
+ * worker would build its own copy of it, which costs more than the workers
+ * save. In that case, keep the VLE function out of the parallel part of the
+ * plan. The relations it takes its arguments from can still be scanned in
+ * parallel, with the VLE function run by the leader above the Gather.
+ */
+static void restrict_vle_function_parallelism(RelOptInfo *rel,
+                                              RangeTblEntry *rte)
+{
+    RangeTblFunction *rtfunc;
+    ListCell *lc;
+
+    if (!rel->consider_parallel || are_GRAPH_global_contexts_shared())
+        return;
+
+    if (list_length(rte->functions) != 1)
+        return;
+
+    rtfunc = linitial(rte->functions);
+
+    if (!IsA(rtfunc->funcexpr, FuncExpr) ||
+        !is_oid_ag_func(((FuncExpr *)rtfunc->funcexpr)->funcid,
+                        VLE_FUNCTION_NAME))
+        return;
+
+    // joins to this relation are then not considered for parallel plans
+    rel->consider_parallel = false;
+
+    foreach (lc, rel->pathlist)
+    {
+        Path *path = lfirst(lc);
+
+        path->parallel_safe = false;
+    }
+}
+
+/*
+ * When the query has a LIMIT, and every row the VLE function returns is a row
+ * of the result, the VLE function doesn't need to return more rows than the
+ * LIMIT (plus any OFFSET). This is the case when it only joins to the
+ * relations it takes its arguments from, and nothing filters its rows. The
+ * function is then switched to the age_vle overload that takes a row bound,
+ * or its empty row bound is filled in, so that it stops searching once it has
+ * returned that many rows.
+ *
+ * Note: root->limit_tuples is already -1 if there is grouping, aggregation,
+ *       DISTINCT or a set returning function in the target list.
+ */
+static void bound_vle_function_rows(PlannerInfo *root, RelOptInfo *rel,
+                                    RangeTblEntry *rte)
+{
+    RangeTblFunction *rtfunc;
+    FuncExpr *fe;
+    List *args;
+    Const *c;
+    Oid argtypes[VLE_BOUNDED_FUNCTION_NARGS];
+    Oid func_oid;
+    int i;
+
+    // there isn't a LIMIT, or the rows need to be sorted first
+    if (root->limit_tuples < 1 || root->parse->sortClause != NIL)
+        return;
+
+    if (list_length(rte->functions) != 1)
+        return;
+
+    rtfunc = linitial(rte->functions);
+
+    if (!IsA(rtfunc->funcexpr, FuncExpr))
+        return;
+
+    fe = (FuncExpr *)rtfunc->funcexpr;
+
+    if (!is_oid_ag_func(fe->funcid, VLE_FUNCTION_NAME))
+        return;
+
+    // an older overload, without the VLE grammar node id
+    if (list_length(fe->args) < VLE_PATH_MODE_ARGNO)
+        return;
+
+    // the function is already bounded
+    if (list_length(fe->args) > VLE_ROW_BOUND_ARGNO)
+    {
+        c = (Const *)list_nth(fe->args, VLE_ROW_BOUND_ARGNO);
+
+        if (!IsA(c, Const) || !c->constisnull)
+            return;
+    }
+
+    // nothing may filter its rows, including equivalence class join quals
+    if (rel->baserestrictinfo != NIL || rel->joininfo != NIL ||
+        rel->has_eclass_joins)
+        return;
+
+    // and it can only join to the relations it takes its arguments from
+    if (!bms_equal(bms_union(rel->relids, rel->lateral_relids),
+                   root->all_baserels))
+        return;
+
+    args = list_copy(fe->args);
+
+    c = makeConst(AGTYPEOID, -1, InvalidOid, -1,
+                  integer_to_agtype((int64)root->limit_tuples), false, false);
+
+    // fill in the empty row bound
+    if (list_length(args) > VLE_ROW_BOUND_ARGNO)
+    {
+        lfirst(list_nth_cell(args, VLE_ROW_BOUND_ARGNO)) = c;
+        fe->args = args;
+        return;
+    }
+
+    // the path mode is every path, if it isn't given
+    if (list_length(args) == VLE_PATH_MODE_ARGNO)
+    {
+        args = lappend(args, makeConst(AGTYPEOID, -1, InvalidOid, -1,
+                                       integer_to_agtype(CYPHER_PATH_ALL),
+                                       false, false));
+    }
+
+    // add in the row bound
+    args = lappend(args, c);
+
+    for (i = 0; i < VLE_BOUNDED_FUNCTION_NARGS; i++)
+        argtypes[i] = AGTYPEOID;
+
+    func_oid = get_ag_func_oid(VLE_FUNCTION_NAME, VLE_BOUNDED_FUNCTION_NARGS,
+                               argtypes[0], argtypes[1], argtypes[2],
+                               argtypes[3], argtypes[4], argtypes[5],
+                               argtypes[6], argtypes[7], argtypes[8],
+                               argtypes[9]);
+
+    fe->funcid = func_oid;
+    fe->args = args;
+}
+
 /*
  * Check to see if the rte is a Cypher clause. An rte is only a Cypher clause
  * if it is a subquery, with the last entry in its target list, that is a
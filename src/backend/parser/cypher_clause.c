@@ -129,12 +129,18 @@ static Query *transform_cypher_match(cypher_parsestate *cpstate,
                                      cypher_clause *clause);
 static Query *transform_cypher_match_pattern(cypher_parsestate *cpstate,
                                              cypher_clause *clause);
+static transform_entity *transform_match_vertex(cypher_parsestate *cpstate,
+                                                Query *query,
+                                                cypher_path *path,
+                                                cypher_node *node,
+                                                bool special_VLE_case,
+                                                bool *declared_in_prev_clause);
 static List *transform_match_entities(cypher_parsestate *cpstate, Query *query,
-                                      cypher_path *path);
+                                      cypher_path *path, Node *where);
 static void transform_match_pattern(cypher_parsestate *cpstate, Query *query,
                                     List *pattern, Node *where);
 static List *transform_match_path(cypher_parsestate *cpstate, Query *query,
-                                  cypher_path *path);
+                                  cypher_path *path, Node *where);
 static Expr *transform_cypher_edge(cypher_parsestate *cpstate,
                                    cypher_relationship *rel,
                                    List **target_list);
@@ -158,6 +164,10 @@ static List *make_directed_edge_join_conditions(
 static List *join_to_entity(cypher_parsestate *cpstate,
                             transform_entity *entity, Node *qual,
                             enum transform_entity_join_side side);
+static bool is_VLE_end_vertex_given(transform_entity *vle_entity);
+static Node *find_vertex_id_in_where(Node *where, char *var_name);
+static Node *copy_vertex_id_value(Node *value);
+static bool is_vertex_id_function(Node *expr, char *var_name);
 static List *make_join_condition_for_edge(cypher_parsestate *cpstate,
                                           transform_entity *prev_edge,
                                           transform_entity *prev_node,
@@ -209,6 +219,9 @@ static TargetEntry *placeholder_target_entry(cypher_parsestate *cpstate,
                                              char *name);
 static Query *transform_cypher_sub_pattern(cypher_parsestate *cpstate,
                                            cypher_clause *clause);
+static void make_VLE_reachability_search(cypher_parsestate *cpstate,
+                                         List *pattern);
+static Node *make_int_const(int i, int location);
 static Node *convert_containment_to_equality(cypher_parsestate *cpstate,
                                              List *keyvals,
                                              transform_entity *entity);
@@ -323,6 +336,8 @@ static ParseNamespaceItem *append_VLE_Func_to_FromClause(cypher_parsestate *cpst
 static void setNamespaceLateralState(List *namespace, bool lateral_only,
                                      bool lateral_ok);
 static bool isa_special_VLE_case(cypher_path *path);
+static void name_VLE_start_vertices(cypher_parsestate *cpstate,
+                                    cypher_path *path);
 
 ParseNamespaceItem *find_pnsi(cypher_parsestate *cpstate, char *varname);
 
@@ -2308,6 +2323,11 @@ static Query *transform_cypher_sub_pattern(cypher_parsestate *cpstate,
     ParseState *p_child_parse_state = (ParseState *) child_parse_state;
     p_child_parse_state->p_expr_kind = pstate->p_expr_kind;
 
+    /* EXISTS() only needs to know if there is a path */
+    if (subpat->kind == CSP_EXISTS)
+    {
+        make_VLE_reachability_search(cpstate, subpat->pattern);
+    }
 
     /* create a cypher match node and assign it the sub pattern */
     match = make_ag_node(cypher_match);
@@ -2351,6 +2371,76 @@ static Query *transform_cypher_sub_pattern(cypher_parsestate *cpstate,
     return qry;
 }
 
+/*
+ * Helper function to turn the VLE of an EXISTS() pattern into a reachability
+ * search, when the pattern is a single VLE between two vertices that already
+ * exist and neither the path nor the edge are named. The VLE function is then
+ * passed both vertices and returns one row if there is a path between them,
+ * instead of every path.
+ */
+static void make_VLE_reachability_search(cypher_parsestate *cpstate,
+                                         List *pattern)
+{
+    ParseState *pstate = (ParseState *)cpstate;
+    cypher_path *path = NULL;
+    cypher_relationship *cr = NULL;
+    cypher_node *cnr = NULL;
+    FuncCall *func = NULL;
+    ColumnRef *cref = NULL;
+    Node *mode = NULL;
+
+    if (list_length(pattern) != 1)
+    {
+        return;
+    }
+
+    path = (cypher_path *)linitial(pattern);
+
+    if (path->var_name != NULL || path->mode != CYPHER_PATH_ALL ||
+        list_length(path->path) != 3)
+    {
+        return;
+    }
+
+    cr = (cypher_relationship *)lsecond(path->path);
+    cnr = (cypher_node *)lthird(path->path);
+
+    if (cr->varlen == NULL || cr->name != NULL || cnr->name == NULL)
+    {
+        return;
+    }
+
+    /*
+     * Otherwise, each of the end vertex's rows would need its own search,
+     * where one search finds all of them now.
+     */
+    if (colNameToVar(pstate, cnr->name, false, cnr->location) == NULL)
+    {
+        return;
+    }
+
+    func = (FuncCall *)cr->varlen;
+
+    /* add in the end vertex */
+    cref = makeNode(ColumnRef);
+    cref->fields = list_make2(makeString(cnr->name), makeString("id"));
+    cref->location = cnr->location;
+    lsecond(func->args) = cref;
+
+    /* add in the path mode, or replace it if it is already there */
+    mode = make_int_const(CYPHER_PATH_REACHABLE, -1);
+    if (list_length(func->args) > VLE_PATH_MODE_ARGNO)
+    {
+        lfirst(list_nth_cell(func->args, VLE_PATH_MODE_ARGNO)) = mode;
+    }
+    else
+    {
+        func->args = lappend(func->args, mode);
+    }
+
+    path->mode = CYPHER_PATH_REACHABLE;
+}
+
 /*
  * Code borrowed and inspired by PG's transformFromClauseItem. This function
  * will transform the VLE function, depending on type. Currently, only
@@ -2556,7 +2646,7 @@ static void transform_match_pattern(cypher_parsestate *cpstate, Query *query,
         /* get the path and transform it */
         path = (cypher_path *) lfirst(lc);
 
-        qual = transform_match_path(cpstate, query, path);
+        qual = transform_match_path(cpstate, query, path, where);
 
         quals = list_concat(quals, qual);
     }
@@ -2743,6 +2833,142 @@ static List *make_directed_edge_join_conditions(
     return quals;
 }
 
+/*
+ * Helper function to check whether a VLE function was passed its end vertex,
+ * as it is for shortest paths and reachability searches.
+ */
+static bool is_VLE_end_vertex_given(transform_entity *vle_entity)
+{
+    FuncCall *func = (FuncCall *)vle_entity->entity.rel->varlen;
+
+    return IsA(lsecond(func->args), ColumnRef);
+}
+
+/*
+ * Helper function to find a conjunct of the form id(var_name) = <value> in a
+ * raw WHERE clause, where the value is a constant or a parameter. A copy of
+ * the value is returned, or NULL if there isn't one. The WHERE clause is
+ * transformed separately, so the raw node can't be shared with it.
+ */
+static Node *find_vertex_id_in_where(Node *where, char *var_name)
+{
+    A_Expr *a = NULL;
+    char *opr_name = NULL;
+
+    if (where == NULL || var_name == NULL)
+    {
+        return NULL;
+    }
+
+    /* search each conjunct of an AND */
+    if (IsA(where, BoolExpr))
+    {
+        BoolExpr *bexpr = (BoolExpr *)where;
+        ListCell *lc = NULL;
+
+        if (bexpr->boolop != AND_EXPR)
+        {
+            return NULL;
+        }
+
+        foreach (lc, bexpr->args)
+        {
+            Node *value = find_vertex_id_in_where(lfirst(lc), var_name);
+
+            if (value != NULL)
+            {
+                return value;
+            }
+        }
+
+        return NULL;
+    }
+
+    if (!IsA(where, A_Expr))
+    {
+        return NULL;
+    }
+
+    a = (A_Expr *)where;
+
+    if (a->kind != AEXPR_OP || list_length(a->name) != 1)
+    {
+        return NULL;
+    }
+
+    opr_name = strVal(linitial(a->name));
+
+    if (strcmp(opr_name, "=") != 0)
+    {
+        return NULL;
+    }
+
+    if (is_vertex_id_function(a->lexpr, var_name) &&
+        (IsA(a->rexpr, A_Const) || is_ag_node(a->rexpr, cypher_param)))
+    {
+        return copy_vertex_id_value(a->rexpr);
+    }
+
+    if (is_vertex_id_function(a->rexpr, var_name) &&
+        (IsA(a->lexpr, A_Const) || is_ag_node(a->lexpr, cypher_param)))
+    {
+        return copy_vertex_id_value(a->lexpr);
+    }
+
+    return NULL;
+}
+
+/*
+ * Helper function to copy the value found by find_vertex_id_in_where.
+ * copyObject() doesn't support cypher_param, so it is copied here.
+ */
+static Node *copy_vertex_id_value(Node *value)
+{
+    cypher_param *param = NULL;
+    cypher_param *new_param = NULL;
+
+    if (IsA(value, A_Const))
+    {
+        return copyObject(value);
+    }
+
+    param = (cypher_param *)value;
+    new_param = make_ag_node(cypher_param);
+    new_param->name = pstrdup(param->name);
+    new_param->location = param->location;
+
+    return (Node *)new_param;
+}
+
+/*
+ * Helper function to check whether a raw expression is id(var_name).
+ */
+static bool is_vertex_id_function(Node *expr, char *var_name)
+{
+    FuncCall *fc = NULL;
+    ColumnRef *cref = NULL;
+
+    if (!IsA(expr, FuncCall))
+    {
+        return false;
+    }
+
+    fc = (FuncCall *)expr;
+
+    if (list_length(fc->funcname) != 1 ||
+        pg_strcasecmp(strVal(linitial(fc->funcname)), "id") != 0 ||
+        list_length(fc->args) != 1 || !IsA(linitial(fc->args), ColumnRef))
+    {
+        return false;
+    }
+
+    cref = linitial(fc->args);
+
+    return (list_length(cref->fields) == 1 &&
+            IsA(linitial(cref->fields), String) &&
+            strcmp(strVal(linitial(cref->fields)), var_name) == 0);
+}
+
 /*
  * The joins are driven by edges. Under specific conditions, it becomes
  * necessary to have knowledge about the previous edge and vertex and
@@ -2792,9 +3018,10 @@ static List *make_join_condition_for_edge(cypher_parsestate *cpstate,
         /*
          * If the previous node and the next node are in the join tree, we need
          * to create the age_match_vle_terminal_edge to compare the vle returned
-         * results against the two nodes.
+         * results against the two nodes. That isn't needed when the vle was
+         * passed the next node, as it then only finds paths that end there.
          */
-        if (prev_node->in_join_tree)
+        if (prev_node->in_join_tree && !is_VLE_end_vertex_given(entity))
         {
             func_name = makeString("age_match_vle_terminal_edge");
             qualified_func_name = list_make2(ag_catalog, func_name);
@@ -2993,6 +3220,18 @@ static Node *make_bool_a_const(bool state)
     return make_type_cast_to_agtype((Node *)n);
 }
 
+/* Makes an integer node, the same way the grammar does for literals */
+static Node *make_int_const(int i, int location)
+{
+    A_Const *n = makeNode(A_Const);
+
+    n->val.type = T_Integer;
+    n->val.val.ival = i;
+    n->location = location;
+
+    return (Node *)n;
+}
+
 /*
  * For the given entity, join it to the current edge, via the passed
  * qual node. The side denotes if the entity is on the right
@@ -3313,7 +3552,7 @@ static Node *create_property_constraints(cypher_parsestate *cpstate,
  * correct join tree, and enforce edge uniqueness.
  */
 static List *transform_match_path(cypher_parsestate *cpstate, Query *query,
-                                  cypher_path *path)
+                                  cypher_path *path, Node *where)
 {
     List *qual = NIL;
     List *entities = NIL;
@@ -3321,7 +3560,7 @@ static List *transform_match_path(cypher_parsestate *cpstate, Query *query,
     List *join_quals;
 
     // transform the entities in the path
-    entities = transform_match_entities(cpstate, query, path);
+    entities = transform_match_entities(cpstate, query, path, where);
 
     // create the path variable, if needed.
     if (path->var_name != NULL)
@@ -3465,22 +3704,139 @@ static bool isa_special_VLE_case(cypher_path *path)
     return false;
 }
 
+/*
+ * A VLE with an anonymous start vertex is passed its end vertex instead, and
+ * its start vertex is left out of the join tree. A path variable needs that
+ * start vertex, unless the VLE is the whole path, as the VLE path then has
+ * both of its vertices. In that case, give the start vertex a variable name
+ * and pass it to the VLE function too.
+ */
+static void name_VLE_start_vertices(cypher_parsestate *cpstate,
+                                    cypher_path *path)
+{
+    ListCell *lc = NULL;
+    cypher_node *prev_node = NULL;
+
+    foreach (lc, path->path)
+    {
+        Node *n = lfirst(lc);
+        cypher_relationship *rel = NULL;
+        FuncCall *func = NULL;
+        ColumnRef *cref = NULL;
+
+        if (is_ag_node(n, cypher_node))
+        {
+            prev_node = (cypher_node *)n;
+            continue;
+        }
+
+        rel = (cypher_relationship *)n;
+
+        if (rel->varlen == NULL)
+        {
+            continue;
+        }
+
+        func = (FuncCall *)rel->varlen;
+
+        if (IsA(linitial(func->args), ColumnRef))
+        {
+            continue;
+        }
+
+        prev_node->name = get_next_default_alias(cpstate);
+
+        cref = makeNode(ColumnRef);
+        cref->fields = list_make2(makeString(prev_node->name),
+                                  makeString("id"));
+        cref->location = prev_node->location;
+        linitial(func->args) = cref;
+    }
+}
+
+/*
+ * Transform a vertex of a MATCH path into its transform entity. The entity is
+ * not added to any entity lists. If the vertex's variable was created in a
+ * previous clause, declared_in_prev_clause is set.
+ */
+static transform_entity *transform_match_vertex(cypher_parsestate *cpstate,
+                                                Query *query,
+                                                cypher_path *path,
+                                                cypher_node *node,
+                                                bool special_VLE_case,
+                                                bool *declared_in_prev_clause)
+{
+    ParseState *pstate = (ParseState *)cpstate;
+    transform_entity *entity = NULL;
+    Expr *expr = NULL;
+    bool output_node = false;
+
+    /*
+     * The vle needs to know if the start vertex was
+     * created in a previous clause. Check to see if it
+     * was so the edge logic can handle changing its argument
+     * if necessary.
+     */
+    if (node->name != NULL)
+    {
+        /*
+         * Checks the previous clauses to see if the variable already
+         * exists.
+         */
+        Node *expr = colNameToVar(pstate, node->name, false,
+                                  node->location);
+        if (expr != NULL)
+        {
+            *declared_in_prev_clause = true;
+        }
+    }
+
+    /* should we make the node available */
+    output_node = (special_VLE_case && !node->name && !node->props) ?
+                  false :
+                  INCLUDE_NODE_IN_JOIN_TREE(path, node);
+
+    /* transform vertex */
+    expr = transform_cypher_node(cpstate, node, &query->targetList,
+                                 output_node);
+
+    entity = make_transform_entity(cpstate, ENT_VERTEX, (Node *)node, expr);
+
+    /* transform properties if they exist */
+    if (node->props)
+    {
+        Node *n = NULL;
+
+        n = create_property_constraints(cpstate, entity, node->props);
+
+        cpstate->property_constraint_quals =
+            lappend(cpstate->property_constraint_quals, n);
+    }
+
+    return entity;
+}
+
 /*
  * Iterate through the path and construct all edges and necessary vertices
  */
 static List *transform_match_entities(cypher_parsestate *cpstate, Query *query,
-                                      cypher_path *path)
+                                      cypher_path *path, Node *where)
 {
-    ParseState *pstate = (ParseState *)cpstate;
     ListCell *lc = NULL;
     List *entities = NIL;
     int i = 0;
     bool node_declared_in_prev_clause = false;
     transform_entity *prev_entity = NULL;
+    transform_entity *next_vertex_entity = NULL;
     bool special_VLE_case = false;
 
     special_VLE_case = isa_special_VLE_case(path);
 
+    if (path->var_name != NULL && !special_VLE_case)
+    {
+        name_VLE_start_vertices(cpstate, path);
+    }
+
     /*
      * Iterate through every node in the path, construct the expr node
      * that is needed for the remaining steps
@@ -3495,52 +3851,17 @@ static List *transform_match_entities(cypher_parsestate *cpstate, Query *query,
         /* even increments of i are vertices */
         if (i % 2 == 0)
         {
-            cypher_node *node = NULL;
-            bool output_node = false;
-
-            node = lfirst(lc);
-
-            /*
-             * The vle needs to know if the start vertex was
-             * created in a previous clause. Check to see if it
-             * was so the edge logic can handle changing its argument
-             * if necessary.
-             */
-            if (node->name != NULL)
+            /* the vertex may have been transformed ahead of its VLE edge */
+            if (next_vertex_entity != NULL)
             {
-                /*
-                 * Checks the previous clauses to see if the variable already
-                 * exists.
-                 */
-                Node *expr = colNameToVar(pstate, node->name, false,
-                                          node->location);
-                if (expr != NULL)
-                {
-                    node_declared_in_prev_clause = true;
-                }
+                entity = next_vertex_entity;
+                next_vertex_entity = NULL;
             }
-
-            /* should we make the node available */
-            output_node = (special_VLE_case && !node->name && !node->props) ?
-                          false :
-                          INCLUDE_NODE_IN_JOIN_TREE(path, node);
-
-            /* transform vertex */
-            expr = transform_cypher_node(cpstate, node, &query->targetList,
-                                         output_node);
-
-            entity = make_transform_entity(cpstate, ENT_VERTEX, (Node *)node,
-                                           expr);
-
-            /* transform properties if they exist */
-            if (node->props)
+            else
             {
-                Node *n = NULL;
-
-                n = create_property_constraints(cpstate, entity, node->props);
-
-                cpstate->property_constraint_quals =
-                    lappend(cpstate->property_constraint_quals, n);
+                entity = transform_match_vertex(cpstate, query, path,
+                                                lfirst(lc), special_VLE_case,
+                                                &node_declared_in_prev_clause);
             }
 
             cpstate->entities = lappend(cpstate->entities, entity);
@@ -3609,6 +3930,7 @@ static List *transform_match_entities(cypher_parsestate *cpstate, Query *query,
             else
             {
                 transform_entity *vle_entity = NULL;
+                FuncCall *func = (FuncCall*)rel->varlen;
 
                 /*
                  * Check to see if the previous node was originally created
@@ -3619,8 +3941,6 @@ static List *transform_match_entities(cypher_parsestate *cpstate, Query *query,
                  */
                 if (node_declared_in_prev_clause)
                 {
-                    FuncCall *func = (FuncCall*)rel->varlen;
-
                     ColumnRef *cr = linitial(func->args);
 
                     Assert(IsA(cr, ColumnRef));
@@ -3629,6 +3949,63 @@ static List *transform_match_entities(cypher_parsestate *cpstate, Query *query,
                     cr->fields = list_make1(linitial(cr->fields));
                 }
 
+                /*
+                 * A shortest path search, or a VLE with an anonymous start
+                 * vertex, is passed the end vertex, so that vertex needs to be
+                 * transformed before the VLE function that references it. If
+                 * the end vertex was created in a previous clause, its
+                 * variable is referenced, as for the start vertex.
+                 */
+                if (IsA(lsecond(func->args), ColumnRef))
+                {
+                    bool end_declared_in_prev_clause = false;
+
+                    next_vertex_entity =
+                        transform_match_vertex(cpstate, query, path,
+                                               lfirst(lnext(path->path, lc)),
+                                               special_VLE_case,
+                                               &end_declared_in_prev_clause);
+
+                    if (end_declared_in_prev_clause)
+                    {
+                        ColumnRef *cr = lsecond(func->args);
+
+                        Assert(IsA(cr, ColumnRef));
+                        Assert(list_length(cr->fields) == 2);
+
+                        cr->fields = list_make1(linitial(cr->fields));
+                    }
+                }
+                /*
+                 * Otherwise, if the WHERE clause fixes the id of the end
+                 * vertex, pass that id to the VLE function. It then only
+                 * searches for the paths between the two vertices, instead of
+                 * for every path from the start vertex. The WHERE clause and
+                 * the terminal edge check are still applied to the results.
+                 */
+                else
+                {
+                    cypher_node *end_node = lfirst(lnext(path->path, lc));
+                    A_Const *end_arg = lsecond(func->args);
+                    Node *end_id = NULL;
+
+                    if (IsA(end_arg, A_Const) && end_arg->val.type == T_Null)
+                    {
+                        end_id = find_vertex_id_in_where(where,
+                                                         end_node->name);
+                    }
+
+                    if (end_id != NULL)
+                    {
+                        List *fname = list_make2(makeString("ag_catalog"),
+                                                 makeString("age_vle_end_vertex_id"));
+
+                        lsecond(func->args) =
+                            makeFuncCall(fname, list_make1(end_id),
+                                         COERCE_SQL_SYNTAX, -1);
+                    }
+                }
+
                 /* make a transform entity for the vle */
                 vle_entity = transform_VLE_edge_entity(cpstate, rel, query);
 
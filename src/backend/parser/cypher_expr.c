@@ -1032,7 +1032,8 @@ static Node *transform_func_call(cypher_parsestate *cpstate, FuncCall *fn)
          */
         if ((list_length(targs) != 0) &&
             (strcmp("startnode", ag_name) == 0 || strcmp("endnode", ag_name) == 0 ||
-              strcmp("age_vle", ag_name) == 0 || strcmp("vertex_stats", ag_name) == 0))
+              strcmp("age_vle", ag_name) == 0 || strcmp("vertex_stats", ag_name) == 0 ||
+              strcmp("weighted_shortest_path", ag_name) == 0))
         {
             char *graph_name = cpstate->graph_name;
             Datum d = string_to_agtype(graph_name);
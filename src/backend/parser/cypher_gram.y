@@ -77,7 +77,7 @@
 %token NOT_EQ LT_EQ GT_EQ DOT_DOT TYPECAST PLUS_EQ EQ_TILDE
 
 /* keywords in alphabetical order */
-%token <keyword> ALL ANALYZE AND AS ASC ASCENDING
+%token <keyword> ALL ALLSHORTESTPATHS ANALYZE AND AS ASC ASCENDING
                  BY
                  CALL CASE COALESCE CONTAINS CREATE
                  DELETE DESC DESCENDING DETACH DISTINCT
@@ -89,7 +89,7 @@
                  NOT NULL_P
                  OPTIONAL OR ORDER
                  REMOVE RETURN
-                 SET SKIP STARTS
+                 SET SHORTESTPATH SKIP STARTS
                  THEN TRUE_P
                  UNION UNWIND
                  VERBOSE
@@ -142,7 +142,8 @@
 %type <list> pattern simple_path_opt_parens simple_path
 %type <node> path anonymous_path
              path_node path_relationship path_relationship_body
-             properties_opt
+             properties_opt vle_vertex_opt
+%type <integer> shortest_path_mode
 %type <string> label_opt
 
 /* expression */
@@ -220,6 +221,8 @@ static cypher_relationship *build_VLE_relation(List *left_arg,
                                                Node *right_arg,
                                                int left_arg_location,
                                                int cr_location);
+static void build_VLE_shortest_path(List *path, cypher_path_mode mode,
+                                    int location);
 // comparison
 static bool is_A_Expr_a_comparison_operation(A_Expr *a);
 static Node *build_comparison_expression(Node *left_grammar_node,
@@ -1031,12 +1034,48 @@ anonymous_path:
             n = make_ag_node(cypher_path);
             n->path = $1;
             n->var_name = NULL;
+            n->mode = CYPHER_PATH_ALL;
+            n->location = @1;
+
+            $$ = (Node *)n;
+        }
+    | shortest_path_mode '(' simple_path ')'
+        {
+            cypher_path *n;
+
+            /* the path must be a single variable length relationship */
+            if (list_length($3) != 3 ||
+                ((cypher_relationship *)lsecond($3))->varlen == NULL)
+            {
+                ereport(ERROR,
+                        (errcode(ERRCODE_SYNTAX_ERROR),
+                         errmsg("shortest path functions require a single variable length relationship"),
+                         ag_scanner_errposition(@3, scanner)));
+            }
+
+            build_VLE_shortest_path($3, $1, @1);
+
+            n = make_ag_node(cypher_path);
+            n->path = $3;
+            n->var_name = NULL;
+            n->mode = $1;
             n->location = @1;
 
             $$ = (Node *)n;
         }
     ;
 
+shortest_path_mode:
+    SHORTESTPATH
+        {
+            $$ = CYPHER_PATH_SHORTEST;
+        }
+    | ALLSHORTESTPATHS
+        {
+            $$ = CYPHER_PATH_ALL_SHORTEST;
+        }
+    ;
+
 simple_path_opt_parens:
     simple_path
     | '(' simple_path ')'
@@ -1120,15 +1159,33 @@ path_relationship:
     ;
 
 path_relationship_body:
-    '[' var_name_opt label_opt cypher_varlen_opt properties_opt ']'
+    '[' var_name_opt label_opt cypher_varlen_opt properties_opt
+        vle_vertex_opt ']'
         {
             cypher_relationship *n;
 
+            /* only a VLE has intermediate vertices to match */
+            if ($6 != NULL && $4 == NULL)
+            {
+                ereport(ERROR,
+                        (errcode(ERRCODE_SYNTAX_ERROR),
+                         errmsg("an intermediate vertex pattern requires a variable length relationship"),
+                         ag_scanner_errposition(@6, scanner)));
+            }
+            if ($6 != NULL && ((cypher_node *)$6)->name != NULL)
+            {
+                ereport(ERROR,
+                        (errcode(ERRCODE_SYNTAX_ERROR),
+                         errmsg("an intermediate vertex pattern cannot have a variable"),
+                         ag_scanner_errposition(@6, scanner)));
+            }
+
             n = make_ag_node(cypher_relationship);
             n->name = $2;
             n->label = $3;
             n->varlen = $4;
             n->props = $5;
+            n->vle_vertex = $6;
 
             $$ = (Node *)n;
         }
@@ -1142,11 +1199,24 @@ path_relationship_body:
             n->label = NULL;
             n->varlen = NULL;
             n->props = NULL;
+            n->vle_vertex = NULL;
 
             $$ = (Node *)n;
         }
     ;
 
+/*
+ * The pattern every vertex inside of a VLE path must match, for example
+ * -[:KNOWS*1..3 (:Person {active: true})]->
+ */
+vle_vertex_opt:
+    /* empty */
+        {
+            $$ = NULL;
+        }
+    | path_node
+    ;
+
 label_opt:
     /* empty */
         {
@@ -1700,6 +1770,7 @@ reserved_keyword:
 
 safe_keywords:
     ALL          { $$ = pnstrdup($1, 3); }
+    | ALLSHORTESTPATHS { $$ = pnstrdup($1, 16); }
     | ANALYZE    { $$ = pnstrdup($1, 7); }
     | AND        { $$ = pnstrdup($1, 3); }
     | AS         { $$ = pnstrdup($1, 2); }
@@ -1732,6 +1803,7 @@ safe_keywords:
     | REMOVE     { $$ = pnstrdup($1, 6); }
     | RETURN     { $$ = pnstrdup($1, 6); }
     | SET        { $$ = pnstrdup($1, 3); }
+    | SHORTESTPATH { $$ = pnstrdup($1, 12); }
     | SKIP       { $$ = pnstrdup($1, 4); }
     | STARTS     { $$ = pnstrdup($1, 6); }
     | THEN       { $$ = pnstrdup($1, 4); }
@@ -2171,7 +2243,6 @@ static cypher_relationship *build_VLE_relation(List *left_arg,
     cypher_node *cnl = NULL;
     cypher_node *cnr = NULL;
     Node *node = NULL;
-    int length = 0;
     unsigned long unique_number = 0;
     int location = 0;
 
@@ -2185,77 +2256,60 @@ static cypher_relationship *build_VLE_relation(List *left_arg,
     cnl = (cypher_node*)llast(left_arg);
     cnr = (cypher_node*)right_arg;
 
-    /* get the length of the left path */
-    length = list_length(left_arg);
-
-    /*
-     * If the left name is NULL and the left path is greater than 1
-     * If the left name is NULL and the left label is not NULL
-     * If the left name is NULL and the left props is not NULL
-     * If the left name is NULL and the right name is not NULL
-     * If the left name is NULL and the right label is not NULL
-     * If the left name is NULL and the right props is not NULL
-     * we need to create a variable name for the left node.
-     */
-    if ((cnl->name == NULL && length > 1) ||
-        (cnl->name == NULL && cnl->label != NULL) ||
-        (cnl->name == NULL && cnl->props != NULL) ||
-        (cnl->name == NULL && cnr->name != NULL) ||
-        (cnl->name == NULL && cnr->label != NULL) ||
-        (cnl->name == NULL && cnr->props != NULL))
-    {
-        cnl->name = create_unique_name("_vle_function_start_var");
-    }
-
-    /* add in the start vertex as a ColumnRef if necessary */
-    if (cnl->name != NULL)
-    {
-        cref = makeNode(ColumnRef);
-        cref->fields = list_make2(makeString(cnl->name), makeString("id"));
-        cref->location = left_arg_location;
-        args = lappend(args, cref);
-    }
-    /*
-     * If there aren't any variables in the VLE path, we can use
-     * the FROM_ALL algorithm.
-     */
-    else
-    {
-        args = lappend(args, make_null_const(-1));
-    }
-
     /*
      * Create a variable name for the end vertex if we have a label
      * name or props but we don't have a variable name.
      *
      * For example: ()-[*]-(:label) or ()-[*]-({name: "John"})
      *
-     * We need this so the addition of match_vle_terminal_edge is
-     * done in the transform phase.
+     * We need this so the end vertex is bound in the transform phase.
      */
     if (cnr->name == NULL &&
         (cnr->label != NULL || cnr->props != NULL))
     {
         cnr->name = create_unique_name("_vle_function_end_var");
     }
+
     /*
-     * We need a NULL for the target vertex in the VLE match to
-     * force the dfs_find_a_path_from algorithm. However, for now,
-     * the default will be to only do that when a target isn't
-     * supplied.
-     *
-     * TODO: We will likely want to force it to use
-     * dfs_find_a_path_from.
+     * If the left node is a lone anonymous node and the end vertex is bound,
+     * as in ()-[*]-(b) or ()-[*]-(:label), pass the end vertex instead of the
+     * start vertex. age_vle then walks every start vertex itself, but only
+     * searches for the paths that end at the given vertex.
      */
-    if (cnl->name == NULL && cnr->name != NULL)
+    if (list_length(left_arg) == 1 && cnl->name == NULL &&
+        cnl->label == NULL && cnl->props == NULL && cnr->name != NULL)
     {
+        args = lappend(args, make_null_const(-1));
+
         cref = makeNode(ColumnRef);
         cref->fields = list_make2(makeString(cnr->name), makeString("id"));
         cref->location = left_arg_location;
         args = lappend(args, cref);
     }
+    /*
+     * Otherwise, give the left node a variable name. This way the start
+     * vertices come from a scan of the vertex tables, rather than from
+     * age_vle walking every vertex in the graph itself. That scan can be a
+     * parallel scan, which splits the start vertices between the parallel
+     * workers.
+     *
+     * We need a NULL for the target vertex in the VLE match to force the
+     * dfs_find_a_path_from algorithm. The end vertex, if any, is matched by
+     * match_vle_terminal_edge instead. The transform replaces it when the
+     * WHERE clause fixes the id of the end vertex.
+     */
     else
     {
+        if (cnl->name == NULL)
+        {
+            cnl->name = create_unique_name("_vle_function_start_var");
+        }
+
+        cref = makeNode(ColumnRef);
+        cref->fields = list_make2(makeString(cnl->name), makeString("id"));
+        cref->location = left_arg_location;
+        args = lappend(args, cref);
+
         args = lappend(args, make_null_const(-1));
     }
 
@@ -2307,8 +2361,98 @@ static cypher_relationship *build_VLE_relation(List *left_arg,
     /* add in the unique number used to identify this VLE node */
     args = lappend(args, make_int_const(unique_number, -1));
 
+    /*
+     * Add in the intermediate vertex prototype, if any. It follows the path
+     * mode and the row bound, which are every path and no bound.
+     */
+    if (cr->vle_vertex != NULL)
+    {
+        cypher_node *cnv = (cypher_node *)cr->vle_vertex;
+        List *vargs = NIL;
+
+        if (cnv->label == NULL)
+        {
+            vargs = lappend(vargs, make_null_const(cnv->location));
+        }
+        else
+        {
+            vargs = lappend(vargs, make_string_const(cnv->label,
+                                                     cnv->location));
+        }
+        if (cnv->props == NULL)
+        {
+            vargs = lappend(vargs, make_null_const(cnv->location));
+        }
+        else
+        {
+            vargs = lappend(vargs, cnv->props);
+        }
+        fname = list_make2(makeString("ag_catalog"),
+                           makeString("age_build_vle_match_vertex"));
+        node = (Node *)makeFuncCall(fname, vargs, COERCE_SQL_SYNTAX,
+                                    cnv->location);
+
+        args = lappend(args, make_int_const(CYPHER_PATH_ALL, -1));
+        args = lappend(args, make_null_const(-1));
+        args = lappend(args, node);
+    }
+
     /* build the VLE function node */
     cr->varlen = (Node *)makeFuncCall(list_make1(makeString("age_vle")), args, COERCE_SQL_SYNTAX, cr_location); 
 
     return cr;
 }
+
+/*
+ * Helper function to turn the VLE function of a shortestPath() or
+ * allShortestPaths() path into a shortest path search. The search needs both
+ * the start and the end vertex, so that it knows where to stop, and the path
+ * mode is added as its last argument.
+ */
+static void build_VLE_shortest_path(List *path, cypher_path_mode mode,
+                                    int location)
+{
+    cypher_node *cnl = NULL;
+    cypher_node *cnr = NULL;
+    cypher_relationship *cr = NULL;
+    FuncCall *func = NULL;
+    ColumnRef *cref = NULL;
+
+    cnl = (cypher_node *)linitial(path);
+    cr = (cypher_relationship *)lsecond(path);
+    cnr = (cypher_node *)lthird(path);
+    func = (FuncCall *)cr->varlen;
+
+    /* add in the start vertex, if it isn't already */
+    if (cnl->name == NULL)
+    {
+        cnl->name = create_unique_name("_vle_function_start_var");
+
+        cref = makeNode(ColumnRef);
+        cref->fields = list_make2(makeString(cnl->name), makeString("id"));
+        cref->location = location;
+        linitial(func->args) = cref;
+    }
+
+    /* add in the end vertex */
+    if (cnr->name == NULL)
+    {
+        cnr->name = create_unique_name("_vle_function_end_var");
+    }
+
+    cref = makeNode(ColumnRef);
+    cref->fields = list_make2(makeString(cnr->name), makeString("id"));
+    cref->location = location;
+    lsecond(func->args) = cref;
+
+    /* add in the path mode, or replace it if it is already there */
+    if (list_length(func->args) > VLE_PATH_MODE_ARGNO)
+    {
+        lfirst(list_nth_cell(func->args, VLE_PATH_MODE_ARGNO)) =
+            make_int_const(mode, location);
+    }
+    else
+    {
+        func->args = lappend(func->args, make_int_const(mode, location));
+    }
+}
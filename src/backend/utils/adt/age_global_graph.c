@@ -19,22 +19,57 @@
 
 #include "postgres.h"
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "access/detoast.h"
 #include "access/heapam.h"
+#include "access/htup_details.h"
+#include "access/parallel.h"
 #include "access/relscan.h"
 #include "access/skey.h"
 #include "access/table.h"
 #include "access/tableam.h"
+#include "access/transam.h"
+#include "access/xact.h"
 #include "catalog/namespace.h"
+#include "catalog/pg_class.h"
 #include "commands/label_commands.h"
+#include "executor/executor.h"
+#include "funcapi.h"
+#include "lib/stringinfo.h"
+#include "miscadmin.h"
+#include "optimizer/cost.h"
+#include "optimizer/paths.h"
+#include "parser/parsetree.h"
+#include "pgstat.h"
+#include "portability/instr_time.h"
+#include "storage/bufmgr.h"
+#include "storage/dsm.h"
+#include "storage/fd.h"
+#include "storage/ipc.h"
+#include "storage/lmgr.h"
+#include "storage/lwlock.h"
+#include "storage/proc.h"
+#include "storage/shm_mq.h"
+#include "storage/shm_toc.h"
+#include "storage/shmem.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
 #include "utils/snapmgr.h"
+#include "utils/syscache.h"
+#include "utils/builtins.h"
+#include "utils/timestamp.h"
+#include "utils/tuplestore.h"
 #include "commands/label_commands.h"
 #include "common/hashfn.h"
 
 #include "catalog/ag_graph.h"
 #include "catalog/ag_label.h"
+#include "utils/ag_cache.h"
+#include "utils/ag_guc.h"
 #include "utils/age_global_graph.h"
 #include "utils/age_graphid_ds.h"
 #include "utils/agtype.h"
@@ -48,26 +83,49 @@
 #define EDGE_HTAB_NAME "Edge to vertex mapping " /* the graph name to follow */
 #define VERTEX_HTAB_INITIAL_SIZE 1000000
 #define EDGE_HTAB_INITIAL_SIZE 1000000
+#define SHARED_GRAPH_REGISTRY_NAME "AGE shared global graph registry"
+#define SHARED_GRAPH_LWLOCK_TRANCHE "age_shared_global_graph"
+#define SHARED_GRAPH_MAX_IMAGES 64
+#define SHARED_GRAPH_MAX_CHANGES 1024
+#define SHARED_GRAPH_RECENT_CHANGERS 8
+#define GRAPH_SNAPSHOT_DIR "age_graph_snapshots"
+#define GRAPH_SNAPSHOT_MAGIC 0x41474753 /* "AGGS" */
+#define GRAPH_SNAPSHOT_VERSION 2
+#define GRAPH_DELTA_MAX_XID_RANGE 1024
+#define GRAPH_DELTA_MAX_OWN_XIDS 1024
+#define CSR_DELETED_EDGE ((graphid) 0) /* no edge has a label id of 0 */
+#define CSR_INITIAL_EDGE_IDS 1024
+#define VERTEX_INDEX_INITIAL_SIZE 1024
+#define PARALLEL_LOAD_KEY_SHARED UINT64CONST(0xA6E0000000000001)
+#define PARALLEL_LOAD_KEY_SCANS UINT64CONST(0xA6E0000000000002)
+#define PARALLEL_LOAD_KEY_QUEUES UINT64CONST(0xA6E0000000000003)
+#define PARALLEL_LOAD_QUEUE_SIZE ((Size) 1024 * 1024)
+#define GLOBAL_GRAPH_STATS_COLUMNS 8
 
 /* internal data structures implementation */
 
-/* vertex entry for the vertex_hastable */
+/* vertex entry for the vertex_hastable, or for a shared image */
 typedef struct vertex_entry
 {
     graphid vertex_id;             /* vertex id, it is also the hash key */
-    ListGraphId *edges_in;         /* List of entering edges graphids (int64) */
-    ListGraphId *edges_out;        /* List of exiting edges graphids (int64) */
-    ListGraphId *edges_self;       /* List of selfloop edges graphids (int64) */
+    uint32 vertex_index;           /* dense index of the vertex */
+    ListGraphId *edges_in;         /* entering edges added after the CSR */
+    ListGraphId *edges_out;        /* exiting edges added after the CSR */
+    ListGraphId *edges_self;       /* selfloop edges added after the CSR */
     Oid vertex_label_table_oid;    /* the label table oid */
-    Datum vertex_properties;       /* datum property value */
+    ItemPointerData tid;           /* the vertex's tuple in the label table */
+    Datum vertex_properties;       /* datum property value, 0 if not loaded */
+    Size properties_offset;        /* properties offset from it, in an image */
 } vertex_entry;
 
-/* edge entry for the edge_hashtable */
+/* edge entry for the edge_hashtable, or for a shared image */
 typedef struct edge_entry
 {
     graphid edge_id;               /* edge id, it is also the hash key */
     Oid edge_label_table_oid;      /* the label table oid */
-    Datum edge_properties;         /* datum property value */
+    ItemPointerData tid;           /* the edge's tuple in the label table */
+    Datum edge_properties;         /* datum property value, 0 if not loaded */
+    Size properties_offset;        /* properties offset from it, in an image */
     graphid start_vertex_id;       /* start vertex */
     graphid end_vertex_id;         /* end vertex */
 } edge_entry;
@@ -83,66 +141,414 @@ typedef struct GRAPH_global_context
     Oid graph_oid;                 /* graph oid for searching */
     HTAB *vertex_hashtable;        /* hashtable to hold vertex edge lists */
     HTAB *edge_hashtable;          /* hashtable to hold edge to vertex map */
+    /* image the entries are found in instead, while not hashed */
+    struct shared_graph_image *image;
     TransactionId xmin;            /* transaction ids for this graph */
     TransactionId xmax;
     CommandId curcid;              /* currentCommandId graph was created with */
     int64 num_loaded_vertices;     /* number of loaded vertices in this graph */
     int64 num_loaded_edges;        /* number of loaded edges in this graph */
-    ListGraphId *vertices;         /* vertices for vertex hashtable cleanup */
+    TransactionId *xip;            /* sorted in progress xids of snapshot */
+    uint32 xcnt;                   /* number of xids in xip */
+    /* vertex entries by dense vertex index, NULL if deleted */
+    vertex_entry **vertex_index_entries;
+    uint32 num_vertex_indexes;     /* number of dense vertex indexes used */
+    uint32 max_vertex_indexes;     /* allocated size of vertex_index_entries */
+    int64 csr_num_vertices;        /* number of vertices in the CSR arrays */
+    /* CSR adjacency arrays, per edge direction, indexed by vertex_index */
+    int64 *csr_offsets[NUM_VERTEX_EDGE_DIRECTIONS];
+    adjacency_entry *csr_entries[NUM_VERTEX_EDGE_DIRECTIONS];
+    int64 csr_num_entries[NUM_VERTEX_EDGE_DIRECTIONS];
+    dsm_segment *shared_image;     /* attached shared image, if any */
+    char *mapped_file;             /* mapped snapshot file, if any */
+    Size mapped_file_size;
+    bool csr_in_image;             /* CSR arrays are in an image, read only */
+    List *deltas;                  /* logged changes not yet applied */
+    bool deltas_invalid;           /* changes may be missing or rolled back */
+    TransactionId *own_xids;       /* our xids committed since built */
+    int num_own_xids;
+    List *delta_properties;        /* properties copied for applied deltas */
+    int64 version;                 /* incremented when deltas are applied */
+    MemoryContext load_context;    /* properties copied by a parallel load */
+    bool lazy_properties;          /* properties were left in the tables */
+    /* label tables, and their relfilenodes, that lazy properties are in */
+    Oid *label_relids;
+    Oid *label_relfilenodes;
+    int num_label_relids;
+    bool changes_counted;          /* the change counts below are usable */
+    uint64 change_generation;      /* the graph's change counts when loaded */
+    uint64 all_change_generation;
+    MemoryContext memory_context;  /* holds the graph's private memory */
+    TimestampTz loaded_at;         /* when the graph was loaded */
+    double load_time;              /* milliseconds taken to load the graph */
+    int64 num_hits;                /* times the loaded graph was reused */
+    uint64 last_used;              /* LRU clock value of the last use */
+    LocalTransactionId last_used_lxid; /* local transaction of the last use */
     struct GRAPH_global_context *next; /* next graph */
 } GRAPH_global_context;
 
+/* the kinds of changes that can be logged against a GRAPH global context */
+typedef enum GRAPH_delta_type
+{
+    GRAPH_DELTA_INSERT_VERTEX,
+    GRAPH_DELTA_INSERT_EDGE,
+    GRAPH_DELTA_UPDATE,
+    GRAPH_DELTA_DELETE
+} GRAPH_delta_type;
+
+/*
+ * A change made by this backend, through Cypher, to a graph that has a GRAPH
+ * global context. Deltas are applied to the context, instead of rebuilding it,
+ * once they are visible to the active snapshot.
+ */
+typedef struct GRAPH_delta
+{
+    GRAPH_delta_type type;         /* kind of change */
+    graphid id;                    /* vertex or edge id */
+    graphid start_vertex_id;       /* start vertex, edge inserts only */
+    graphid end_vertex_id;         /* end vertex, edge inserts only */
+    Oid label_table_oid;           /* the label table oid, inserts only */
+    Datum properties;              /* copied properties, inserts and updates */
+    LocalTransactionId lxid;       /* local transaction of the change */
+    CommandId cid;                 /* command id of the change */
+} GRAPH_delta;
+
+/*
+ * A shared GRAPH global image is a flat, position independent, copy of the
+ * vertices and edges of a GRAPH global context, along with their detoasted
+ * properties and CSR adjacency arrays. It lives in a dynamic shared memory
+ * segment so that it can be mapped, at any address, by any backend. The
+ * layout is -
+ *
+ *     shared_graph_image header
+ *     vertex_entry array, in dense index order
+ *     vertex array indexes, in vertex id order
+ *     edge_entry array, in edge id order
+ *     CSR offsets and entries arrays, per edge direction
+ *     properties (agtype varlenas)
+ *
+ * All references within the image are offsets from the start of the image,
+ * except for the properties of an entry, which are at an offset from the
+ * entry. The entries are used in place, and found with a binary search, by
+ * the backends that attach to the image.
+ */
+typedef struct shared_graph_image
+{
+    Oid graph_oid;                 /* graph oid the image was built from */
+    int64 num_vertices;            /* number of entries in the vertex array */
+    int64 num_edges;               /* number of entries in the edge array */
+    Size vertices_offset;          /* offset of the vertex array */
+    Size vertex_order_offset;      /* offset of the vertex id order */
+    Size edges_offset;             /* offset of the edge array */
+    /* offsets of the CSR arrays, per edge direction */
+    Size csr_offsets_offset[NUM_VERTEX_EDGE_DIRECTIONS];
+    Size csr_entries_offset[NUM_VERTEX_EDGE_DIRECTIONS];
+    int64 csr_num_entries[NUM_VERTEX_EDGE_DIRECTIONS];
+    Size total_size;               /* size of the entire image */
+} shared_graph_image;
+
+/*
+ * A registry slot for one shared image. Along with the segment handle, it
+ * holds the graph's change counts when the image was built, and the xmin of
+ * the snapshot it was built with. While the graph's change counts stay the
+ * same, any snapshot that sees all of its committed changes, and that is no
+ * older than the image's snapshot, sees the same graph as the image.
+ */
+typedef struct shared_graph_slot
+{
+    Oid database_oid;              /* InvalidOid if the slot is unused */
+    Oid graph_oid;                 /* graph oid for searching */
+    dsm_handle handle;             /* handle of the pinned image segment */
+    uint64 generation;             /* change counts the image was built at */
+    uint64 all_generation;
+    TransactionId xmin;            /* xmin of the snapshot it was built with */
+} shared_graph_slot;
+
+/*
+ * The most recent transactions that committed changes to a graph. A snapshot
+ * sees all of the graph's committed changes if it sees each of these, and is
+ * newer than any that were pushed out.
+ */
+typedef struct shared_graph_changers
+{
+    TransactionId xids[SHARED_GRAPH_RECENT_CHANGERS];
+    uint32 next;                   /* the next xids entry to replace */
+    TransactionId evicted_xid;     /* latest xid pushed out, if any */
+} shared_graph_changers;
+
+/*
+ * The committed changes to one graph. Transactions that changed the graph
+ * count themselves as pending from pre-commit until they have committed or
+ * aborted, and bump the generation when they commit. A graph's contents, as
+ * seen by a snapshot, can only differ from what was loaded while its
+ * generation and pending count are unchanged if the snapshot is older.
+ */
+typedef struct shared_graph_change
+{
+    Oid database_oid;              /* InvalidOid if the entry is unused */
+    Oid graph_oid;                 /* graph oid for searching */
+    uint64 generation;             /* number of committed changes */
+    uint32 pending;                /* changing transactions now committing */
+    shared_graph_changers changers; /* the latest committed changers */
+} shared_graph_change;
+
+/* the registry of shared images, kept in the main shared memory segment */
+typedef struct shared_graph_registry
+{
+    LWLock *lock;                  /* protects the slots and changes */
+    shared_graph_slot slots[SHARED_GRAPH_MAX_IMAGES];
+    TimestampTz epoch;             /* when the change counts were started */
+    /* changes to any graph, and to graphs without a change entry */
+    uint64 all_generation;
+    uint32 all_pending;
+    shared_graph_changers all_changers;
+    shared_graph_change changes[SHARED_GRAPH_MAX_CHANGES];
+} shared_graph_registry;
+
+/*
+ * The header of a graph snapshot file. It is followed, at a MAXALIGN'd offset,
+ * by a shared_graph_image. The file can be used by a snapshot that sees every
+ * transaction the saving snapshot saw, so long as the graph hasn't changed
+ * since.
+ */
+typedef struct graph_snapshot_header
+{
+    uint32 magic;                  /* GRAPH_SNAPSHOT_MAGIC */
+    uint32 version;                /* GRAPH_SNAPSHOT_VERSION */
+    Oid database_oid;              /* database of the graph */
+    Oid graph_oid;                 /* graph oid the image was built from */
+    TimestampTz epoch;             /* registry epoch of the change counts */
+    uint64 generation;             /* change counts the image was built at */
+    uint64 all_generation;
+    TransactionId xmax;            /* xmax of the saving snapshot */
+    Size image_size;               /* size of the image that follows */
+} graph_snapshot_header;
+
+/* a label table to be scanned by a parallel load */
+typedef struct parallel_load_label
+{
+    Oid label_table_oid;           /* the label table oid */
+    char label_kind;               /* LABEL_KIND_VERTEX or LABEL_KIND_EDGE */
+} parallel_load_label;
+
+/*
+ * The shared state of a parallel load. Every worker scans every label table,
+ * in order, through a parallel heap scan. So, each one gets a different set
+ * of blocks from each table.
+ */
+typedef struct parallel_load_shared
+{
+    Size scan_size;                /* size of each parallel scan descriptor */
+    bool lazy_properties;          /* don't send the properties */
+    int num_labels;                /* number of label tables */
+    parallel_load_label labels[FLEXIBLE_ARRAY_MEMBER];
+} parallel_load_shared;
+
+/*
+ * A vertex or edge sent by a parallel load worker to the loading backend. It
+ * is followed, in the message, by its detoasted properties, unless they are
+ * fetched lazily.
+ */
+typedef struct parallel_load_entity
+{
+    char label_kind;               /* LABEL_KIND_VERTEX or LABEL_KIND_EDGE */
+    Oid label_table_oid;           /* the label table oid */
+    ItemPointerData tid;           /* the tuple in the label table */
+    graphid id;                    /* vertex or edge id */
+    graphid start_vertex_id;       /* start vertex, edges only */
+    graphid end_vertex_id;         /* end vertex, edges only */
+} parallel_load_entity;
+
 /* global variable to hold the per process GRAPH global context */
 static GRAPH_global_context *global_graph_contexts = NULL;
+/* advanced each time a GRAPH global context is used, for LRU eviction */
+static uint64 global_graph_lru_clock = 0;
+
+/* the shared image registry, NULL if age isn't in shared_preload_libraries */
+static shared_graph_registry *shared_registry = NULL;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+/* the graphs changed by the current transaction */
+static List *xact_changed_graphs = NIL;
+static bool xact_changed_all_graphs = false;
+/* are those counted as pending in the registry, and by which xid */
+static bool xact_changes_pending = false;
+static TransactionId xact_changes_xid = InvalidTransactionId;
+static ExecutorStart_hook_type prev_executor_start_hook = NULL;
 
 /* declarations */
 /* GRAPH global context functions */
 static void free_specific_GRAPH_global_context(GRAPH_global_context *ggctx);
 static bool delete_specific_GRAPH_global_contexts(char *graph_name);
 static bool delete_GRAPH_global_contexts(void);
+static void touch_GRAPH_global_context(GRAPH_global_context *ggctx);
+static void evict_GRAPH_global_contexts(GRAPH_global_context *keep_ggctx);
 static void create_GRAPH_global_hashtables(GRAPH_global_context *ggctx);
 static void load_GRAPH_global_hashtables(GRAPH_global_context *ggctx);
 static void load_vertex_hashtable(GRAPH_global_context *ggctx);
-static void load_edge_hashtable(GRAPH_global_context *ggctx);
-static void freeze_GRAPH_global_hashtables(GRAPH_global_context *ggctx);
+static void load_edge_hashtable(GRAPH_global_context *ggctx,
+                                graphid **edge_ids, int64 *num_edge_ids);
+static bool load_GRAPH_global_hashtables_parallel(GRAPH_global_context *ggctx,
+                                                  graphid **edge_ids,
+                                                  int64 *num_edge_ids);
+static int compute_load_workers(BlockNumber num_blocks);
+static void insert_parallel_loaded_entity(GRAPH_global_context *ggctx,
+                                          char *data, Size nbytes,
+                                          graphid **edge_ids,
+                                          int64 *num_edge_ids,
+                                          int64 *max_edge_ids);
+static void order_parallel_loaded_entities(GRAPH_global_context *ggctx,
+                                           graphid *edge_ids,
+                                           int64 num_edge_ids);
+static int graphid_cmp(const void *a, const void *b);
+static int vertex_entry_id_cmp(const void *a, const void *b);
+static void build_GRAPH_global_csr(GRAPH_global_context *ggctx,
+                                   graphid *edge_ids, int64 num_edge_ids);
+static bool delete_csr_edge(GRAPH_global_context *ggctx, vertex_entry *ve,
+                            vertex_edge_direction direction, graphid edge_id);
 static List *get_ag_labels_names(Snapshot snapshot, Oid graph_oid,
                                  char label_type);
 static bool insert_edge(GRAPH_global_context *ggctx, graphid edge_id,
                         Datum edge_properties, graphid start_vertex_id,
-                        graphid end_vertex_id, Oid edge_label_table_oid);
+                        graphid end_vertex_id, Oid edge_label_table_oid,
+                        ItemPointer tid);
 static bool insert_vertex_edge(GRAPH_global_context *ggctx,
                                graphid start_vertex_id, graphid end_vertex_id,
                                graphid edge_id);
 static bool insert_vertex_entry(GRAPH_global_context *ggctx, graphid vertex_id,
                                 Oid vertex_label_table_oid,
-                                Datum vertex_properties);
+                                Datum vertex_properties, ItemPointer tid);
+static Datum fetch_entity_properties(Oid label_table_oid, ItemPointer tid,
+                                     graphid id, int column);
+static void lock_GRAPH_global_label_tables(GRAPH_global_context *ggctx);
+static bool have_GRAPH_global_label_tables_moved(GRAPH_global_context *ggctx);
+static Oid get_label_table_relfilenode(Oid label_table_oid);
+/* parallel load worker entry point, it is looked up by name */
+PGDLLEXPORT void age_global_graph_load_worker(dsm_segment *seg,
+                                              shm_toc *toc);
+/* GRAPH global shared image functions */
+static void global_graph_shmem_startup(void);
+static bool can_share_snapshot(Snapshot snapshot);
+static int xid_cmp(const void *a, const void *b);
+static shared_graph_slot *find_shared_graph_slot(Oid graph_oid);
+static bool attach_shared_GRAPH_global_image(GRAPH_global_context *ggctx);
+static void use_GRAPH_global_image(GRAPH_global_context *ggctx,
+                                   shared_graph_image *image);
+static void hash_GRAPH_global_image(GRAPH_global_context *ggctx);
+static vertex_entry *find_image_vertex_entry(shared_graph_image *image,
+                                             graphid vertex_id);
+static edge_entry *find_image_edge_entry(shared_graph_image *image,
+                                         graphid edge_id);
+static int image_vertex_order_cmp(const void *a, const void *b, void *arg);
+static int edge_entry_cmp(const void *a, const void *b);
+static Size get_GRAPH_global_image_size(GRAPH_global_context *ggctx);
+static void build_GRAPH_global_image(GRAPH_global_context *ggctx, char *base,
+                                     Size size);
+static void publish_shared_GRAPH_global_image(GRAPH_global_context *ggctx);
+static Size copy_properties_to_image(char *base, Size offset,
+                                     Datum properties);
+static bool remove_shared_GRAPH_global_images(Oid graph_oid);
+/* GRAPH change tracking and snapshot file functions */
+static void note_GRAPH_global_change(Oid graph_oid);
+static bool is_graph_changed_by_xact(Oid graph_oid);
+static shared_graph_change *find_shared_graph_change(Oid graph_oid,
+                                                     bool create);
+static void get_shared_graph_change_counts(Oid graph_oid, uint64 *generation,
+                                           uint64 *all_generation,
+                                           uint32 *pending);
+static void count_GRAPH_global_changes_pending(void);
+static void count_GRAPH_global_changes_done(bool committed);
+static void add_shared_graph_changer(shared_graph_changers *changers,
+                                     TransactionId xid);
+static bool snapshot_sees_changers(shared_graph_changers *changers,
+                                   Snapshot snapshot);
+static bool snapshot_sees_graph_changes(Oid graph_oid, Snapshot snapshot,
+                                        uint64 *generation,
+                                        uint64 *all_generation);
+static void count_GRAPH_global_context_changes(GRAPH_global_context *ggctx,
+                                               Snapshot snapshot);
+static void get_graph_snapshot_file_path(Oid graph_oid, char *path);
+static bool save_GRAPH_global_snapshot_file(char *graph_name, Oid graph_oid);
+static bool attach_GRAPH_global_snapshot_file(GRAPH_global_context *ggctx);
+/* GRAPH global delta functions */
+static void log_GRAPH_global_delta(Oid graph_oid, GRAPH_delta *delta);
+static bool apply_GRAPH_global_deltas(GRAPH_global_context *ggctx);
+static bool apply_GRAPH_global_delta(GRAPH_global_context *ggctx,
+                                     GRAPH_delta *delta);
+static bool delete_GRAPH_global_entity(GRAPH_global_context *ggctx,
+                                       graphid id);
+static bool is_snapshot_change_own(GRAPH_global_context *ggctx,
+                                   Snapshot snapshot);
+static bool is_own_xid(GRAPH_global_context *ggctx, TransactionId xid);
+static void set_GRAPH_global_snapshot(GRAPH_global_context *ggctx,
+                                      Snapshot snapshot);
+static void free_GRAPH_global_deltas(GRAPH_global_context *ggctx);
+static void discard_GRAPH_global_deltas(Oid graph_oid);
+static void global_graph_ExecutorStart(QueryDesc *queryDesc, int eflags);
+static void global_graph_xact_callback(XactEvent event, void *arg);
+static void global_graph_subxact_callback(SubXactEvent event,
+                                          SubTransactionId mySubid,
+                                          SubTransactionId parentSubid,
+                                          void *arg);
 /* definitions */
 
 /*
  * Helper function to determine validity of the passed GRAPH_global_context.
  * This is based off of the current active snaphot, to see if the graph could
- * have been modified. Ideally, we should find a way to more accurately know
- * whether the particular graph was modified.
+ * have been modified. When the graph's change counts are kept in shared
+ * memory, a context stays valid for a newer snapshot as long as that graph
+ * hasn't changed, and the snapshot sees every change it has had.
  */
 bool is_ggctx_invalid(GRAPH_global_context *ggctx)
 {
     Snapshot snap = GetActiveSnapshot();
+    uint64 generation;
+    uint64 all_generation;
+
+    /*
+     * Lazily fetched properties are found by their tuples' TIDs, which a
+     * rewrite of a label table, by VACUUM FULL or CLUSTER, moves without
+     * changing the graph's change counts.
+     */
+    if (ggctx->lazy_properties && have_GRAPH_global_label_tables_moved(ggctx))
+    {
+        return true;
+    }
+
+    /* the same snapshot sees the same graph */
+    if (ggctx->xmin == snap->xmin &&
+        ggctx->xmax == snap->xmax &&
+        ggctx->curcid == snap->curcid)
+    {
+        return false;
+    }
 
     /*
-     * If the transaction ids (xmin or xmax) or currentCommandId (curcid) have
-     * changed, then we have a graph that was updated. This means that the
-     * global context for this graph is no longer valid.
+     * Otherwise, if the transaction ids (xmin or xmax) or currentCommandId
+     * (curcid) have changed, the graph may have been updated. Unless its change
+     * counts say that it wasn't, this global context is no longer valid. Our
+     * own uncommitted changes aren't counted.
      */
-    return (ggctx->xmin != snap->xmin ||
-            ggctx->xmax != snap->xmax ||
-            ggctx->curcid != snap->curcid);
+    if (ggctx->changes_counted &&
+        !is_graph_changed_by_xact(ggctx->graph_oid) &&
+        snapshot_sees_graph_changes(ggctx->graph_oid, snap, &generation,
+                                    &all_generation) &&
+        generation == ggctx->change_generation &&
+        all_generation == ggctx->all_change_generation)
+    {
+        /* it now represents the graph as of this snapshot */
+        set_GRAPH_global_snapshot(ggctx, snap);
+        return false;
+    }
 
+    return true;
 }
 /*
  * Helper function to create the global vertex and edge hashtables. One
- * hashtable will hold the vertex, its edges (both incoming and exiting) as a
- * list, and its properties datum. The other hashtable will hold the edge, its
- * properties datum, and its source and target vertex.
+ * hashtable will hold the vertex, its index into the CSR adjacency arrays, and
+ * its properties datum. The other hashtable will hold the edge, its
+ * properties datum, and its source and target vertex. They are created in the
+ * graph's memory context.
  */
 static void create_GRAPH_global_hashtables(GRAPH_global_context *ggctx)
 {
@@ -177,9 +583,11 @@ static void create_GRAPH_global_hashtables(GRAPH_global_context *ggctx)
     vertex_ctl.keysize = sizeof(int64);
     vertex_ctl.entrysize = sizeof(vertex_entry);
     vertex_ctl.hash = tag_hash;
+    vertex_ctl.hcxt = ggctx->memory_context;
     ggctx->vertex_hashtable = hash_create(vhn, VERTEX_HTAB_INITIAL_SIZE,
                                           &vertex_ctl,
-                                          HASH_ELEM | HASH_FUNCTION);
+                                          HASH_ELEM | HASH_FUNCTION |
+                                          HASH_CONTEXT);
     pfree(vhn);
 
     /* initialize the edge hashtable */
@@ -187,8 +595,10 @@ static void create_GRAPH_global_hashtables(GRAPH_global_context *ggctx)
     edge_ctl.keysize = sizeof(int64);
     edge_ctl.entrysize = sizeof(edge_entry);
     edge_ctl.hash = tag_hash;
+    edge_ctl.hcxt = ggctx->memory_context;
     ggctx->edge_hashtable = hash_create(ehn, EDGE_HTAB_INITIAL_SIZE, &edge_ctl,
-                                        HASH_ELEM | HASH_FUNCTION);
+                                        HASH_ELEM | HASH_FUNCTION |
+                                        HASH_CONTEXT);
     pfree(ehn);
 }
 
@@ -213,7 +623,7 @@ static List *get_ag_labels_names(Snapshot snapshot, Oid graph_oid,
                 F_CHAREQ, CharGetDatum(label_type));
 
     /* setup the table to be scanned, ag_label in this case */
-    ag_label = table_open(ag_label_relation_id(), ShareLock);
+    ag_label = table_open(ag_label_relation_id(), AccessShareLock);
     scan_desc = table_beginscan(ag_label, snapshot, 2, scan_keys);
 
     /* get the tupdesc - we don't need to release this one */
@@ -239,7 +649,7 @@ static List *get_ag_labels_names(Snapshot snapshot, Oid graph_oid,
 
     /* close up scan */
     table_endscan(scan_desc);
-    table_close(ag_label, ShareLock);
+    table_close(ag_label, AccessShareLock);
 
     return labels;
 }
@@ -250,7 +660,8 @@ static List *get_ag_labels_names(Snapshot snapshot, Oid graph_oid,
  */
 static bool insert_edge(GRAPH_global_context *ggctx, graphid edge_id,
                         Datum edge_properties, graphid start_vertex_id,
-                        graphid end_vertex_id, Oid edge_label_table_oid)
+                        graphid end_vertex_id, Oid edge_label_table_oid,
+                        ItemPointer tid)
 {
     edge_entry *value = NULL;
     bool found = false;
@@ -281,6 +692,15 @@ static bool insert_edge(GRAPH_global_context *ggctx, graphid edge_id,
     value->start_vertex_id = start_vertex_id;
     value->end_vertex_id = end_vertex_id;
     value->edge_label_table_oid = edge_label_table_oid;
+    /* the tuple, for fetching properties that weren't loaded */
+    if (tid != NULL)
+    {
+        value->tid = *tid;
+    }
+    else
+    {
+        ItemPointerSetInvalid(&value->tid);
+    }
 
     /* increment the number of loaded edges */
     ggctx->num_loaded_edges++;
@@ -294,7 +714,7 @@ static bool insert_edge(GRAPH_global_context *ggctx, graphid edge_id,
  */
 static bool insert_vertex_entry(GRAPH_global_context *ggctx, graphid vertex_id,
                                 Oid vertex_label_table_oid,
-                                Datum vertex_properties)
+                                Datum vertex_properties, ItemPointer tid)
 {
     vertex_entry *ve = NULL;
     bool found = false;
@@ -317,18 +737,55 @@ static bool insert_vertex_entry(GRAPH_global_context *ggctx, graphid vertex_id,
      * used for hash function collisions.
      */
     ve->vertex_id = vertex_id;
+    /* give it the next dense index */
+    if (ggctx->num_vertex_indexes == PG_UINT32_MAX)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+                 errmsg("too many vertices in graph \"%s\"",
+                        ggctx->graph_name)));
+    }
+    if (ggctx->num_vertex_indexes == ggctx->max_vertex_indexes)
+    {
+        if (ggctx->vertex_index_entries == NULL)
+        {
+            ggctx->max_vertex_indexes = VERTEX_INDEX_INITIAL_SIZE;
+            ggctx->vertex_index_entries =
+                MemoryContextAllocHuge(ggctx->memory_context,
+                                       sizeof(vertex_entry *) *
+                                       ggctx->max_vertex_indexes);
+        }
+        else
+        {
+            ggctx->max_vertex_indexes =
+                (uint32) Min((uint64) ggctx->max_vertex_indexes * 2,
+                             (uint64) PG_UINT32_MAX);
+            ggctx->vertex_index_entries =
+                repalloc_huge(ggctx->vertex_index_entries,
+                              sizeof(vertex_entry *) *
+                              ggctx->max_vertex_indexes);
+        }
+    }
+    ve->vertex_index = ggctx->num_vertex_indexes++;
+    ggctx->vertex_index_entries[ve->vertex_index] = ve;
     /* set the label table oid for this vertex */
     ve->vertex_label_table_oid = vertex_label_table_oid;
     /* set the datum vertex properties */
     ve->vertex_properties = vertex_properties;
+    /* the tuple, for fetching properties that weren't loaded */
+    if (tid != NULL)
+    {
+        ve->tid = *tid;
+    }
+    else
+    {
+        ItemPointerSetInvalid(&ve->tid);
+    }
     /* set the NIL edge list */
     ve->edges_in = NULL;
     ve->edges_out = NULL;
     ve->edges_self = NULL;
 
-    /* we also need to store the vertex id for clean up of vertex lists */
-    ggctx->vertices = append_graphid(ggctx->vertices, vertex_id);
-
     /* increment the number of loaded vertices */
     ggctx->num_loaded_vertices++;
 
@@ -337,7 +794,8 @@ static bool insert_vertex_entry(GRAPH_global_context *ggctx, graphid vertex_id,
 
 /*
  * Helper function to append one edge to an existing vertex in the current
- * global vertex hashtable.
+ * global vertex hashtable. This is for edges added after the CSR arrays were
+ * built; they are kept in the vertex's lists, after its CSR entries.
  */
 static bool insert_vertex_edge(GRAPH_global_context *ggctx,
                                graphid start_vertex_id, graphid end_vertex_id,
@@ -388,6 +846,136 @@ static bool insert_vertex_edge(GRAPH_global_context *ggctx,
     return found;
 }
 
+/*
+ * Helper function to fetch the properties of a vertex or edge, that weren't
+ * loaded, from its tuple in the label table. The tuple must be visible to the
+ * active snapshot, and still be the entity's; the context would have been
+ * invalidated otherwise. The properties are returned as a detoasted copy.
+ */
+static Datum fetch_entity_properties(Oid label_table_oid, ItemPointer tid,
+                                     graphid id, int column)
+{
+    Relation label_relation;
+    HeapTupleData tuple;
+    Buffer buffer;
+    Datum properties;
+
+    if (!ItemPointerIsValid(tid))
+    {
+        elog(ERROR, "fetch_entity_properties: properties are not available");
+    }
+
+    label_relation = table_open(label_table_oid, AccessShareLock);
+
+    tuple.t_self = *tid;
+    if (!heap_fetch(label_relation, GetActiveSnapshot(), &tuple, &buffer))
+    {
+        elog(ERROR, "fetch_entity_properties: tuple (%u,%u) of %s not found",
+             ItemPointerGetBlockNumber(tid), ItemPointerGetOffsetNumber(tid),
+             RelationGetRelationName(label_relation));
+    }
+
+    /* a tuple moved into its place must not be taken for it */
+    if (DatumGetInt64(column_get_datum(RelationGetDescr(label_relation),
+                                       &tuple, 0, "id", GRAPHIDOID,
+                                       true)) != id)
+    {
+        elog(ERROR, "fetch_entity_properties: tuple (%u,%u) of %s has moved",
+             ItemPointerGetBlockNumber(tid), ItemPointerGetOffsetNumber(tid),
+             RelationGetRelationName(label_relation));
+    }
+
+    properties = column_get_datum(RelationGetDescr(label_relation), &tuple,
+                                  column, "properties", AGTYPEOID, true);
+    properties = PointerGetDatum(PG_DETOAST_DATUM_COPY(properties));
+
+    ReleaseBuffer(buffer);
+    /* keep the lock, so the table can't be rewritten under the TIDs */
+    table_close(label_relation, NoLock);
+
+    return properties;
+}
+
+/*
+ * Helper function to lock the label tables of a graph whose properties are
+ * fetched lazily, and to remember their relfilenodes. The locks are held to
+ * the end of the transaction, so they can't be rewritten during the load.
+ */
+static void lock_GRAPH_global_label_tables(GRAPH_global_context *ggctx)
+{
+    Snapshot snapshot = GetActiveSnapshot();
+    Oid graph_namespace_oid;
+    List *label_names = NIL;
+    ListCell *lc;
+    int i = 0;
+
+    graph_namespace_oid = get_namespace_oid(ggctx->graph_name, false);
+    label_names = list_concat(get_ag_labels_names(snapshot, ggctx->graph_oid,
+                                                  LABEL_TYPE_VERTEX),
+                              get_ag_labels_names(snapshot, ggctx->graph_oid,
+                                                  LABEL_TYPE_EDGE));
+
+    ggctx->num_label_relids = list_length(label_names);
+    ggctx->label_relids = palloc(sizeof(Oid) *
+                                 Max(ggctx->num_label_relids, 1));
+    ggctx->label_relfilenodes = palloc(sizeof(Oid) *
+                                       Max(ggctx->num_label_relids, 1));
+
+    foreach (lc, label_names)
+    {
+        Oid label_table_oid = get_relname_relid(lfirst(lc),
+                                                graph_namespace_oid);
+
+        LockRelationOid(label_table_oid, AccessShareLock);
+        ggctx->label_relids[i] = label_table_oid;
+        ggctx->label_relfilenodes[i] =
+            get_label_table_relfilenode(label_table_oid);
+        i++;
+    }
+}
+
+/*
+ * Helper function to check if any label table of a graph whose properties are
+ * fetched lazily has been rewritten since it was loaded. Each table is locked
+ * first, which also brings the catalog up to date, and keeps it from being
+ * rewritten for the rest of the transaction.
+ */
+static bool have_GRAPH_global_label_tables_moved(GRAPH_global_context *ggctx)
+{
+    int i;
+
+    for (i = 0; i < ggctx->num_label_relids; i++)
+    {
+        LockRelationOid(ggctx->label_relids[i], AccessShareLock);
+
+        if (get_label_table_relfilenode(ggctx->label_relids[i]) !=
+            ggctx->label_relfilenodes[i])
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* helper function to get a label table's relfilenode, InvalidOid if dropped */
+static Oid get_label_table_relfilenode(Oid label_table_oid)
+{
+    HeapTuple tuple;
+    Oid relfilenode;
+
+    tuple = SearchSysCache1(RELOID, ObjectIdGetDatum(label_table_oid));
+    if (!HeapTupleIsValid(tuple))
+    {
+        return InvalidOid;
+    }
+
+    relfilenode = ((Form_pg_class) GETSTRUCT(tuple))->relfilenode;
+    ReleaseSysCache(tuple);
+
+    return relfilenode;
+}
+
 /* helper routine to load all vertices into the GRAPH global vertex hashtable */
 static void load_vertex_hashtable(GRAPH_global_context *ggctx)
 {
@@ -421,7 +1009,7 @@ static void load_vertex_hashtable(GRAPH_global_context *ggctx)
         vertex_label_table_oid = get_relname_relid(vertex_label_name,
                                                    graph_namespace_oid);
         /* open the relation (table) and begin the scan */
-        graph_vertex_label = table_open(vertex_label_table_oid, ShareLock);
+        graph_vertex_label = table_open(vertex_label_table_oid, AccessShareLock);
         scan_desc = table_beginscan(graph_vertex_label, snapshot, 0, NULL);
         /* get the tupdesc - we don't need to release this one */
         tupdesc = RelationGetDescr(graph_vertex_label);
@@ -445,14 +1033,22 @@ static void load_vertex_hashtable(GRAPH_global_context *ggctx)
             /* get the vertex id */
             vertex_id = DatumGetInt64(column_get_datum(tupdesc, tuple, 0, "id",
                                                        GRAPHIDOID, true));
-            /* get the vertex properties datum */
-            vertex_properties = column_get_datum(tupdesc, tuple, 1,
-                                                 "properties", AGTYPEOID, true);
+            /* get the vertex properties datum, unless it is fetched lazily */
+            if (ggctx->lazy_properties)
+            {
+                vertex_properties = (Datum) 0;
+            }
+            else
+            {
+                vertex_properties = column_get_datum(tupdesc, tuple, 1,
+                                                     "properties", AGTYPEOID,
+                                                     true);
+            }
 
             /* insert vertex into vertex hashtable */
             inserted = insert_vertex_entry(ggctx, vertex_id,
                                            vertex_label_table_oid,
-                                           vertex_properties);
+                                           vertex_properties, &tuple->t_self);
 
             /* this insert must not fail, it means there is a duplicate */
             if (!inserted)
@@ -463,38 +1059,62 @@ static void load_vertex_hashtable(GRAPH_global_context *ggctx)
 
         /* end the scan and close the relation */
         table_endscan(scan_desc);
-        table_close(graph_vertex_label, ShareLock);
+        table_close(graph_vertex_label, AccessShareLock);
     }
 }
 
 /*
  * Helper function to load all of the GRAPH global hashtables (vertex & edge)
  * for the current global context.
+ *
+ * The label tables are only opened with AccessShareLock. Every one of them is
+ * scanned with the same active snapshot, which is what keeps the vertices and
+ * edges consistent with each other, so concurrent writers aren't blocked.
+ * Changes they commit during the load aren't seen, and are caught later by
+ * the validity checks of the context.
  */
 static void load_GRAPH_global_hashtables(GRAPH_global_context *ggctx)
 {
+    graphid *edge_ids = NULL;
+    int64 num_edge_ids = 0;
+
     /* initialize statistics */
     ggctx->num_loaded_vertices = 0;
     ggctx->num_loaded_edges = 0;
 
-    /* insert all of our vertices */
-    load_vertex_hashtable(ggctx);
+    /*
+     * Insert all of our vertices and edges, using parallel workers to scan the
+     * label tables if we can.
+     */
+    if (!load_GRAPH_global_hashtables_parallel(ggctx, &edge_ids,
+                                               &num_edge_ids))
+    {
+        load_vertex_hashtable(ggctx);
+        load_edge_hashtable(ggctx, &edge_ids, &num_edge_ids);
+    }
+
+    /* build the adjacency, keeping the edges in the order they were loaded */
+    build_GRAPH_global_csr(ggctx, edge_ids, num_edge_ids);
 
-    /* insert all of our edges */
-    load_edge_hashtable(ggctx);
+    if (edge_ids != NULL)
+    {
+        pfree(edge_ids);
+    }
 }
 
 /*
- * Helper routine to load all edges into the GRAPH global edge and vertex
- * hashtables.
+ * Helper routine to load all edges into the GRAPH global edge hashtable. The
+ * loaded edge ids are returned, in load order, for building the CSR arrays.
  */
-static void load_edge_hashtable(GRAPH_global_context *ggctx)
+static void load_edge_hashtable(GRAPH_global_context *ggctx,
+                                graphid **edge_ids, int64 *num_edge_ids)
 {
     Oid graph_oid;
     Oid graph_namespace_oid;
     Snapshot snapshot;
     List *edge_label_names = NIL;
     ListCell *lc;
+    int64 max_edge_ids = CSR_INITIAL_EDGE_IDS;
 
     /* get the specific graph OID and namespace (schema) OID */
     graph_oid = ggctx->graph_oid;
@@ -504,6 +1124,9 @@ static void load_edge_hashtable(GRAPH_global_context *ggctx)
     /* get the names of all of the edge label tables */
     edge_label_names = get_ag_labels_names(snapshot, graph_oid,
                                            LABEL_TYPE_EDGE);
+    /* allocate the edge id array */
+    *edge_ids = palloc(sizeof(graphid) * max_edge_ids);
+    *num_edge_ids = 0;
     /* go through all edge label tables in list */
     foreach (lc, edge_label_names)
     {
@@ -520,7 +1143,7 @@ static void load_edge_hashtable(GRAPH_global_context *ggctx)
         edge_label_table_oid = get_relname_relid(edge_label_name,
                                                  graph_namespace_oid);
         /* open the relation (table) and begin the scan */
-        graph_edge_label = table_open(edge_label_table_oid, ShareLock);
+        graph_edge_label = table_open(edge_label_table_oid, AccessShareLock);
         scan_desc = table_beginscan(graph_edge_label, snapshot, 0, NULL);
         /* get the tupdesc - we don't need to release this one */
         tupdesc = RelationGetDescr(graph_edge_label);
@@ -557,14 +1180,22 @@ static void load_edge_hashtable(GRAPH_global_context *ggctx)
                                                                 2, "end_id",
                                                                 GRAPHIDOID,
                                                                 true));
-            /* get the edge properties datum */
-            edge_properties = column_get_datum(tupdesc, tuple, 3, "properties",
-                                               AGTYPEOID, true);
+            /* get the edge properties datum, unless it is fetched lazily */
+            if (ggctx->lazy_properties)
+            {
+                edge_properties = (Datum) 0;
+            }
+            else
+            {
+                edge_properties = column_get_datum(tupdesc, tuple, 3,
+                                                   "properties", AGTYPEOID,
+                                                   true);
+            }
 
             /* insert edge into edge hashtable */
             inserted = insert_edge(ggctx, edge_id, edge_properties,
                                    edge_vertex_start_id, edge_vertex_end_id,
-                                   edge_label_table_oid);
+                                   edge_label_table_oid, &tuple->t_self);
 
             /* this insert must not fail */
             if (!inserted)
@@ -572,430 +1203,3358 @@ static void load_edge_hashtable(GRAPH_global_context *ggctx)
                  elog(ERROR, "insert_edge: failed to insert");
             }
 
-            /* insert the edge into the start and end vertices edge lists */
-            inserted = insert_vertex_edge(ggctx, edge_vertex_start_id,
-                                          edge_vertex_end_id, edge_id);
-            /* this insert must not fail */
-            if (!inserted)
+            /* save the edge id for the CSR build */
+            if (*num_edge_ids == max_edge_ids)
             {
-                 elog(ERROR, "insert_vertex_edge: failed to insert");
+                max_edge_ids *= 2;
+                *edge_ids = repalloc_huge(*edge_ids,
+                                          sizeof(graphid) * max_edge_ids);
             }
+            (*edge_ids)[(*num_edge_ids)++] = edge_id;
         }
 
         /* end the scan and close the relation */
         table_endscan(scan_desc);
-        table_close(graph_edge_label, ShareLock);
+        table_close(graph_edge_label, AccessShareLock);
     }
 }
 
 /*
- * Helper function to freeze the GRAPH global hashtables from additional
- * inserts. This may, or may not, be useful. Currently, these hashtables are
- * only seen by the creating process and only for reading.
- */
-static void freeze_GRAPH_global_hashtables(GRAPH_global_context *ggctx)
-{
-    hash_freeze(ggctx->vertex_hashtable);
-    hash_freeze(ggctx->edge_hashtable);
-}
-
-/*
- * Helper function to free the entire specified GRAPH global context. After
- * running this you should not use the pointer in ggctx.
+ * Helper function to load the vertices and edges using parallel workers. Each
+ * worker scans a share of every label table's blocks and sends what it finds
+ * to us, through its own message queue. We insert them into the hashtables.
+ * The loaded edge ids are returned, in graphid order, for building the CSR
+ * arrays.
+ *
+ * It returns false, having loaded nothing, if the graph is too small to be
+ * worth it, or if we can't use parallel workers.
  */
-static void free_specific_GRAPH_global_context(GRAPH_global_context *ggctx)
+static bool load_GRAPH_global_hashtables_parallel(GRAPH_global_context *ggctx,
+                                                  graphid **edge_ids,
+                                                  int64 *num_edge_ids)
 {
-    GraphIdNode *curr_vertex = NULL;
+    Snapshot snapshot;
+    Oid graph_namespace_oid;
+    List *vertex_label_names = NIL;
+    List *edge_label_names = NIL;
+    Relation *label_relations = NULL;
+    char *label_kinds = NULL;
+    BlockNumber num_blocks = 0;
+    Size scan_size = 0;
+    Size shared_size;
+    int num_labels;
+    int nworkers;
+    ParallelContext *pcxt = NULL;
+    parallel_load_shared *shared = NULL;
+    char *scans = NULL;
+    char *queues = NULL;
+    shm_mq_handle **mqh = NULL;
+    bool *detached = NULL;
+    int num_active;
+    int64 max_edge_ids = CSR_INITIAL_EDGE_IDS;
+    ListCell *lc;
+    int i;
 
-    /* don't do anything if NULL */
-    if (ggctx == NULL)
+    /* workers can't be started from within parallel mode */
+    if (IsInParallelMode() || age_global_graph_load_workers == 0)
     {
-        return;
+        return false;
     }
 
-    /* free the graph name */
-    pfree(ggctx->graph_name);
-    ggctx->graph_name = NULL;
+    /* get the active snapshot and the graph's namespace */
+    snapshot = GetActiveSnapshot();
+    graph_namespace_oid = get_namespace_oid(ggctx->graph_name, false);
 
-    ggctx->graph_oid = InvalidOid;
-    ggctx->next = NULL;
+    /* get the names of all of the vertex and edge label tables */
+    vertex_label_names = get_ag_labels_names(snapshot, ggctx->graph_oid,
+                                             LABEL_TYPE_VERTEX);
+    edge_label_names = get_ag_labels_names(snapshot, ggctx->graph_oid,
+                                           LABEL_TYPE_EDGE);
+    num_labels = list_length(vertex_label_names) +
+                 list_length(edge_label_names);
+    if (num_labels == 0)
+    {
+        return false;
+    }
 
-    /* free the vertex edge lists, starting with the head */
-    curr_vertex = peek_stack_head(ggctx->vertices);
-    while (curr_vertex != NULL)
+    /* open all of the label tables, vertices first, and size them */
+    label_relations = palloc(sizeof(Relation) * num_labels);
+    label_kinds = palloc(sizeof(char) * num_labels);
+    i = 0;
+    foreach (lc, vertex_label_names)
+    {
+        label_kinds[i++] = LABEL_KIND_VERTEX;
+    }
+    foreach (lc, edge_label_names)
+    {
+        label_kinds[i++] = LABEL_KIND_EDGE;
+    }
+    for (i = 0; i < num_labels; i++)
     {
-        GraphIdNode *next_vertex = NULL;
-        vertex_entry *value = NULL;
-        bool found = false;
-        graphid vertex_id;
+        char *label_name;
+        Oid label_table_oid;
+        Relation label_relation;
 
-        /* get the next vertex in the list, if any */
-        next_vertex = next_GraphIdNode(curr_vertex);
+        if (i < list_length(vertex_label_names))
+        {
+            label_name = list_nth(vertex_label_names, i);
+        }
+        else
+        {
+            label_name = list_nth(edge_label_names,
+                                  i - list_length(vertex_label_names));
+        }
 
-        /* get the current vertex id */
-        vertex_id = get_graphid(curr_vertex);
+        label_table_oid = get_relname_relid(label_name, graph_namespace_oid);
+        label_relation = table_open(label_table_oid, AccessShareLock);
 
-        /* retrieve the vertex entry */
-        value = (vertex_entry *)hash_search(ggctx->vertex_hashtable,
-                                            (void *)&vertex_id, HASH_FIND,
-                                            &found);
-        /* this is bad if it isn't found */
-        Assert(found);
+        if (RelationGetDescr(label_relation)->natts !=
+            (label_kinds[i] == LABEL_KIND_VERTEX ? 2 : 4))
+        {
+            ereport(ERROR,
+                    (errcode(ERRCODE_UNDEFINED_TABLE),
+                     errmsg("Invalid number of attributes for %s.%s",
+                     ggctx->graph_name, label_name)));
+        }
 
-        /* free the edge list associated with this vertex */
-        free_ListGraphId(value->edges_in);
-        free_ListGraphId(value->edges_out);
-        free_ListGraphId(value->edges_self);
+        num_blocks += RelationGetNumberOfBlocks(label_relation);
+        scan_size = Max(scan_size,
+                        MAXALIGN(table_parallelscan_estimate(label_relation,
+                                                             snapshot)));
+        label_relations[i] = label_relation;
+    }
 
-        value->edges_in = NULL;
-        value->edges_out = NULL;
-        value->edges_self = NULL;
+    /* decide how many workers the graph is worth */
+    nworkers = compute_load_workers(num_blocks);
+    if (nworkers <= 0)
+    {
+        for (i = 0; i < num_labels; i++)
+        {
+            table_close(label_relations[i], AccessShareLock);
+        }
+        pfree(label_relations);
+        pfree(label_kinds);
+        return false;
+    }
 
-        /* move to the next vertex */
-        curr_vertex = next_vertex;
+    /* set up the shared state, the parallel scans, and the message queues */
+    EnterParallelMode();
+    pcxt = CreateParallelContext("age", "age_global_graph_load_worker",
+                                 nworkers);
+
+    shared_size = add_size(offsetof(parallel_load_shared, labels),
+                           mul_size(sizeof(parallel_load_label), num_labels));
+    shm_toc_estimate_chunk(&pcxt->estimator, shared_size);
+    shm_toc_estimate_chunk(&pcxt->estimator, mul_size(scan_size, num_labels));
+    shm_toc_estimate_chunk(&pcxt->estimator,
+                           mul_size(PARALLEL_LOAD_QUEUE_SIZE, nworkers));
+    shm_toc_estimate_keys(&pcxt->estimator, 3);
+    InitializeParallelDSM(pcxt);
+
+    shared = shm_toc_allocate(pcxt->toc, shared_size);
+    shared->scan_size = scan_size;
+    shared->lazy_properties = ggctx->lazy_properties;
+    shared->num_labels = num_labels;
+    for (i = 0; i < num_labels; i++)
+    {
+        shared->labels[i].label_table_oid =
+            RelationGetRelid(label_relations[i]);
+        shared->labels[i].label_kind = label_kinds[i];
     }
+    shm_toc_insert(pcxt->toc, PARALLEL_LOAD_KEY_SHARED, shared);
 
-    /* free the vertices list */
-    free_ListGraphId(ggctx->vertices);
-    ggctx->vertices = NULL;
+    scans = shm_toc_allocate(pcxt->toc, mul_size(scan_size, num_labels));
+    for (i = 0; i < num_labels; i++)
+    {
+        table_parallelscan_initialize(label_relations[i],
+            (ParallelTableScanDesc)(scans + (scan_size * i)), snapshot);
+    }
+    shm_toc_insert(pcxt->toc, PARALLEL_LOAD_KEY_SCANS, scans);
 
-    /* free the hashtables */
-    hash_destroy(ggctx->vertex_hashtable);
-    hash_destroy(ggctx->edge_hashtable);
+    queues = shm_toc_allocate(pcxt->toc,
+                              mul_size(PARALLEL_LOAD_QUEUE_SIZE, nworkers));
+    mqh = palloc0(sizeof(shm_mq_handle *) * nworkers);
+    for (i = 0; i < nworkers; i++)
+    {
+        shm_mq *mq;
 
-    ggctx->vertex_hashtable = NULL;
-    ggctx->edge_hashtable = NULL;
+        mq = shm_mq_create(queues + (PARALLEL_LOAD_QUEUE_SIZE * i),
+                           PARALLEL_LOAD_QUEUE_SIZE);
+        shm_mq_set_receiver(mq, MyProc);
+        mqh[i] = shm_mq_attach(mq, pcxt->seg, NULL);
+    }
+    shm_toc_insert(pcxt->toc, PARALLEL_LOAD_KEY_QUEUES, queues);
 
-    /* free the context */
-    pfree(ggctx);
-    ggctx = NULL;
-}
+    LaunchParallelWorkers(pcxt);
 
-/*
- * Helper function to manage the GRAPH global contexts. It will create the
- * context for the graph specified, provided it isn't already built and valid.
- * During processing it will free (delete) all invalid GRAPH contexts. It
- * returns the GRAPH global context for the specified graph.
- */
-GRAPH_global_context *manage_GRAPH_global_contexts(char *graph_name,
-                                                   Oid graph_oid)
-{
-    GRAPH_global_context *new_ggctx = NULL;
-    GRAPH_global_context *curr_ggctx = NULL;
-    GRAPH_global_context *prev_ggctx = NULL;
-    MemoryContext oldctx = NULL;
+    /* if no workers could be started, fall back to loading it ourselves */
+    if (pcxt->nworkers_launched == 0)
+    {
+        DestroyParallelContext(pcxt);
+        ExitParallelMode();
+        for (i = 0; i < num_labels; i++)
+        {
+            table_close(label_relations[i], AccessShareLock);
+        }
+        pfree(label_relations);
+        pfree(label_kinds);
+        pfree(mqh);
+        return false;
+    }
 
-    /* we need a higher context, or one that isn't destroyed by SRF exit */
-    oldctx = MemoryContextSwitchTo(TopMemoryContext);
+    /* notice workers that die before attaching to their queues */
+    for (i = 0; i < pcxt->nworkers_launched; i++)
+    {
+        shm_mq_set_handle(mqh[i], pcxt->worker[i].bgwhandle);
+    }
 
-    /*
-     * We need to see if any GRAPH global contexts already exist and if any do
-     * for this particular graph. There are 5 possibilities -
-     *
-     *     1) There are no global contexts.
-     *     2) One does exist for this graph but, is invalid.
-     *     3) One does exist for this graph and is valid.
-     *     4) One or more other contexts do exist and all are valid.
-     *     5) One or more other contexts do exist but, one or more are invalid.
-     */
+    /* properties are copied out of the messages into their own context */
+    ggctx->load_context = AllocSetContextCreate(ggctx->memory_context,
+                                                "AGE global graph properties",
+                                                ALLOCSET_DEFAULT_SIZES);
 
-    /* free the invalidated GRAPH global contexts first */
-    prev_ggctx = NULL;
-    curr_ggctx = global_graph_contexts;
-    while (curr_ggctx != NULL)
+    /* allocate the edge id array */
+    *edge_ids = palloc(sizeof(graphid) * max_edge_ids);
+    *num_edge_ids = 0;
+
+    /* merge what the workers send us until they are all done */
+    detached = palloc0(sizeof(bool) * pcxt->nworkers_launched);
+    num_active = pcxt->nworkers_launched;
+    while (num_active > 0)
     {
-        GRAPH_global_context *next_ggctx = curr_ggctx->next;
+        bool received = false;
 
-        /* if the transaction ids have changed, we have an invalid graph */
-        if (is_ggctx_invalid(curr_ggctx))
+        for (i = 0; i < pcxt->nworkers_launched; i++)
         {
-            /*
-             * If prev_ggctx is NULL then we are freeing the top of the
-             * contexts. So, we need to point the global variable to the
-             * new (next) top context, if there is one.
-             */
-            if (prev_ggctx == NULL)
+            shm_mq_result result;
+            Size nbytes;
+            void *data;
+
+            if (detached[i])
             {
-                global_graph_contexts = next_ggctx;
+                continue;
             }
-            else
+
+            result = shm_mq_receive(mqh[i], &nbytes, &data, true);
+            if (result == SHM_MQ_WOULD_BLOCK)
             {
-                prev_ggctx->next = curr_ggctx->next;
+                continue;
+            }
+            if (result == SHM_MQ_DETACHED)
+            {
+                detached[i] = true;
+                num_active--;
+                continue;
             }
 
-            /* free the current graph context */
-            free_specific_GRAPH_global_context(curr_ggctx);
+            insert_parallel_loaded_entity(ggctx, data, nbytes, edge_ids,
+                                          num_edge_ids, &max_edge_ids);
+            received = true;
         }
-        else
+
+        /* wait for the workers to send us more */
+        if (!received && num_active > 0)
         {
-            prev_ggctx = curr_ggctx;
+            (void) WaitLatch(MyLatch, WL_LATCH_SET | WL_EXIT_ON_PM_DEATH, -1L,
+                             PG_WAIT_EXTENSION);
+            ResetLatch(MyLatch);
+            CHECK_FOR_INTERRUPTS();
         }
+    }
 
-        /* advance to the next context */
-        curr_ggctx = next_ggctx;
+    /* this will rethrow any error a worker ran into */
+    WaitForParallelWorkersToFinish(pcxt);
+    DestroyParallelContext(pcxt);
+    ExitParallelMode();
+
+    order_parallel_loaded_entities(ggctx, *edge_ids, *num_edge_ids);
+
+    for (i = 0; i < num_labels; i++)
+    {
+        table_close(label_relations[i], AccessShareLock);
     }
+    pfree(label_relations);
+    pfree(label_kinds);
+    pfree(mqh);
+    pfree(detached);
 
-    /* find our graph's context. if it exists, we are done */
-    curr_ggctx = global_graph_contexts;
-    while (curr_ggctx != NULL)
+    return true;
+}
+
+/*
+ * Helper function to compute the number of workers for a parallel load of
+ * label tables with the passed total number of blocks. Unless it has been set,
+ * this is done the same way the planner does it for a parallel heap scan.
+ */
+static int compute_load_workers(BlockNumber num_blocks)
+{
+    BlockNumber threshold;
+    int nworkers;
+
+    if (age_global_graph_load_workers >= 0)
     {
-        if (curr_ggctx->graph_oid == graph_oid)
+        return Min(age_global_graph_load_workers, max_worker_processes);
+    }
+
+    threshold = Max(min_parallel_table_scan_size, 1);
+    if (num_blocks < threshold)
+    {
+        return 0;
+    }
+
+    /* add a worker each time the graph triples in size */
+    nworkers = 1;
+    while (num_blocks >= threshold * 3)
+    {
+        nworkers++;
+        threshold *= 3;
+        if (threshold > INT_MAX / 3)
         {
-            /* switch our context back */
-            MemoryContextSwitchTo(oldctx);
-            /* we are done */
-            return curr_ggctx;
+            break;
         }
-        curr_ggctx = curr_ggctx->next;
     }
 
-    /* otherwise, we need to create one and possibly attach it */
-    new_ggctx = palloc0(sizeof(GRAPH_global_context));
+    return Min(nworkers, max_parallel_workers_per_gather);
+}
 
-    if (global_graph_contexts != NULL)
+/*
+ * Helper function to insert a vertex or edge, received from a parallel load
+ * worker, into the hashtables. The message is only valid until the next one
+ * is received, so the properties are copied into the load context.
+ */
+static void insert_parallel_loaded_entity(GRAPH_global_context *ggctx,
+                                          char *data, Size nbytes,
+                                          graphid **edge_ids,
+                                          int64 *num_edge_ids,
+                                          int64 *max_edge_ids)
+{
+    parallel_load_entity entity;
+    Size properties_size;
+    char *properties = NULL;
+    bool inserted = false;
+
+    if (nbytes < sizeof(parallel_load_entity))
     {
-        new_ggctx->next = global_graph_contexts;
+        elog(ERROR, "insert_parallel_loaded_entity: invalid message size");
     }
-    else
+
+    /* the message may not be aligned, so copy everything out of it */
+    memcpy(&entity, data, sizeof(parallel_load_entity));
+    properties_size = nbytes - sizeof(parallel_load_entity);
+    if (properties_size > 0)
     {
-        new_ggctx->next = NULL;
+        properties = MemoryContextAlloc(ggctx->load_context, properties_size);
+        memcpy(properties, data + sizeof(parallel_load_entity),
+               properties_size);
     }
 
-    /* set the global context variable */
-    global_graph_contexts = new_ggctx;
+    if (entity.label_kind == LABEL_KIND_VERTEX)
+    {
+        inserted = insert_vertex_entry(ggctx, entity.id,
+                                       entity.label_table_oid,
+                                       PointerGetDatum(properties),
+                                       &entity.tid);
 
-    /* set the graph name and oid */
-    new_ggctx->graph_name = pstrdup(graph_name);
-    new_ggctx->graph_oid = graph_oid;
+        /* this insert must not fail, it means there is a duplicate */
+        if (!inserted)
+        {
+             elog(ERROR, "insert_vertex_entry: failed due to duplicate");
+        }
 
-    /* set the transaction ids */
-    new_ggctx->xmin = GetActiveSnapshot()->xmin;
-    new_ggctx->xmax = GetActiveSnapshot()->xmax;
-    new_ggctx->curcid = GetActiveSnapshot()->curcid;
+        return;
+    }
 
-    /* initialize our vertices list */
-    new_ggctx->vertices = NULL;
+    inserted = insert_edge(ggctx, entity.id, PointerGetDatum(properties),
+                           entity.start_vertex_id, entity.end_vertex_id,
+                           entity.label_table_oid, &entity.tid);
 
-    /* build the hashtables for this graph */
-    create_GRAPH_global_hashtables(new_ggctx);
-    load_GRAPH_global_hashtables(new_ggctx);
-    freeze_GRAPH_global_hashtables(new_ggctx);
+    /* this insert must not fail */
+    if (!inserted)
+    {
+         elog(ERROR, "insert_edge: failed to insert");
+    }
 
-    /* switch back to the previous memory context */
-    MemoryContextSwitchTo(oldctx);
+    /* save the edge id for the CSR build */
+    if (*num_edge_ids == *max_edge_ids)
+    {
+        *max_edge_ids *= 2;
+        *edge_ids = repalloc_huge(*edge_ids, sizeof(graphid) * *max_edge_ids);
+    }
+    (*edge_ids)[(*num_edge_ids)++] = entity.id;
+}
 
-    return new_ggctx;
+/*
+ * Helper function to put the vertices and edges of a parallel load into
+ * graphid order. Which worker scans which blocks, and the order their messages
+ * are received in, varies from load to load. This keeps the dense vertex
+ * indexes and the CSR entry order the same every time.
+ */
+static void order_parallel_loaded_entities(GRAPH_global_context *ggctx,
+                                           graphid *edge_ids,
+                                           int64 num_edge_ids)
+{
+    uint32 i;
+
+    qsort(ggctx->vertex_index_entries, ggctx->num_vertex_indexes,
+          sizeof(vertex_entry *), vertex_entry_id_cmp);
+
+    for (i = 0; i < ggctx->num_vertex_indexes; i++)
+    {
+        ggctx->vertex_index_entries[i]->vertex_index = i;
+    }
+
+    qsort(edge_ids, num_edge_ids, sizeof(graphid), graphid_cmp);
+}
+
+/* qsort comparator for graphids */
+static int graphid_cmp(const void *a, const void *b)
+{
+    graphid ga = *(const graphid *)a;
+    graphid gb = *(const graphid *)b;
+
+    if (ga < gb)
+    {
+        return -1;
+    }
+    if (ga > gb)
+    {
+        return 1;
+    }
+    return 0;
+}
+
+/* qsort comparator for vertex entry pointers, by vertex id */
+static int vertex_entry_id_cmp(const void *a, const void *b)
+{
+    return graphid_cmp(&(*(vertex_entry *const *)a)->vertex_id,
+                       &(*(vertex_entry *const *)b)->vertex_id);
 }
 
 /*
- * Helper function to delete all of the global graph contexts used by the
- * process. When done the global global_graph_contexts will be NULL.
+ * Entry point of a parallel load worker. It scans its share of the blocks of
+ * each label table, with the loading backend's snapshot, and sends each vertex
+ * and edge found to the loading backend.
  */
-static bool delete_GRAPH_global_contexts(void)
+void age_global_graph_load_worker(dsm_segment *seg, shm_toc *toc)
 {
-    GRAPH_global_context *curr_ggctx = NULL;
-    bool retval = false;
+    parallel_load_shared *shared;
+    char *scans;
+    char *queues;
+    shm_mq *mq;
+    shm_mq_handle *mqh;
+    StringInfoData message;
+    int i;
+
+    shared = shm_toc_lookup(toc, PARALLEL_LOAD_KEY_SHARED, false);
+    scans = shm_toc_lookup(toc, PARALLEL_LOAD_KEY_SCANS, false);
+    queues = shm_toc_lookup(toc, PARALLEL_LOAD_KEY_QUEUES, false);
+
+    /* attach to our message queue */
+    mq = (shm_mq *)(queues + (PARALLEL_LOAD_QUEUE_SIZE * ParallelWorkerNumber));
+    shm_mq_set_sender(mq, MyProc);
+    mqh = shm_mq_attach(mq, seg, NULL);
+
+    initStringInfo(&message);
+
+    for (i = 0; i < shared->num_labels; i++)
+    {
+        parallel_load_label *label = &shared->labels[i];
+        Relation label_relation;
+        TableScanDesc scan_desc;
+        TupleDesc tupdesc;
+        HeapTuple tuple;
+
+        label_relation = table_open(label->label_table_oid, AccessShareLock);
+        scan_desc = table_beginscan_parallel(label_relation,
+            (ParallelTableScanDesc)(scans + (shared->scan_size * i)));
+        tupdesc = RelationGetDescr(label_relation);
+
+        while((tuple = heap_getnext(scan_desc, ForwardScanDirection)) != NULL)
+        {
+            parallel_load_entity entity;
+            Datum properties;
+            struct varlena *detoasted;
+            shm_mq_result result;
+
+            MemSet(&entity, 0, sizeof(parallel_load_entity));
+            entity.label_kind = label->label_kind;
+            entity.label_table_oid = label->label_table_oid;
+            entity.tid = tuple->t_self;
+            entity.id = DatumGetInt64(column_get_datum(tupdesc, tuple, 0, "id",
+                                                       GRAPHIDOID, true));
+
+            if (label->label_kind == LABEL_KIND_VERTEX)
+            {
+                properties = column_get_datum(tupdesc, tuple, 1, "properties",
+                                              AGTYPEOID, true);
+            }
+            else
+            {
+                entity.start_vertex_id =
+                    DatumGetInt64(column_get_datum(tupdesc, tuple, 1,
+                                                   "start_id", GRAPHIDOID,
+                                                   true));
+                entity.end_vertex_id =
+                    DatumGetInt64(column_get_datum(tupdesc, tuple, 2, "end_id",
+                                                   GRAPHIDOID, true));
+                properties = column_get_datum(tupdesc, tuple, 3, "properties",
+                                              AGTYPEOID, true);
+            }
+
+            resetStringInfo(&message);
+            appendBinaryStringInfo(&message, (char *)&entity,
+                                   sizeof(parallel_load_entity));
+
+            /* the loading backend can't read our buffers or toast for us */
+            if (!shared->lazy_properties)
+            {
+                detoasted = pg_detoast_datum((struct varlena *)
+                                             DatumGetPointer(properties));
+                appendBinaryStringInfo(&message, (char *)detoasted,
+                                       VARSIZE(detoasted));
+
+                if ((Pointer)detoasted != DatumGetPointer(properties))
+                {
+                    pfree(detoasted);
+                }
+            }
+
+            result = shm_mq_send(mqh, message.len, message.data, false);
+
+            /* the loading backend has gone away, there's no point going on */
+            if (result == SHM_MQ_DETACHED)
+            {
+                table_endscan(scan_desc);
+                table_close(label_relation, AccessShareLock);
+                shm_mq_detach(mqh);
+                return;
+            }
+        }
+
+        table_endscan(scan_desc);
+        table_close(label_relation, AccessShareLock);
+    }
+
+    shm_mq_detach(mqh);
+}
+
+/*
+ * Helper function to build the CSR adjacency arrays from the loaded edges. For
+ * each edge direction, the offsets array holds, for each vertex's dense index,
+ * the start of its entries in the entries array. The entries of each vertex
+ * are in the order of the passed edge ids.
+ */
+static void build_GRAPH_global_csr(GRAPH_global_context *ggctx,
+                                   graphid *edge_ids, int64 num_edge_ids)
+{
+    int64 num_vertices = 0;
+    int64 i;
+    int d;
+
+    /* every loaded vertex has a dense index, in load order */
+    num_vertices = ggctx->num_vertex_indexes;
+    ggctx->csr_num_vertices = num_vertices;
+
+    for (d = 0; d < NUM_VERTEX_EDGE_DIRECTIONS; d++)
+    {
+        ggctx->csr_offsets[d] = MemoryContextAllocHuge(ggctx->memory_context,
+            sizeof(int64) * (num_vertices + 1));
+        MemSet(ggctx->csr_offsets[d], 0, sizeof(int64) * (num_vertices + 1));
+        ggctx->csr_num_entries[d] = 0;
+    }
+
+    /* count the entries of each vertex, shifted up by one */
+    for (i = 0; i < num_edge_ids; i++)
+    {
+        edge_entry *ee = get_edge_entry(ggctx, edge_ids[i]);
+        vertex_entry *start_ve = get_vertex_entry(ggctx, ee->start_vertex_id);
+        vertex_entry *end_ve = get_vertex_entry(ggctx, ee->end_vertex_id);
+
+        /* the vertices were preloaded so they must be there */
+        if (start_ve == NULL || end_ve == NULL)
+        {
+            elog(ERROR, "build_GRAPH_global_csr: edge vertex not found");
+        }
+
+        if (start_ve == end_ve)
+        {
+            ggctx->csr_offsets[VERTEX_EDGES_SELF][start_ve->vertex_index + 1]++;
+        }
+        else
+        {
+            ggctx->csr_offsets[VERTEX_EDGES_OUT][start_ve->vertex_index + 1]++;
+            ggctx->csr_offsets[VERTEX_EDGES_IN][end_ve->vertex_index + 1]++;
+        }
+    }
+
+    /* turn the counts into start offsets and allocate the entries */
+    for (d = 0; d < NUM_VERTEX_EDGE_DIRECTIONS; d++)
+    {
+        int64 *offsets = ggctx->csr_offsets[d];
+
+        for (i = 1; i <= num_vertices; i++)
+        {
+            offsets[i] += offsets[i - 1];
+        }
+
+        ggctx->csr_num_entries[d] = offsets[num_vertices];
+        ggctx->csr_entries[d] = MemoryContextAllocHuge(ggctx->memory_context,
+            sizeof(adjacency_entry) * Max(offsets[num_vertices], 1));
+    }
+
+    /*
+     * Fill in the entries. Each vertex's offset is advanced as its entries are
+     * added, which leaves it at the start of the next vertex's entries.
+     */
+    for (i = 0; i < num_edge_ids; i++)
+    {
+        edge_entry *ee = get_edge_entry(ggctx, edge_ids[i]);
+        vertex_entry *start_ve = get_vertex_entry(ggctx, ee->start_vertex_id);
+        vertex_entry *end_ve = get_vertex_entry(ggctx, ee->end_vertex_id);
+        adjacency_entry *entry = NULL;
+
+        if (start_ve == end_ve)
+        {
+            entry = &ggctx->csr_entries[VERTEX_EDGES_SELF]
+                [ggctx->csr_offsets[VERTEX_EDGES_SELF][start_ve->vertex_index]++];
+            entry->edge_id = ee->edge_id;
+            entry->vertex_index = start_ve->vertex_index;
+        }
+        else
+        {
+            entry = &ggctx->csr_entries[VERTEX_EDGES_OUT]
+                [ggctx->csr_offsets[VERTEX_EDGES_OUT][start_ve->vertex_index]++];
+            entry->edge_id = ee->edge_id;
+            entry->vertex_index = end_ve->vertex_index;
+
+            entry = &ggctx->csr_entries[VERTEX_EDGES_IN]
+                [ggctx->csr_offsets[VERTEX_EDGES_IN][end_ve->vertex_index]++];
+            entry->edge_id = ee->edge_id;
+            entry->vertex_index = start_ve->vertex_index;
+        }
+    }
+
+    /* shift the offsets back down to the start of each vertex's entries */
+    for (d = 0; d < NUM_VERTEX_EDGE_DIRECTIONS; d++)
+    {
+        int64 *offsets = ggctx->csr_offsets[d];
+
+        for (i = num_vertices; i > 0; i--)
+        {
+            offsets[i] = offsets[i - 1];
+        }
+        offsets[0] = 0;
+    }
+}
+
+/*
+ * Helper function to remove an edge from a vertex's CSR entries. The entry is
+ * marked as deleted, as the arrays can't be compacted in place. It returns
+ * false if the edge isn't there.
+ */
+static bool delete_csr_edge(GRAPH_global_context *ggctx, vertex_entry *ve,
+                            vertex_edge_direction direction, graphid edge_id)
+{
+    int64 i;
+
+    if (ve->vertex_index >= ggctx->csr_num_vertices)
+    {
+        return false;
+    }
+
+    for (i = ggctx->csr_offsets[direction][ve->vertex_index];
+         i < ggctx->csr_offsets[direction][ve->vertex_index + 1]; i++)
+    {
+        if (ggctx->csr_entries[direction][i].edge_id == edge_id)
+        {
+            ggctx->csr_entries[direction][i].edge_id = CSR_DELETED_EDGE;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Helper function to free the entire specified GRAPH global context. After
+ * running this you should not use the pointer in ggctx.
+ */
+static void free_specific_GRAPH_global_context(GRAPH_global_context *ggctx)
+{
+    uint32 i;
+
+    /* don't do anything if NULL */
+    if (ggctx == NULL)
+    {
+        return;
+    }
+
+    /* free the graph name */
+    pfree(ggctx->graph_name);
+    ggctx->graph_name = NULL;
+
+    ggctx->graph_oid = InvalidOid;
+    ggctx->next = NULL;
+
+    /*
+     * Free the vertex edge lists, by dense index. The entries of an image, that
+     * isn't hashed, don't have any.
+     */
+    for (i = 0; ggctx->image == NULL && i < ggctx->num_vertex_indexes; i++)
+    {
+        vertex_entry *value = ggctx->vertex_index_entries[i];
+
+        /* skip deleted vertices */
+        if (value == NULL)
+        {
+            continue;
+        }
+
+        /* free the edge list associated with this vertex */
+        free_ListGraphId(value->edges_in);
+        free_ListGraphId(value->edges_out);
+        free_ListGraphId(value->edges_self);
+
+        value->edges_in = NULL;
+        value->edges_out = NULL;
+        value->edges_self = NULL;
+    }
+
+    /* free the CSR arrays, unless they are in an image */
+    if (!ggctx->csr_in_image)
+    {
+        int d;
+
+        for (d = 0; d < NUM_VERTEX_EDGE_DIRECTIONS; d++)
+        {
+            if (ggctx->csr_offsets[d] != NULL)
+            {
+                pfree(ggctx->csr_offsets[d]);
+            }
+            if (ggctx->csr_entries[d] != NULL)
+            {
+                pfree(ggctx->csr_entries[d]);
+            }
+        }
+    }
+    MemSet(ggctx->csr_offsets, 0, sizeof(ggctx->csr_offsets));
+    MemSet(ggctx->csr_entries, 0, sizeof(ggctx->csr_entries));
+
+    /* free the dense vertex index */
+    if (ggctx->vertex_index_entries != NULL)
+    {
+        pfree(ggctx->vertex_index_entries);
+        ggctx->vertex_index_entries = NULL;
+    }
+
+    /* free the hashtables, there aren't any while an image is used */
+    if (ggctx->vertex_hashtable != NULL)
+    {
+        hash_destroy(ggctx->vertex_hashtable);
+    }
+    if (ggctx->edge_hashtable != NULL)
+    {
+        hash_destroy(ggctx->edge_hashtable);
+    }
+
+    ggctx->vertex_hashtable = NULL;
+    ggctx->edge_hashtable = NULL;
+
+    /* detach from the shared image, the entries may point into it */
+    if (ggctx->shared_image != NULL)
+    {
+        dsm_detach(ggctx->shared_image);
+        ggctx->shared_image = NULL;
+    }
+
+    /* likewise, unmap the snapshot file */
+    if (ggctx->mapped_file != NULL)
+    {
+        munmap(ggctx->mapped_file, ggctx->mapped_file_size);
+        ggctx->mapped_file = NULL;
+    }
+
+    /* free any pending deltas and the properties of applied ones */
+    free_GRAPH_global_deltas(ggctx);
+    list_free_deep(ggctx->delta_properties);
+    ggctx->delta_properties = NIL;
+
+    if (ggctx->xip != NULL)
+    {
+        pfree(ggctx->xip);
+        ggctx->xip = NULL;
+    }
+    if (ggctx->own_xids != NULL)
+    {
+        pfree(ggctx->own_xids);
+        ggctx->own_xids = NULL;
+    }
+
+    /* free the properties copied by a parallel load */
+    if (ggctx->load_context != NULL)
+    {
+        MemoryContextDelete(ggctx->load_context);
+        ggctx->load_context = NULL;
+    }
+
+    /* free anything else that was allocated for the graph */
+    if (ggctx->memory_context != NULL)
+    {
+        MemoryContextDelete(ggctx->memory_context);
+        ggctx->memory_context = NULL;
+    }
+
+    /* free the context */
+    pfree(ggctx);
+    ggctx = NULL;
+}
+
+/*
+ * Helper function to manage the GRAPH global contexts. It will create the
+ * context for the graph specified, provided it isn't already built and valid.
+ * During processing it will free (delete) all invalid GRAPH contexts. It
+ * returns the GRAPH global context for the specified graph.
+ */
+GRAPH_global_context *manage_GRAPH_global_contexts(char *graph_name,
+                                                   Oid graph_oid)
+{
+    GRAPH_global_context *new_ggctx = NULL;
+    GRAPH_global_context *curr_ggctx = NULL;
+    GRAPH_global_context *prev_ggctx = NULL;
+    MemoryContext oldctx = NULL;
+    bool attached = false;
+    instr_time start_time;
+    instr_time load_time;
+
+    /* we need a higher context, or one that isn't destroyed by SRF exit */
+    oldctx = MemoryContextSwitchTo(TopMemoryContext);
+
+    /*
+     * We need to see if any GRAPH global contexts already exist and if any do
+     * for this particular graph. There are 5 possibilities -
+     *
+     *     1) There are no global contexts.
+     *     2) One does exist for this graph but, is invalid.
+     *     3) One does exist for this graph and is valid.
+     *     4) One or more other contexts do exist and all are valid.
+     *     5) One or more other contexts do exist but, one or more are invalid.
+     */
+
+    /* free the invalidated GRAPH global contexts first */
+    prev_ggctx = NULL;
+    curr_ggctx = global_graph_contexts;
+    while (curr_ggctx != NULL)
+    {
+        GRAPH_global_context *next_ggctx = curr_ggctx->next;
+
+        /*
+         * If the transaction ids have changed, we have an invalid graph. That
+         * is, unless the only changes were our own and they were logged.
+         */
+        bool invalid = false;
+
+        if (is_ggctx_invalid(curr_ggctx))
+        {
+            /* applied changes belong to the graph */
+            MemoryContextSwitchTo(curr_ggctx->memory_context);
+            invalid = !apply_GRAPH_global_deltas(curr_ggctx);
+            MemoryContextSwitchTo(TopMemoryContext);
+        }
+
+        if (invalid)
+        {
+            /*
+             * If prev_ggctx is NULL then we are freeing the top of the
+             * contexts. So, we need to point the global variable to the
+             * new (next) top context, if there is one.
+             */
+            if (prev_ggctx == NULL)
+            {
+                global_graph_contexts = next_ggctx;
+            }
+            else
+            {
+                prev_ggctx->next = curr_ggctx->next;
+            }
+
+            /* free the current graph context */
+            free_specific_GRAPH_global_context(curr_ggctx);
+        }
+        else
+        {
+            prev_ggctx = curr_ggctx;
+        }
+
+        /* advance to the next context */
+        curr_ggctx = next_ggctx;
+    }
+
+    /* find our graph's context. if it exists, we are done */
+    curr_ggctx = global_graph_contexts;
+    while (curr_ggctx != NULL)
+    {
+        if (curr_ggctx->graph_oid == graph_oid)
+        {
+            curr_ggctx->num_hits++;
+            touch_GRAPH_global_context(curr_ggctx);
+
+            /* switch our context back */
+            MemoryContextSwitchTo(oldctx);
+            /* we are done */
+            return curr_ggctx;
+        }
+        curr_ggctx = curr_ggctx->next;
+    }
+
+    /* otherwise, we need to create one and possibly attach it */
+    new_ggctx = palloc0(sizeof(GRAPH_global_context));
+
+    if (global_graph_contexts != NULL)
+    {
+        new_ggctx->next = global_graph_contexts;
+    }
+    else
+    {
+        new_ggctx->next = NULL;
+    }
+
+    /* set the global context variable */
+    global_graph_contexts = new_ggctx;
+
+    /* set the graph name and oid */
+    new_ggctx->graph_name = pstrdup(graph_name);
+    new_ggctx->graph_oid = graph_oid;
+
+    /*
+     * Everything private to the graph is allocated under its own memory
+     * context, so that the memory it uses can be accounted for.
+     */
+    new_ggctx->memory_context = AllocSetContextCreate(TopMemoryContext,
+                                                      "AGE global graph",
+                                                      ALLOCSET_DEFAULT_SIZES);
+
+    /* set the transaction ids */
+    set_GRAPH_global_snapshot(new_ggctx, GetActiveSnapshot());
+
+    /* the graph is loaded into its own memory context */
+    MemoryContextSwitchTo(new_ggctx->memory_context);
+    new_ggctx->loaded_at = GetCurrentTimestamp();
+    INSTR_TIME_SET_CURRENT(start_time);
+
+    /*
+     * Use a shared image if there is a usable one, or else a saved snapshot
+     * file. Otherwise, build it.
+     */
+    attached = (attach_shared_GRAPH_global_image(new_ggctx) ||
+                attach_GRAPH_global_snapshot_file(new_ggctx));
+    if (!attached)
+    {
+        /* decide whether the properties are loaded or fetched when needed */
+        new_ggctx->lazy_properties = age_global_graph_lazy_properties;
+        if (new_ggctx->lazy_properties)
+        {
+            lock_GRAPH_global_label_tables(new_ggctx);
+        }
+
+        create_GRAPH_global_hashtables(new_ggctx);
+        load_GRAPH_global_hashtables(new_ggctx);
+    }
+
+    /* whatever it was loaded from, it is the graph as of the active snapshot */
+    count_GRAPH_global_context_changes(new_ggctx, GetActiveSnapshot());
+
+    /* share what was built, keyed on the change counts just taken */
+    if (!attached)
+    {
+        publish_shared_GRAPH_global_image(new_ggctx);
+    }
+
+    INSTR_TIME_SET_CURRENT(load_time);
+    INSTR_TIME_SUBTRACT(load_time, start_time);
+    new_ggctx->load_time = INSTR_TIME_GET_MILLISEC(load_time);
+    touch_GRAPH_global_context(new_ggctx);
+
+    /* make room for the new graph, if the others are over the budget */
+    MemoryContextSwitchTo(TopMemoryContext);
+    evict_GRAPH_global_contexts(new_ggctx);
+
+    /* switch back to the previous memory context */
+    MemoryContextSwitchTo(oldctx);
+
+    return new_ggctx;
+}
+
+/* helper function to mark a GRAPH global context as the most recently used */
+static void touch_GRAPH_global_context(GRAPH_global_context *ggctx)
+{
+    ggctx->last_used = ++global_graph_lru_clock;
+    ggctx->last_used_lxid = MyProc->lxid;
+}
+
+/*
+ * Helper function to keep the memory used by the GRAPH global contexts within
+ * age.global_graph_memory_limit. The least recently used contexts are freed
+ * until the total fits. The context passed, and any used by the current
+ * transaction, are kept as they may still be referenced. So, the limit can be
+ * exceeded by a single transaction that uses more graphs than fit.
+ */
+static void evict_GRAPH_global_contexts(GRAPH_global_context *keep_ggctx)
+{
+    Size limit;
+
+    if (age_global_graph_memory_limit < 0)
+    {
+        return;
+    }
+
+    limit = (Size) age_global_graph_memory_limit * 1024;
+
+    for (;;)
+    {
+        GRAPH_global_context *curr_ggctx = NULL;
+        GRAPH_global_context *prev_ggctx = NULL;
+        GRAPH_global_context *lru_ggctx = NULL;
+        GRAPH_global_context *lru_prev_ggctx = NULL;
+        Size total = 0;
+
+        /* add up the memory used and find the least recently used context */
+        for (curr_ggctx = global_graph_contexts; curr_ggctx != NULL;
+             curr_ggctx = curr_ggctx->next)
+        {
+            total += MemoryContextMemAllocated(curr_ggctx->memory_context,
+                                               true);
+
+            if (curr_ggctx != keep_ggctx &&
+                curr_ggctx->last_used_lxid != MyProc->lxid &&
+                (lru_ggctx == NULL ||
+                 curr_ggctx->last_used < lru_ggctx->last_used))
+            {
+                lru_ggctx = curr_ggctx;
+                lru_prev_ggctx = prev_ggctx;
+            }
+
+            prev_ggctx = curr_ggctx;
+        }
+
+        if (total <= limit || lru_ggctx == NULL)
+        {
+            return;
+        }
+
+        elog(DEBUG1, "evicting global graph \"%s\" to stay within age.global_graph_memory_limit",
+             lru_ggctx->graph_name);
+
+        /* unlink and free it */
+        if (lru_prev_ggctx == NULL)
+        {
+            global_graph_contexts = lru_ggctx->next;
+        }
+        else
+        {
+            lru_prev_ggctx->next = lru_ggctx->next;
+        }
+
+        free_specific_GRAPH_global_context(lru_ggctx);
+    }
+}
+
+/*
+ * Helper function to delete all of the global graph contexts used by the
+ * process. When done the global global_graph_contexts will be NULL.
+ */
+static bool delete_GRAPH_global_contexts(void)
+{
+    GRAPH_global_context *curr_ggctx = NULL;
+    bool retval = false;
+
+    /* get the first context, if any */
+    curr_ggctx = global_graph_contexts;
+
+    /* free all GRAPH global contexts */
+    while (curr_ggctx != NULL)
+    {
+        GRAPH_global_context *next_ggctx = curr_ggctx->next;
+
+        /* free the current graph context */
+        free_specific_GRAPH_global_context(curr_ggctx);
+
+        /* advance to the next context */
+        curr_ggctx = next_ggctx;
+
+        retval = true;
+    }
+
+    /* clear the global variable */
+    global_graph_contexts = NULL;
+
+    return retval;
+}
+
+/*
+ * Helper function to delete a specific global graph context used by the
+ * process.
+ */
+static bool delete_specific_GRAPH_global_contexts(char *graph_name)
+{
+    GRAPH_global_context *prev_ggctx = NULL;
+    GRAPH_global_context *curr_ggctx = NULL;
+    Oid graph_oid = InvalidOid;
+
+    if (graph_name == NULL)
+    {
+        return false;
+    }
+
+    /* get the graph oid */
+    graph_oid = get_graph_oid(graph_name);
+
+    /* get the first context, if any */
+    curr_ggctx = global_graph_contexts;
+
+    /* find the specified GRAPH global context */
+    while (curr_ggctx != NULL)
+    {
+        GRAPH_global_context *next_ggctx = curr_ggctx->next;
+
+        if (curr_ggctx->graph_oid == graph_oid)
+        {
+            /*
+             * If prev_ggctx is NULL then we are freeing the top of the
+             * contexts. So, we need to point the global variable to the
+             * new (next) top context, if there is one.
+             */
+            if (prev_ggctx == NULL)
+            {
+                global_graph_contexts = next_ggctx;
+            }
+            else
+            {
+                prev_ggctx->next = curr_ggctx->next;
+            }
+
+            /* free the current graph context */
+            free_specific_GRAPH_global_context(curr_ggctx);
+
+            /* we found and freed it, return true */
+            return true;
+        }
+
+        /* advance to the next one */
+        curr_ggctx = next_ggctx;
+    }
+
+    /* we didn't find it, return false */
+    return false;
+}
+
+/*
+ * Helper function to retrieve a vertex_entry from the graph's vertex hash
+ * table. If there isn't one, it returns a NULL. The latter is necessary for
+ * checking if the vsid and veid entries exist.
+ */
+vertex_entry *get_vertex_entry(GRAPH_global_context *ggctx, graphid vertex_id)
+{
+    vertex_entry *ve = NULL;
+    bool found = false;
+
+    /* an image that isn't hashed is searched instead */
+    if (ggctx->image != NULL)
+    {
+        return find_image_vertex_entry(ggctx->image, vertex_id);
+    }
+
+    /* retrieve the current vertex entry */
+    ve = (vertex_entry *)hash_search(ggctx->vertex_hashtable,
+                                     (void *)&vertex_id, HASH_FIND, &found);
+    return ve;
+}
+
+/* helper function to retrieve an edge_entry from the graph's edge hash table */
+edge_entry *get_edge_entry(GRAPH_global_context *ggctx, graphid edge_id)
+{
+    edge_entry *ee = NULL;
+    bool found = false;
+
+    /* an image that isn't hashed is searched instead */
+    if (ggctx->image != NULL)
+    {
+        ee = find_image_edge_entry(ggctx->image, edge_id);
+        Assert(ee != NULL);
+        return ee;
+    }
+
+    /* retrieve the current edge entry */
+    ee = (edge_entry *)hash_search(ggctx->edge_hashtable, (void *)&edge_id,
+                                   HASH_FIND, &found);
+    /* it should be found, otherwise we have problems */
+    Assert(found);
+
+    return ee;
+}
+
+/*
+ * Helper function to find the GRAPH_global_context used by the specified
+ * graph_oid. If not found, it returns NULL.
+ */
+GRAPH_global_context *find_GRAPH_global_context(Oid graph_oid)
+{
+    GRAPH_global_context *ggctx = NULL;
+
+    /* get the root */
+    ggctx = global_graph_contexts;
+
+    while(ggctx != NULL)
+    {
+        /* if we found it return it */
+        if (ggctx->graph_oid == graph_oid)
+        {
+            return ggctx;
+        }
+
+        /* advance to the next context */
+        ggctx = ggctx->next;
+    }
+
+    /* we did not find it so return NULL */
+    return NULL;
+}
+
+/* vertex_entry accessor functions */
+graphid get_vertex_entry_id(vertex_entry *ve)
+{
+    return ve->vertex_id;
+}
+
+/*
+ * Initialize an iterator over one of the vertex's edge lists. The caller owns
+ * the iterator, which is typically on the stack.
+ */
+void init_vertex_edge_iterator(GRAPH_global_context *ggctx, vertex_entry *ve,
+                               vertex_edge_direction direction,
+                               vertex_edge_iterator *iterator)
+{
+    ListGraphId *added = NULL;
+
+    iterator->ggctx = ggctx;
+    iterator->vertex_id = ve->vertex_id;
+
+    /* the CSR entries, if the vertex was there when they were built */
+    if (ve->vertex_index < ggctx->csr_num_vertices)
+    {
+        int64 *offsets = ggctx->csr_offsets[direction];
+        adjacency_entry *entries = ggctx->csr_entries[direction];
+
+        iterator->next_entry = &entries[offsets[ve->vertex_index]];
+        iterator->end_entry = &entries[offsets[ve->vertex_index + 1]];
+    }
+    else
+    {
+        iterator->next_entry = NULL;
+        iterator->end_entry = NULL;
+    }
+
+    /* followed by the edges added since */
+    if (direction == VERTEX_EDGES_OUT)
+    {
+        added = ve->edges_out;
+    }
+    else if (direction == VERTEX_EDGES_IN)
+    {
+        added = ve->edges_in;
+    }
+    else
+    {
+        added = ve->edges_self;
+    }
+    iterator->next_added = peek_stack_head(added);
+}
+
+/*
+ * Get the next edge, and the vertex at its other end, from the iterator. It
+ * returns false when there are no more edges.
+ */
+bool next_vertex_edge(vertex_edge_iterator *iterator, graphid *edge_id,
+                      graphid *vertex_id)
+{
+    /* the CSR entries first, skipping deleted ones */
+    while (iterator->next_entry < iterator->end_entry)
+    {
+        adjacency_entry *entry = iterator->next_entry++;
+
+        if (entry->edge_id != CSR_DELETED_EDGE)
+        {
+            *edge_id = entry->edge_id;
+            *vertex_id = get_vertex_entry_by_index(iterator->ggctx,
+                                                   entry->vertex_index)->vertex_id;
+            return true;
+        }
+    }
+
+    /* then the added edges */
+    if (iterator->next_added != NULL)
+    {
+        edge_entry *ee = NULL;
+
+        *edge_id = get_graphid(iterator->next_added);
+        iterator->next_added = next_GraphIdNode(iterator->next_added);
+
+        ee = get_edge_entry(iterator->ggctx, *edge_id);
+        *vertex_id = (ee->start_vertex_id == iterator->vertex_id) ?
+                     ee->end_vertex_id : ee->start_vertex_id;
+        return true;
+    }
+
+    return false;
+}
+
+/* get the number of edges in one of the vertex's edge lists */
+int64 get_vertex_entry_degree(GRAPH_global_context *ggctx, vertex_entry *ve,
+                              vertex_edge_direction direction)
+{
+    vertex_edge_iterator iterator;
+    graphid edge_id;
+    graphid vertex_id;
+    int64 degree = 0;
+
+    init_vertex_edge_iterator(ggctx, ve, direction, &iterator);
+    while (next_vertex_edge(&iterator, &edge_id, &vertex_id))
+    {
+        degree++;
+    }
+
+    return degree;
+}
+
+
+/* get the dense index of the vertex */
+uint32 get_vertex_entry_index(vertex_entry *ve)
+{
+    return ve->vertex_index;
+}
+
+/*
+ * Get the vertex entry for a dense vertex index, without a hash lookup. It
+ * returns NULL if the vertex has been deleted.
+ */
+vertex_entry *get_vertex_entry_by_index(GRAPH_global_context *ggctx,
+                                        uint32 vertex_index)
+{
+    Assert(vertex_index < ggctx->num_vertex_indexes);
+
+    /* the vertices of an image are stored in dense index order */
+    if (ggctx->image != NULL)
+    {
+        vertex_entry *vertices = (vertex_entry *)((char *)ggctx->image +
+                                                  ggctx->image->vertices_offset);
+
+        return &vertices[vertex_index];
+    }
+
+    return ggctx->vertex_index_entries[vertex_index];
+}
+
+/*
+ * Get the number of dense vertex indexes used by the graph. Every vertex's
+ * index is below it, so it can be used to size arrays indexed by them.
+ */
+uint32 get_ggctx_num_vertex_indexes(GRAPH_global_context *ggctx)
+{
+    return ggctx->num_vertex_indexes;
+}
+
+Oid get_vertex_entry_label_table_oid(vertex_entry *ve)
+{
+    return ve->vertex_label_table_oid;
+}
+
+/*
+ * If the vertex's properties weren't loaded, they are fetched from its label
+ * table and returned as a palloc'd copy. Use free_vertex_entry_properties to
+ * release them.
+ */
+Datum get_vertex_entry_properties(vertex_entry *ve)
+{
+    /* the properties of an image's entry follow it */
+    if (ve->properties_offset != 0)
+    {
+        return PointerGetDatum((char *)ve + ve->properties_offset);
+    }
+
+    if (ve->vertex_properties == (Datum) 0)
+    {
+        return fetch_entity_properties(ve->vertex_label_table_oid, &ve->tid,
+                                       ve->vertex_id, 1);
+    }
+
+    return ve->vertex_properties;
+}
+
+void free_vertex_entry_properties(vertex_entry *ve, Datum properties)
+{
+    if (ve->properties_offset == 0 && ve->vertex_properties == (Datum) 0)
+    {
+        pfree(DatumGetPointer(properties));
+    }
+}
+
+/* edge_entry accessor functions */
+graphid get_edge_entry_id(edge_entry *ee)
+{
+    return ee->edge_id;
+}
+
+Oid get_edge_entry_label_table_oid(edge_entry *ee)
+{
+    return ee->edge_label_table_oid;
+}
+
+/* see get_vertex_entry_properties */
+Datum get_edge_entry_properties(edge_entry *ee)
+{
+    if (ee->properties_offset != 0)
+    {
+        return PointerGetDatum((char *)ee + ee->properties_offset);
+    }
+
+    if (ee->edge_properties == (Datum) 0)
+    {
+        return fetch_entity_properties(ee->edge_label_table_oid, &ee->tid,
+                                       ee->edge_id, 3);
+    }
+
+    return ee->edge_properties;
+}
+
+void free_edge_entry_properties(edge_entry *ee, Datum properties)
+{
+    if (ee->properties_offset == 0 && ee->edge_properties == (Datum) 0)
+    {
+        pfree(DatumGetPointer(properties));
+    }
+}
+
+graphid get_edge_entry_start_vertex_id(edge_entry *ee)
+{
+    return ee->start_vertex_id;
+}
+
+graphid get_edge_entry_end_vertex_id(edge_entry *ee)
+{
+    return ee->end_vertex_id;
+}
+
+/* GRAPH global shared image functions */
+
+/*
+ * Request the shared memory for the shared image registry. This is only
+ * possible when age is loaded via shared_preload_libraries. Otherwise, the
+ * registry is unavailable and each backend builds its own GRAPH global
+ * contexts.
+ */
+void global_graph_shmem_init(void)
+{
+    if (!process_shared_preload_libraries_in_progress)
+    {
+        return;
+    }
+
+    RequestAddinShmemSpace(MAXALIGN(sizeof(shared_graph_registry)));
+    RequestNamedLWLockTranche(SHARED_GRAPH_LWLOCK_TRANCHE, 1);
+
+    prev_shmem_startup_hook = shmem_startup_hook;
+    shmem_startup_hook = global_graph_shmem_startup;
+}
+
+void global_graph_shmem_fini(void)
+{
+    if (shmem_startup_hook == global_graph_shmem_startup)
+    {
+        shmem_startup_hook = prev_shmem_startup_hook;
+    }
+}
+
+/* create, or attach to, the shared image registry */
+static void global_graph_shmem_startup(void)
+{
+    bool found = false;
+
+    if (prev_shmem_startup_hook)
+    {
+        prev_shmem_startup_hook();
+    }
+
+    LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+    shared_registry = ShmemInitStruct(SHARED_GRAPH_REGISTRY_NAME,
+                                      sizeof(shared_graph_registry), &found);
+    if (!found)
+    {
+        MemSet(shared_registry, 0, sizeof(shared_graph_registry));
+        shared_registry->lock =
+            &(GetNamedLWLockTranche(SHARED_GRAPH_LWLOCK_TRANCHE))->lock;
+        /* snapshot files saved before this can't be checked for changes */
+        shared_registry->epoch = GetCurrentTimestamp();
+    }
+
+    LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * Returns true if GRAPH global contexts are shared between backends. A
+ * parallel worker then attaches to its leader's shared image. Otherwise, each
+ * parallel worker builds its own GRAPH global context.
+ */
+bool are_GRAPH_global_contexts_shared(void)
+{
+    return (age_enable_shared_global_graph && shared_registry != NULL);
+}
+
+/*
+ * Helper function to determine if a shared image can be built from, or used
+ * with, the passed snapshot. The current transaction must not have written
+ * anything, as an image can't contain uncommitted changes.
+ */
+static bool can_share_snapshot(Snapshot snapshot)
+{
+    if (!are_GRAPH_global_contexts_shared())
+    {
+        return false;
+    }
+
+    if (GetTopTransactionIdIfAny() != InvalidTransactionId)
+    {
+        return false;
+    }
+
+    return (snapshot->snapshot_type == SNAPSHOT_MVCC);
+}
+
+/* qsort comparator for transaction ids */
+static int xid_cmp(const void *a, const void *b)
+{
+    TransactionId xa = *(const TransactionId *)a;
+    TransactionId xb = *(const TransactionId *)b;
+
+    if (xa < xb)
+    {
+        return -1;
+    }
+    if (xa > xb)
+    {
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Helper function to find the registry slot for the graph in the current
+ * database. The caller must hold the registry lock.
+ */
+static shared_graph_slot *find_shared_graph_slot(Oid graph_oid)
+{
+    int i;
+
+    for (i = 0; i < SHARED_GRAPH_MAX_IMAGES; i++)
+    {
+        shared_graph_slot *slot = &shared_registry->slots[i];
+
+        if (slot->database_oid == MyDatabaseId && slot->graph_oid == graph_oid)
+        {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Helper function to attach to the shared image of the graph, if there is a
+ * usable one, and use its entries in place. Returns false if there isn't a
+ * usable image.
+ */
+static bool attach_shared_GRAPH_global_image(GRAPH_global_context *ggctx)
+{
+    shared_graph_slot *slot = NULL;
+    dsm_segment *seg = NULL;
+    Snapshot snapshot;
+    uint64 generation;
+    uint64 all_generation;
+
+    snapshot = GetActiveSnapshot();
+
+    /*
+     * The image is usable if the graph hasn't changed since it was built, and
+     * the snapshot sees all of the graph's committed changes. The snapshot
+     * must also be no older than the image's, so that every transaction the
+     * image's snapshot saw as finished is finished for it too.
+     */
+    if (!can_share_snapshot(snapshot) ||
+        !snapshot_sees_graph_changes(ggctx->graph_oid, snapshot, &generation,
+                                     &all_generation))
+    {
+        return false;
+    }
+
+    LWLockAcquire(shared_registry->lock, LW_SHARED);
+
+    slot = find_shared_graph_slot(ggctx->graph_oid);
+
+    if (slot != NULL &&
+        slot->generation == generation &&
+        slot->all_generation == all_generation &&
+        TransactionIdPrecedesOrEquals(slot->xmin, snapshot->xmin) &&
+        dsm_find_mapping(slot->handle) == NULL)
+    {
+        /* this returns NULL if the segment has since been destroyed */
+        seg = dsm_attach(slot->handle);
+    }
+
+    LWLockRelease(shared_registry->lock);
+
+    if (seg == NULL)
+    {
+        return false;
+    }
+
+    /* keep the mapping for the life of the GRAPH global context */
+    dsm_pin_mapping(seg);
+    ggctx->shared_image = seg;
+
+    use_GRAPH_global_image(ggctx,
+                           (shared_graph_image *)dsm_segment_address(seg));
+
+    return true;
+}
+
+/*
+ * Helper function to use the entries and CSR arrays of an image, shared or
+ * mapped from a snapshot file, in place. The GRAPH global hashtables aren't
+ * built, as they would only duplicate the image. Vertices and edges are found
+ * in the image instead, until the context's own changes need to be applied.
+ */
+static void use_GRAPH_global_image(GRAPH_global_context *ggctx,
+                                   shared_graph_image *image)
+{
+    char *base = (char *)image;
+    int d;
+
+    Assert(image->graph_oid == ggctx->graph_oid);
+
+    ggctx->image = image;
+    ggctx->num_loaded_vertices = image->num_vertices;
+    ggctx->num_loaded_edges = image->num_edges;
+    ggctx->num_vertex_indexes = (uint32) image->num_vertices;
+
+    /* the adjacency is used in place */
+    ggctx->csr_in_image = true;
+    ggctx->csr_num_vertices = image->num_vertices;
+    for (d = 0; d < NUM_VERTEX_EDGE_DIRECTIONS; d++)
+    {
+        ggctx->csr_offsets[d] = (int64 *)(base + image->csr_offsets_offset[d]);
+        ggctx->csr_entries[d] =
+            (adjacency_entry *)(base + image->csr_entries_offset[d]);
+        ggctx->csr_num_entries[d] = image->csr_num_entries[d];
+    }
+}
+
+/*
+ * Helper function to build the GRAPH global hashtables, and the dense vertex
+ * index, from the image a context uses. They are backend local, so that they
+ * can be patched with this backend's own deltas. The properties still point
+ * into the image, as do the CSR arrays.
+ */
+static void hash_GRAPH_global_image(GRAPH_global_context *ggctx)
+{
+    shared_graph_image *image = ggctx->image;
+    vertex_entry *vertices = NULL;
+    edge_entry *edges = NULL;
+    MemoryContext oldctx = NULL;
+    int64 i;
+
+    vertices = (vertex_entry *)((char *)image + image->vertices_offset);
+    edges = (edge_entry *)((char *)image + image->edges_offset);
+
+    oldctx = MemoryContextSwitchTo(ggctx->memory_context);
+
+    create_GRAPH_global_hashtables(ggctx);
+
+    /* the entries are now looked up in the hashtables */
+    ggctx->image = NULL;
+    ggctx->num_loaded_vertices = 0;
+    ggctx->num_loaded_edges = 0;
+    ggctx->num_vertex_indexes = 0;
+
+    for (i = 0; i < image->num_vertices; i++)
+    {
+        vertex_entry *ive = &vertices[i];
+
+        if (!insert_vertex_entry(ggctx, ive->vertex_id,
+                                 ive->vertex_label_table_oid,
+                                 PointerGetDatum((char *)ive +
+                                                 ive->properties_offset),
+                                 NULL))
+        {
+            elog(ERROR, "insert_vertex_entry: failed due to duplicate");
+        }
+
+        /* the vertices are stored in dense index order */
+        Assert(get_vertex_entry(ggctx, ive->vertex_id)->vertex_index == i);
+    }
+
+    for (i = 0; i < image->num_edges; i++)
+    {
+        edge_entry *iee = &edges[i];
+
+        if (!insert_edge(ggctx, iee->edge_id,
+                         PointerGetDatum((char *)iee + iee->properties_offset),
+                         iee->start_vertex_id, iee->end_vertex_id,
+                         iee->edge_label_table_oid, NULL))
+        {
+            elog(ERROR, "insert_edge: failed to insert");
+        }
+    }
+
+    MemoryContextSwitchTo(oldctx);
+}
+
+/* helper function to find a vertex in an image, by a binary search */
+static vertex_entry *find_image_vertex_entry(shared_graph_image *image,
+                                             graphid vertex_id)
+{
+    char *base = (char *)image;
+    vertex_entry *vertices = (vertex_entry *)(base + image->vertices_offset);
+    uint32 *order = (uint32 *)(base + image->vertex_order_offset);
+    int64 low = 0;
+    int64 high = image->num_vertices - 1;
+
+    while (low <= high)
+    {
+        int64 mid = low + (high - low) / 2;
+        vertex_entry *ve = &vertices[order[mid]];
+
+        if (ve->vertex_id == vertex_id)
+        {
+            return ve;
+        }
+        if (ve->vertex_id < vertex_id)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+
+    return NULL;
+}
+
+/* helper function to find an edge in an image, by a binary search */
+static edge_entry *find_image_edge_entry(shared_graph_image *image,
+                                         graphid edge_id)
+{
+    edge_entry *edges = (edge_entry *)((char *)image + image->edges_offset);
+    int64 low = 0;
+    int64 high = image->num_edges - 1;
+
+    while (low <= high)
+    {
+        int64 mid = low + (high - low) / 2;
+        edge_entry *ee = &edges[mid];
+
+        if (ee->edge_id == edge_id)
+        {
+            return ee;
+        }
+        if (ee->edge_id < edge_id)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Helper function to copy a properties datum, detoasted, into the image at the
+ * specified offset. It returns the offset following the copy.
+ */
+static Size copy_properties_to_image(char *base, Size offset, Datum properties)
+{
+    struct varlena *original = (struct varlena *)DatumGetPointer(properties);
+    struct varlena *detoasted = NULL;
+    Size size;
+
+    detoasted = pg_detoast_datum(original);
+    size = VARSIZE(detoasted);
+    memcpy(base + offset, detoasted, size);
+
+    if (detoasted != original)
+    {
+        pfree(detoasted);
+    }
+
+    return offset + MAXALIGN(size);
+}
+
+/*
+ * Helper function to compute the size of the flat image of a freshly loaded
+ * GRAPH global context.
+ */
+static Size get_GRAPH_global_image_size(GRAPH_global_context *ggctx)
+{
+    Size size;
+    int64 k;
+    uint32 i;
+    int j;
+    int d;
+    const vertex_edge_direction edge_owners[2] = {VERTEX_EDGES_OUT,
+                                                  VERTEX_EDGES_SELF};
+
+    size = MAXALIGN(sizeof(shared_graph_image));
+    size += MAXALIGN(sizeof(vertex_entry) * ggctx->num_loaded_vertices);
+    size += MAXALIGN(sizeof(uint32) * ggctx->num_loaded_vertices);
+    size += MAXALIGN(sizeof(edge_entry) * ggctx->num_loaded_edges);
+
+    for (d = 0; d < NUM_VERTEX_EDGE_DIRECTIONS; d++)
+    {
+        size += MAXALIGN(sizeof(int64) * (ggctx->csr_num_vertices + 1));
+        size += MAXALIGN(sizeof(adjacency_entry) * ggctx->csr_num_entries[d]);
+    }
+
+    for (i = 0; i < ggctx->num_vertex_indexes; i++)
+    {
+        vertex_entry *ve = ggctx->vertex_index_entries[i];
+
+        size += MAXALIGN(toast_raw_datum_size(ve->vertex_properties));
+    }
+
+    /* every edge is in exactly one of the exiting or selfloop entries */
+    for (j = 0; j < 2; j++)
+    {
+        for (k = 0; k < ggctx->csr_num_entries[edge_owners[j]]; k++)
+        {
+            adjacency_entry *entry = &ggctx->csr_entries[edge_owners[j]][k];
+            edge_entry *ee = get_edge_entry(ggctx, entry->edge_id);
+
+            size += MAXALIGN(toast_raw_datum_size(ee->edge_properties));
+        }
+    }
+
+    return size;
+}
+
+/* qsort_arg comparator for the vertex array indexes of an image, by id */
+static int image_vertex_order_cmp(const void *a, const void *b, void *arg)
+{
+    vertex_entry *vertices = (vertex_entry *)arg;
+
+    return graphid_cmp(&vertices[*(const uint32 *)a].vertex_id,
+                       &vertices[*(const uint32 *)b].vertex_id);
+}
+
+/* qsort comparator for edge entries, by id */
+static int edge_entry_cmp(const void *a, const void *b)
+{
+    return graphid_cmp(&((const edge_entry *)a)->edge_id,
+                       &((const edge_entry *)b)->edge_id);
+}
+
+/*
+ * Helper function to build the flat image of a freshly loaded GRAPH global
+ * context into base. The size must be from get_GRAPH_global_image_size.
+ */
+static void build_GRAPH_global_image(GRAPH_global_context *ggctx, char *base,
+                                     Size size)
+{
+    shared_graph_image *image = NULL;
+    vertex_entry *vertices = NULL;
+    uint32 *order = NULL;
+    edge_entry *edges = NULL;
+    Size offset;
+    int64 nvertices = 0;
+    int64 nedges = 0;
+    int64 k;
+    uint32 i;
+    int j;
+    int d;
+    const vertex_edge_direction edge_owners[2] = {VERTEX_EDGES_OUT,
+                                                  VERTEX_EDGES_SELF};
+
+    /* build the header */
+    image = (shared_graph_image *)base;
+    image->graph_oid = ggctx->graph_oid;
+    image->num_vertices = ggctx->num_loaded_vertices;
+    image->num_edges = ggctx->num_loaded_edges;
+    image->vertices_offset = MAXALIGN(sizeof(shared_graph_image));
+    image->vertex_order_offset = image->vertices_offset +
+        MAXALIGN(sizeof(vertex_entry) * image->num_vertices);
+    image->edges_offset = image->vertex_order_offset +
+        MAXALIGN(sizeof(uint32) * image->num_vertices);
+    image->total_size = size;
+
+    vertices = (vertex_entry *)(base + image->vertices_offset);
+    order = (uint32 *)(base + image->vertex_order_offset);
+    edges = (edge_entry *)(base + image->edges_offset);
+    offset = image->edges_offset +
+        MAXALIGN(sizeof(edge_entry) * image->num_edges);
+
+    /* copy in the CSR arrays */
+    for (d = 0; d < NUM_VERTEX_EDGE_DIRECTIONS; d++)
+    {
+        Size offsets_size = sizeof(int64) * (ggctx->csr_num_vertices + 1);
+        Size entries_size = sizeof(adjacency_entry) *
+                            ggctx->csr_num_entries[d];
+
+        image->csr_offsets_offset[d] = offset;
+        memcpy(base + offset, ggctx->csr_offsets[d], offsets_size);
+        offset += MAXALIGN(offsets_size);
+
+        image->csr_entries_offset[d] = offset;
+        memcpy(base + offset, ggctx->csr_entries[d], entries_size);
+        offset += MAXALIGN(entries_size);
+
+        image->csr_num_entries[d] = ggctx->csr_num_entries[d];
+    }
+
+    /*
+     * Copy in the vertices, in dense index order. A freshly loaded context
+     * hasn't any edges outside of the CSR arrays, nor deleted vertices.
+     */
+    for (i = 0; i < ggctx->num_vertex_indexes; i++)
+    {
+        vertex_entry *ve = ggctx->vertex_index_entries[i];
+        vertex_entry *ive = &vertices[nvertices];
+
+        Assert(ve->vertex_index == nvertices);
+
+        MemSet(ive, 0, sizeof(vertex_entry));
+        ive->vertex_id = ve->vertex_id;
+        ive->vertex_index = ve->vertex_index;
+        ive->vertex_label_table_oid = ve->vertex_label_table_oid;
+        ItemPointerSetInvalid(&ive->tid);
+        ive->properties_offset = offset - ((char *)ive - base);
+        offset = copy_properties_to_image(base, offset, ve->vertex_properties);
+        order[nvertices] = (uint32) nvertices;
+        nvertices++;
+    }
+
+    /* order the vertices by id, for finding them */
+    qsort_arg(order, nvertices, sizeof(uint32), image_vertex_order_cmp,
+              vertices);
+
+    /*
+     * Copy in the edges. Their properties offsets are from the start of the
+     * image, until the edges are ordered by id.
+     */
+    for (j = 0; j < 2; j++)
+    {
+        for (k = 0; k < ggctx->csr_num_entries[edge_owners[j]]; k++)
+        {
+            adjacency_entry *entry = &ggctx->csr_entries[edge_owners[j]][k];
+            edge_entry *ee = get_edge_entry(ggctx, entry->edge_id);
+            edge_entry *iee = &edges[nedges];
+
+            MemSet(iee, 0, sizeof(edge_entry));
+            iee->edge_id = ee->edge_id;
+            iee->start_vertex_id = ee->start_vertex_id;
+            iee->end_vertex_id = ee->end_vertex_id;
+            iee->edge_label_table_oid = ee->edge_label_table_oid;
+            ItemPointerSetInvalid(&iee->tid);
+            iee->properties_offset = offset;
+            offset = copy_properties_to_image(base, offset,
+                                              ee->edge_properties);
+            nedges++;
+        }
+    }
+
+    qsort(edges, nedges, sizeof(edge_entry), edge_entry_cmp);
+
+    for (k = 0; k < nedges; k++)
+    {
+        edges[k].properties_offset -= ((char *)&edges[k] - base);
+    }
+
+    Assert(nvertices == image->num_vertices);
+    Assert(nedges == image->num_edges);
+    Assert(offset == size);
+}
+
+/*
+ * Helper function to publish a freshly loaded GRAPH global context as a shared
+ * image, so that other backends that would see the same graph can use it
+ * instead of scanning the label tables. That is only known when the graph's
+ * change counts were taken for the context. Publishing is best effort; if the
+ * image can't be created or registered, nothing is published.
+ */
+static void publish_shared_GRAPH_global_image(GRAPH_global_context *ggctx)
+{
+    shared_graph_slot *slot = NULL;
+    dsm_segment *seg = NULL;
+    dsm_handle old_handle = 0;
+    bool replaced = false;
+    Snapshot snapshot;
+    Size size;
+    int i;
+
+    snapshot = GetActiveSnapshot();
+
+    /* an image holds properties, so it can't be built from a lazy context */
+    if (ggctx->lazy_properties || !ggctx->changes_counted ||
+        !can_share_snapshot(snapshot))
+    {
+        return;
+    }
+
+    size = get_GRAPH_global_image_size(ggctx);
+
+    seg = dsm_create(size, DSM_CREATE_NULL_IF_MAXSEGMENTS);
+    if (seg == NULL)
+    {
+        return;
+    }
+
+    build_GRAPH_global_image(ggctx, dsm_segment_address(seg), size);
+
+    /* keep the segment around after we detach */
+    dsm_pin_segment(seg);
+
+    LWLockAcquire(shared_registry->lock, LW_EXCLUSIVE);
+
+    /* replace this graph's image, if there is one, else use a free slot */
+    slot = find_shared_graph_slot(ggctx->graph_oid);
+    if (slot != NULL)
+    {
+        old_handle = slot->handle;
+        replaced = true;
+    }
+    else
+    {
+        for (i = 0; i < SHARED_GRAPH_MAX_IMAGES; i++)
+        {
+            if (shared_registry->slots[i].database_oid == InvalidOid)
+            {
+                slot = &shared_registry->slots[i];
+                break;
+            }
+        }
+    }
+
+    if (slot != NULL)
+    {
+        slot->database_oid = MyDatabaseId;
+        slot->graph_oid = ggctx->graph_oid;
+        slot->handle = dsm_segment_handle(seg);
+        slot->generation = ggctx->change_generation;
+        slot->all_generation = ggctx->all_change_generation;
+        slot->xmin = snapshot->xmin;
+    }
+
+    LWLockRelease(shared_registry->lock);
+
+    /* if there wasn't a slot available, discard our image */
+    if (slot == NULL)
+    {
+        dsm_unpin_segment(dsm_segment_handle(seg));
+    }
+
+    /* the replaced image is destroyed once the last backend detaches */
+    if (replaced)
+    {
+        dsm_unpin_segment(old_handle);
+    }
+
+    dsm_detach(seg);
+}
+
+/*
+ * Helper function to remove the shared image for the specified graph, or for
+ * all graphs in the current database if graph_oid is InvalidOid. Backends that
+ * are currently attached keep their mappings until they free their contexts.
+ * It returns true if any image was removed.
+ */
+static bool remove_shared_GRAPH_global_images(Oid graph_oid)
+{
+    dsm_handle handles[SHARED_GRAPH_MAX_IMAGES];
+    int nhandles = 0;
+    int i;
+
+    if (shared_registry == NULL)
+    {
+        return false;
+    }
+
+    LWLockAcquire(shared_registry->lock, LW_EXCLUSIVE);
+
+    for (i = 0; i < SHARED_GRAPH_MAX_IMAGES; i++)
+    {
+        shared_graph_slot *slot = &shared_registry->slots[i];
+
+        if (slot->database_oid == MyDatabaseId &&
+            (graph_oid == InvalidOid || slot->graph_oid == graph_oid))
+        {
+            handles[nhandles++] = slot->handle;
+            MemSet(slot, 0, sizeof(shared_graph_slot));
+        }
+    }
+
+    LWLockRelease(shared_registry->lock);
+
+    for (i = 0; i < nhandles; i++)
+    {
+        dsm_unpin_segment(handles[i]);
+    }
+
+    return (nhandles > 0);
+}
+
+/*
+ * Helper function to remember that the current transaction is changing the
+ * specified graph, or possibly any graph if graph_oid is InvalidOid.
+ */
+static void note_GRAPH_global_change(Oid graph_oid)
+{
+    MemoryContext oldctx = NULL;
+
+    if (graph_oid == InvalidOid)
+    {
+        xact_changed_all_graphs = true;
+        return;
+    }
+
+    oldctx = MemoryContextSwitchTo(TopMemoryContext);
+    xact_changed_graphs = list_append_unique_oid(xact_changed_graphs,
+                                                 graph_oid);
+    MemoryContextSwitchTo(oldctx);
+}
+
+/* has the current transaction changed, or possibly changed, the graph */
+static bool is_graph_changed_by_xact(Oid graph_oid)
+{
+    return (xact_changed_all_graphs ||
+            list_member_oid(xact_changed_graphs, graph_oid));
+}
+
+/*
+ * Helper function to find the change entry for the graph in the current
+ * database, creating it if asked to and there is room. The caller must hold
+ * the registry lock, exclusively to create it.
+ */
+static shared_graph_change *find_shared_graph_change(Oid graph_oid,
+                                                     bool create)
+{
+    shared_graph_change *unused = NULL;
+    int i;
+
+    for (i = 0; i < SHARED_GRAPH_MAX_CHANGES; i++)
+    {
+        shared_graph_change *change = &shared_registry->changes[i];
+
+        if (change->database_oid == MyDatabaseId &&
+            change->graph_oid == graph_oid)
+        {
+            return change;
+        }
+        if (change->database_oid == InvalidOid && unused == NULL)
+        {
+            unused = change;
+        }
+    }
+
+    if (!create || unused == NULL)
+    {
+        return NULL;
+    }
+
+    unused->database_oid = MyDatabaseId;
+    unused->graph_oid = graph_oid;
+    unused->generation = 0;
+    unused->pending = 0;
+    MemSet(&unused->changers, 0, sizeof(shared_graph_changers));
+
+    return unused;
+}
+
+/*
+ * Helper function to get the change counts that apply to the graph. Graphs
+ * without a change entry are covered by the counts for all graphs. The caller
+ * must hold the registry lock.
+ */
+static void get_shared_graph_change_counts(Oid graph_oid, uint64 *generation,
+                                           uint64 *all_generation,
+                                           uint32 *pending)
+{
+    shared_graph_change *change = NULL;
+
+    change = find_shared_graph_change(graph_oid, false);
+
+    *generation = (change != NULL) ? change->generation : 0;
+    *all_generation = shared_registry->all_generation;
+    *pending = shared_registry->all_pending +
+               ((change != NULL) ? change->pending : 0);
+}
+
+/*
+ * Count the graphs changed by the current transaction as pending. This is done
+ * before the transaction becomes visible as committed, so that no snapshot can
+ * see the changes while the counts still say there aren't any. A transaction
+ * without an xid didn't actually change anything.
+ */
+static void count_GRAPH_global_changes_pending(void)
+{
+    TransactionId xid = GetTopTransactionIdIfAny();
+    ListCell *lc;
+
+    if (shared_registry == NULL || xact_changes_pending ||
+        !TransactionIdIsValid(xid) ||
+        (xact_changed_graphs == NIL && !xact_changed_all_graphs))
+    {
+        return;
+    }
+
+    LWLockAcquire(shared_registry->lock, LW_EXCLUSIVE);
+
+    foreach (lc, xact_changed_graphs)
+    {
+        shared_graph_change *change = NULL;
+
+        change = find_shared_graph_change(lfirst_oid(lc), true);
+        if (change != NULL)
+        {
+            change->pending++;
+        }
+        else
+        {
+            shared_registry->all_pending++;
+        }
+    }
+    if (xact_changed_all_graphs)
+    {
+        shared_registry->all_pending++;
+    }
+
+    LWLockRelease(shared_registry->lock);
+
+    xact_changes_pending = true;
+    xact_changes_xid = xid;
+}
+
+/*
+ * Count the graphs changed by the current transaction as done and, if it
+ * committed, as changed by it. Then, forget about them.
+ */
+static void count_GRAPH_global_changes_done(bool committed)
+{
+    ListCell *lc;
+
+    if (xact_changes_pending)
+    {
+        LWLockAcquire(shared_registry->lock, LW_EXCLUSIVE);
+
+        foreach (lc, xact_changed_graphs)
+        {
+            shared_graph_change *change = NULL;
+
+            change = find_shared_graph_change(lfirst_oid(lc), false);
+            if (change != NULL)
+            {
+                change->pending--;
+                if (committed)
+                {
+                    change->generation++;
+                    add_shared_graph_changer(&change->changers,
+                                             xact_changes_xid);
+                }
+            }
+            else
+            {
+                shared_registry->all_pending--;
+                if (committed)
+                {
+                    shared_registry->all_generation++;
+                    add_shared_graph_changer(&shared_registry->all_changers,
+                                             xact_changes_xid);
+                }
+            }
+        }
+        if (xact_changed_all_graphs)
+        {
+            shared_registry->all_pending--;
+            if (committed)
+            {
+                shared_registry->all_generation++;
+                add_shared_graph_changer(&shared_registry->all_changers,
+                                         xact_changes_xid);
+            }
+        }
+
+        LWLockRelease(shared_registry->lock);
+    }
+
+    list_free(xact_changed_graphs);
+    xact_changed_graphs = NIL;
+    xact_changed_all_graphs = false;
+    xact_changes_pending = false;
+    xact_changes_xid = InvalidTransactionId;
+}
+
+/*
+ * Helper function to remember a committed changer, pushing out the oldest one.
+ * The caller must hold the registry lock exclusively.
+ */
+static void add_shared_graph_changer(shared_graph_changers *changers,
+                                     TransactionId xid)
+{
+    TransactionId old_xid = changers->xids[changers->next];
+
+    if (TransactionIdIsValid(old_xid) &&
+        (!TransactionIdIsValid(changers->evicted_xid) ||
+         TransactionIdFollows(old_xid, changers->evicted_xid)))
+    {
+        changers->evicted_xid = old_xid;
+    }
+
+    changers->xids[changers->next] = xid;
+    changers->next = (changers->next + 1) % SHARED_GRAPH_RECENT_CHANGERS;
+}
+
+/*
+ * Helper function to check that the snapshot sees every committed changer. A
+ * changer that was pushed out is only known to be seen if it precedes the
+ * snapshot's xmin.
+ */
+static bool snapshot_sees_changers(shared_graph_changers *changers,
+                                   Snapshot snapshot)
+{
+    int i;
+
+    if (TransactionIdIsValid(changers->evicted_xid) &&
+        !TransactionIdPrecedes(changers->evicted_xid, snapshot->xmin))
+    {
+        return false;
+    }
+
+    for (i = 0; i < SHARED_GRAPH_RECENT_CHANGERS; i++)
+    {
+        if (TransactionIdIsValid(changers->xids[i]) &&
+            XidInMVCCSnapshot(changers->xids[i], snapshot))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Helper function to check that the snapshot sees all of the committed changes
+ * to the graph, and that none are being committed. If so, it returns the
+ * graph's change counts.
+ */
+static bool snapshot_sees_graph_changes(Oid graph_oid, Snapshot snapshot,
+                                        uint64 *generation,
+                                        uint64 *all_generation)
+{
+    shared_graph_change *change = NULL;
+    uint32 pending;
+    bool result;
+
+    if (shared_registry == NULL || snapshot->snapshot_type != SNAPSHOT_MVCC)
+    {
+        return false;
+    }
+
+    LWLockAcquire(shared_registry->lock, LW_SHARED);
+
+    get_shared_graph_change_counts(graph_oid, generation, all_generation,
+                                   &pending);
+    change = find_shared_graph_change(graph_oid, false);
+
+    result = (pending == 0 &&
+              snapshot_sees_changers(&shared_registry->all_changers,
+                                     snapshot) &&
+              (change == NULL ||
+               snapshot_sees_changers(&change->changers, snapshot)));
+
+    LWLockRelease(shared_registry->lock);
+
+    return result;
+}
+
+/*
+ * Helper function to record the change counts of the graph a GRAPH global
+ * context was just loaded for, if its snapshot saw all of the changes. The
+ * context then stays valid, for newer snapshots, until the graph changes.
+ */
+static void count_GRAPH_global_context_changes(GRAPH_global_context *ggctx,
+                                               Snapshot snapshot)
+{
+    ggctx->changes_counted =
+        (!is_graph_changed_by_xact(ggctx->graph_oid) &&
+         snapshot_sees_graph_changes(ggctx->graph_oid, snapshot,
+                                     &ggctx->change_generation,
+                                     &ggctx->all_change_generation));
+}
+
+/* build the path, relative to the data directory, of a graph snapshot file */
+static void get_graph_snapshot_file_path(Oid graph_oid, char *path)
+{
+    snprintf(path, MAXPGPATH, "%s/%u_%u.snap", GRAPH_SNAPSHOT_DIR,
+             MyDatabaseId, graph_oid);
+}
+
+/*
+ * Delete the snapshot file of a dropped graph, if it has one, so that a graph
+ * created with the same oid can't load it. It is deleted right away. If the
+ * drop is rolled back, the graph just has to be loaded from its tables.
+ */
+void delete_GRAPH_global_snapshot_file(Oid graph_oid)
+{
+    char path[MAXPGPATH];
+
+    get_graph_snapshot_file_path(graph_oid, path);
+
+    if (unlink(path) != 0 && errno != ENOENT)
+    {
+        ereport(WARNING,
+                (errcode_for_file_access(),
+                 errmsg("could not remove file \"%s\": %m", path)));
+    }
+}
+
+/*
+ * Helper function to save a snapshot file of the graph. The graph is loaded,
+ * with properties, using the latest snapshot and written out as an image. It
+ * returns false if the graph was being changed, in which case nothing is
+ * saved.
+ */
+static bool save_GRAPH_global_snapshot_file(char *graph_name, Oid graph_oid)
+{
+    GRAPH_global_context *ggctx = NULL;
+    graph_snapshot_header *header = NULL;
+    MemoryContext oldctx = NULL;
+    char path[MAXPGPATH];
+    char temp_path[MAXPGPATH];
+    uint64 generation;
+    uint64 all_generation;
+    uint32 pending;
+    TimestampTz epoch;
+    char *buffer = NULL;
+    Size image_offset;
+    Size size;
+    Size written;
+    bool saved = false;
+    int fd;
+
+    if (shared_registry == NULL)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+                 errmsg("graph snapshots require age to be loaded via shared_preload_libraries")));
+    }
+
+    if (is_graph_changed_by_xact(graph_oid))
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+                 errmsg("cannot save a snapshot of graph \"%s\" changed by the current transaction",
+                        graph_name)));
+    }
+
+    /* get the change counts before taking the snapshot to load with */
+    LWLockAcquire(shared_registry->lock, LW_SHARED);
+    get_shared_graph_change_counts(graph_oid, &generation, &all_generation,
+                                   &pending);
+    epoch = shared_registry->epoch;
+    LWLockRelease(shared_registry->lock);
+
+    if (pending > 0)
+    {
+        return false;
+    }
+
+    /* load the graph, with its properties, into a private context */
+    PushActiveSnapshot(GetLatestSnapshot());
+
+    ggctx = palloc0(sizeof(GRAPH_global_context));
+    ggctx->graph_name = pstrdup(graph_name);
+    ggctx->graph_oid = graph_oid;
+    ggctx->lazy_properties = false;
+    ggctx->memory_context = AllocSetContextCreate(TopMemoryContext,
+                                                  "AGE global graph",
+                                                  ALLOCSET_DEFAULT_SIZES);
+    oldctx = MemoryContextSwitchTo(ggctx->memory_context);
+    create_GRAPH_global_hashtables(ggctx);
+    load_GRAPH_global_hashtables(ggctx);
+    MemoryContextSwitchTo(oldctx);
+
+    /* build the file contents */
+    image_offset = MAXALIGN(sizeof(graph_snapshot_header));
+    size = image_offset + get_GRAPH_global_image_size(ggctx);
+    buffer = MemoryContextAllocHuge(CurrentMemoryContext, size);
+    MemSet(buffer, 0, image_offset);
+
+    header = (graph_snapshot_header *)buffer;
+    header->magic = GRAPH_SNAPSHOT_MAGIC;
+    header->version = GRAPH_SNAPSHOT_VERSION;
+    header->database_oid = MyDatabaseId;
+    header->graph_oid = graph_oid;
+    header->epoch = epoch;
+    header->generation = generation;
+    header->all_generation = all_generation;
+    header->xmax = GetActiveSnapshot()->xmax;
+    header->image_size = size - image_offset;
+    build_GRAPH_global_image(ggctx, buffer + image_offset,
+                             header->image_size);
+
+    free_specific_GRAPH_global_context(ggctx);
+    PopActiveSnapshot();
+
+    /* write it to a temporary file */
+    if (MakePGDirectory(GRAPH_SNAPSHOT_DIR) < 0 && errno != EEXIST)
+    {
+        ereport(ERROR,
+                (errcode_for_file_access(),
+                 errmsg("could not create directory \"%s\": %m",
+                        GRAPH_SNAPSHOT_DIR)));
+    }
+
+    get_graph_snapshot_file_path(graph_oid, path);
+    snprintf(temp_path, MAXPGPATH, "%s.%d.tmp", path, MyProcPid);
+
+    fd = OpenTransientFile(temp_path, O_CREAT | O_TRUNC | O_WRONLY | PG_BINARY);
+    if (fd < 0)
+    {
+        ereport(ERROR,
+                (errcode_for_file_access(),
+                 errmsg("could not create file \"%s\": %m", temp_path)));
+    }
+
+    for (written = 0; written < size;)
+    {
+        ssize_t result = write(fd, buffer + written,
+                               Min(size - written, (Size) 1024 * 1024 * 1024));
+
+        if (result <= 0)
+        {
+            /* if write didn't set errno, assume the problem is no disk space */
+            if (errno == 0)
+            {
+                errno = ENOSPC;
+            }
+            ereport(ERROR,
+                    (errcode_for_file_access(),
+                     errmsg("could not write file \"%s\": %m", temp_path)));
+        }
+        written += result;
+    }
+
+    if (pg_fsync(fd) != 0)
+    {
+        ereport(ERROR,
+                (errcode_for_file_access(),
+                 errmsg("could not fsync file \"%s\": %m", temp_path)));
+    }
+    CloseTransientFile(fd);
+    pfree(buffer);
+
+    /* install it, unless the graph changed while it was being built */
+    LWLockAcquire(shared_registry->lock, LW_SHARED);
+    {
+        uint64 new_generation;
+        uint64 new_all_generation;
+        uint32 new_pending;
+
+        get_shared_graph_change_counts(graph_oid, &new_generation,
+                                       &new_all_generation, &new_pending);
+
+        if (new_generation == generation &&
+            new_all_generation == all_generation && new_pending == 0)
+        {
+            saved = (durable_rename(temp_path, path, LOG) == 0);
+        }
+    }
+    LWLockRelease(shared_registry->lock);
+
+    if (!saved)
+    {
+        unlink(temp_path);
+    }
+
+    return saved;
+}
+
+/*
+ * Helper function to map the saved snapshot file of the graph, if there is a
+ * usable one, and use its image in place. A file is
+ * usable if the graph hasn't changed since it was saved, and the active
+ * snapshot sees everything the saving snapshot saw. Returns false otherwise.
+ */
+static bool attach_GRAPH_global_snapshot_file(GRAPH_global_context *ggctx)
+{
+    graph_snapshot_header *header = NULL;
+    shared_graph_image *image = NULL;
+    Snapshot snapshot;
+    char path[MAXPGPATH];
+    struct stat st;
+    char *base = NULL;
+    Size image_offset;
+    bool usable = false;
+    int fd;
+
+    if (shared_registry == NULL || is_graph_changed_by_xact(ggctx->graph_oid))
+    {
+        return false;
+    }
+
+    snapshot = GetActiveSnapshot();
+    if (snapshot->snapshot_type != SNAPSHOT_MVCC)
+    {
+        return false;
+    }
+
+    get_graph_snapshot_file_path(ggctx->graph_oid, path);
+
+    fd = OpenTransientFile(path, O_RDONLY | PG_BINARY);
+    if (fd < 0)
+    {
+        if (errno != ENOENT)
+        {
+            ereport(LOG,
+                    (errcode_for_file_access(),
+                     errmsg("could not open file \"%s\": %m", path)));
+        }
+        return false;
+    }
+
+    image_offset = MAXALIGN(sizeof(graph_snapshot_header));
+    if (fstat(fd, &st) != 0 || (Size) st.st_size < image_offset)
+    {
+        CloseTransientFile(fd);
+        return false;
+    }
+
+    /* the mapping stays valid after the file is closed */
+    base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    CloseTransientFile(fd);
+    if (base == MAP_FAILED)
+    {
+        return false;
+    }
+
+    header = (graph_snapshot_header *)base;
+    image = (shared_graph_image *)(base + image_offset);
+
+    if (header->magic == GRAPH_SNAPSHOT_MAGIC &&
+        header->version == GRAPH_SNAPSHOT_VERSION &&
+        header->database_oid == MyDatabaseId &&
+        header->graph_oid == ggctx->graph_oid &&
+        header->image_size == (Size) st.st_size - image_offset &&
+        image->total_size == header->image_size &&
+        image->graph_oid == ggctx->graph_oid &&
+        TransactionIdPrecedesOrEquals(header->xmax, snapshot->xmin))
+    {
+        uint64 generation;
+        uint64 all_generation;
+        uint32 pending;
+
+        LWLockAcquire(shared_registry->lock, LW_SHARED);
+        get_shared_graph_change_counts(ggctx->graph_oid, &generation,
+                                       &all_generation, &pending);
+        usable = (header->epoch == shared_registry->epoch &&
+                  header->generation == generation &&
+                  header->all_generation == all_generation && pending == 0);
+        LWLockRelease(shared_registry->lock);
+    }
+
+    if (!usable)
+    {
+        munmap(base, st.st_size);
+        return false;
+    }
+
+    /* keep the mapping for the life of the GRAPH global context */
+    ggctx->mapped_file = base;
+    ggctx->mapped_file_size = st.st_size;
+
+    use_GRAPH_global_image(ggctx, image);
+
+    return true;
+}
+
+/* GRAPH global delta functions */
+
+/*
+ * Register the hooks and callbacks needed to keep the GRAPH global contexts
+ * up to date with this backend's own changes.
+ */
+void global_graph_hooks_init(void)
+{
+    prev_executor_start_hook = ExecutorStart_hook;
+    ExecutorStart_hook = global_graph_ExecutorStart;
+
+    RegisterXactCallback(global_graph_xact_callback, NULL);
+    RegisterSubXactCallback(global_graph_subxact_callback, NULL);
+}
+
+void global_graph_hooks_fini(void)
+{
+    ExecutorStart_hook = prev_executor_start_hook;
+
+    UnregisterXactCallback(global_graph_xact_callback, NULL);
+    UnregisterSubXactCallback(global_graph_subxact_callback, NULL);
+}
+
+/*
+ * Plain SQL DML against a label table isn't logged as deltas. So, the GRAPH
+ * global context of that graph needs to be rebuilt, instead of patched.
+ */
+static void global_graph_ExecutorStart(QueryDesc *queryDesc, int eflags)
+{
+    PlannedStmt *pstmt = queryDesc->plannedstmt;
+
+    /* changes are tracked for the snapshot files, even without contexts */
+    if ((global_graph_contexts != NULL || shared_registry != NULL) &&
+        !(eflags & EXEC_FLAG_EXPLAIN_ONLY))
+    {
+        ListCell *lc;
+
+        foreach (lc, pstmt->resultRelations)
+        {
+            RangeTblEntry *rte = rt_fetch(lfirst_int(lc), pstmt->rtable);
+            label_cache_data *label = NULL;
+
+            label = search_label_relation_cache(rte->relid);
+            if (label != NULL)
+            {
+                invalidate_GRAPH_global_contexts(label->graph);
+            }
+        }
+    }
+
+    if (prev_executor_start_hook)
+    {
+        prev_executor_start_hook(queryDesc, eflags);
+    }
+    else
+    {
+        standard_ExecutorStart(queryDesc, eflags);
+    }
+}
+
+/*
+ * On commit, remember the xids of this transaction. Their changes are already
+ * in, or logged against, the GRAPH global contexts. On abort, the contexts may
+ * hold, or have logged, changes that are being rolled back.
+ *
+ * The graphs changed by the transaction are also counted in the registry, for
+ * checking snapshot files.
+ */
+static void global_graph_xact_callback(XactEvent event, void *arg)
+{
+    GRAPH_global_context *curr_ggctx = NULL;
+
+    switch (event)
+    {
+    case XACT_EVENT_PRE_COMMIT:
+        count_GRAPH_global_changes_pending();
+        break;
+    case XACT_EVENT_COMMIT:
+    case XACT_EVENT_PARALLEL_COMMIT:
+        count_GRAPH_global_changes_done(true);
+        break;
+    case XACT_EVENT_ABORT:
+    case XACT_EVENT_PARALLEL_ABORT:
+        count_GRAPH_global_changes_done(false);
+        break;
+    case XACT_EVENT_PREPARE:
+        /*
+         * A prepared transaction is committed elsewhere, and untracked. So, its
+         * graphs are left pending until the next restart.
+         */
+        count_GRAPH_global_changes_pending();
+        xact_changes_pending = false;
+        count_GRAPH_global_changes_done(false);
+        break;
+    default:
+        break;
+    }
+
+    if (global_graph_contexts == NULL)
+    {
+        return;
+    }
+
+    switch (event)
+    {
+    case XACT_EVENT_PRE_COMMIT:
+    {
+        TransactionId top_xid = GetTopTransactionIdIfAny();
+        TransactionId *children = NULL;
+        int nchildren = 0;
+
+        if (!TransactionIdIsValid(top_xid))
+        {
+            return;
+        }
+
+        nchildren = xactGetCommittedChildren(&children);
+
+        for (curr_ggctx = global_graph_contexts; curr_ggctx != NULL;
+             curr_ggctx = curr_ggctx->next)
+        {
+            int i;
+
+            if (curr_ggctx->deltas_invalid)
+            {
+                continue;
+            }
+
+            if (curr_ggctx->num_own_xids + nchildren + 1 >
+                GRAPH_DELTA_MAX_OWN_XIDS)
+            {
+                curr_ggctx->deltas_invalid = true;
+                continue;
+            }
+
+            if (curr_ggctx->own_xids == NULL)
+            {
+                curr_ggctx->own_xids = MemoryContextAlloc(
+                    curr_ggctx->memory_context,
+                    sizeof(TransactionId) * GRAPH_DELTA_MAX_OWN_XIDS);
+            }
+
+            curr_ggctx->own_xids[curr_ggctx->num_own_xids++] = top_xid;
+            for (i = 0; i < nchildren; i++)
+            {
+                curr_ggctx->own_xids[curr_ggctx->num_own_xids++] =
+                    children[i];
+            }
+        }
+        break;
+    }
+    case XACT_EVENT_ABORT:
+    case XACT_EVENT_PARALLEL_ABORT:
+    case XACT_EVENT_PREPARE:
+        if (TransactionIdIsValid(GetTopTransactionIdIfAny()))
+        {
+            discard_GRAPH_global_deltas(InvalidOid);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/* a rolled back subtransaction may have logged changes, or be in a context */
+static void global_graph_subxact_callback(SubXactEvent event,
+                                          SubTransactionId mySubid,
+                                          SubTransactionId parentSubid,
+                                          void *arg)
+{
+    if (event == SUBXACT_EVENT_ABORT_SUB &&
+        TransactionIdIsValid(GetCurrentTransactionIdIfAny()))
+    {
+        discard_GRAPH_global_deltas(InvalidOid);
+    }
+}
+
+/*
+ * Mark the GRAPH global context of the specified graph, or of all graphs if
+ * graph_oid is InvalidOid, as not patchable, as the graph is being changed
+ * without logged deltas. It will be rebuilt the next time the active snapshot
+ * changes.
+ */
+void invalidate_GRAPH_global_contexts(Oid graph_oid)
+{
+    note_GRAPH_global_change(graph_oid);
+    discard_GRAPH_global_deltas(graph_oid);
+}
+
+/*
+ * Helper function to discard the logged deltas of the specified graph, or of
+ * all graphs if graph_oid is InvalidOid, and stop logging them.
+ */
+static void discard_GRAPH_global_deltas(Oid graph_oid)
+{
+    GRAPH_global_context *curr_ggctx = NULL;
+
+    for (curr_ggctx = global_graph_contexts; curr_ggctx != NULL;
+         curr_ggctx = curr_ggctx->next)
+    {
+        if (graph_oid == InvalidOid || curr_ggctx->graph_oid == graph_oid)
+        {
+            curr_ggctx->deltas_invalid = true;
+            free_GRAPH_global_deltas(curr_ggctx);
+        }
+    }
+}
+
+/* helper function to append a delta to the graph's GRAPH global context */
+static void log_GRAPH_global_delta(Oid graph_oid, GRAPH_delta *delta)
+{
+    GRAPH_global_context *ggctx = NULL;
+    GRAPH_delta *new_delta = NULL;
+    MemoryContext oldctx = NULL;
+
+    ggctx = find_GRAPH_global_context(graph_oid);
+
+    /* nothing to maintain */
+    if (ggctx == NULL || ggctx->deltas_invalid)
+    {
+        return;
+    }
+
+    oldctx = MemoryContextSwitchTo(TopMemoryContext);
+
+    new_delta = palloc(sizeof(GRAPH_delta));
+    memcpy(new_delta, delta, sizeof(GRAPH_delta));
+
+    /* the properties must outlive the executor's memory */
+    if (delta->properties != (Datum)0)
+    {
+        new_delta->properties =
+            PointerGetDatum(PG_DETOAST_DATUM_COPY(delta->properties));
+    }
+
+    new_delta->lxid = MyProc->lxid;
+    new_delta->cid = GetCurrentCommandId(false);
+
+    ggctx->deltas = lappend(ggctx->deltas, new_delta);
+
+    MemoryContextSwitchTo(oldctx);
+}
+
+/* log an inserted vertex or edge tuple of the label table */
+void log_GRAPH_global_insert(Relation label_relation, TupleTableSlot *slot)
+{
+    label_cache_data *label = NULL;
+    GRAPH_delta delta;
+    bool isnull = false;
+
+    label = search_label_relation_cache(RelationGetRelid(label_relation));
+    if (label == NULL)
+    {
+        return;
+    }
+
+    /*
+     * Other backends' contexts, and the snapshot files, rely on every write
+     * being counted. So, it is, even when this backend has no contexts.
+     */
+    note_GRAPH_global_change(label->graph);
+
+    if (global_graph_contexts == NULL)
+    {
+        return;
+    }
+
+    MemSet(&delta, 0, sizeof(GRAPH_delta));
+    delta.label_table_oid = RelationGetRelid(label_relation);
+    delta.id = DatumGetInt64(slot_getattr(slot, 1, &isnull));
+
+    if (label->kind == LABEL_KIND_VERTEX)
+    {
+        delta.type = GRAPH_DELTA_INSERT_VERTEX;
+        delta.properties = slot_getattr(slot, 2, &isnull);
+    }
+    else
+    {
+        delta.type = GRAPH_DELTA_INSERT_EDGE;
+        delta.start_vertex_id = DatumGetInt64(slot_getattr(slot, 2, &isnull));
+        delta.end_vertex_id = DatumGetInt64(slot_getattr(slot, 3, &isnull));
+        delta.properties = slot_getattr(slot, 4, &isnull);
+    }
+
+    log_GRAPH_global_delta(label->graph, &delta);
+}
+
+/* log the new properties of an updated vertex or edge tuple */
+void log_GRAPH_global_update(Relation label_relation, TupleTableSlot *slot)
+{
+    label_cache_data *label = NULL;
+    GRAPH_delta delta;
+    bool isnull = false;
+
+    label = search_label_relation_cache(RelationGetRelid(label_relation));
+    if (label == NULL)
+    {
+        return;
+    }
+
+    note_GRAPH_global_change(label->graph);
+
+    if (global_graph_contexts == NULL)
+    {
+        return;
+    }
+
+    MemSet(&delta, 0, sizeof(GRAPH_delta));
+    delta.type = GRAPH_DELTA_UPDATE;
+    delta.id = DatumGetInt64(slot_getattr(slot, 1, &isnull));
+    delta.properties = slot_getattr(slot,
+                                    (label->kind == LABEL_KIND_VERTEX) ? 2 : 4,
+                                    &isnull);
 
-    /* get the first context, if any */
-    curr_ggctx = global_graph_contexts;
+    log_GRAPH_global_delta(label->graph, &delta);
+}
 
-    /* free all GRAPH global contexts */
-    while (curr_ggctx != NULL)
-    {
-        GRAPH_global_context *next_ggctx = curr_ggctx->next;
+/* log a deleted vertex or edge tuple of the label table */
+void log_GRAPH_global_delete(Relation label_relation, HeapTuple tuple)
+{
+    label_cache_data *label = NULL;
+    GRAPH_delta delta;
+    bool isnull = false;
 
-        /* free the current graph context */
-        free_specific_GRAPH_global_context(curr_ggctx);
+    label = search_label_relation_cache(RelationGetRelid(label_relation));
+    if (label == NULL)
+    {
+        return;
+    }
 
-        /* advance to the next context */
-        curr_ggctx = next_ggctx;
+    note_GRAPH_global_change(label->graph);
 
-        retval = true;
+    if (global_graph_contexts == NULL)
+    {
+        return;
     }
 
-    /* clear the global variable */
-    global_graph_contexts = NULL;
+    MemSet(&delta, 0, sizeof(GRAPH_delta));
+    delta.type = GRAPH_DELTA_DELETE;
+    delta.id = DatumGetInt64(heap_getattr(tuple, 1,
+                                          RelationGetDescr(label_relation),
+                                          &isnull));
 
-    return retval;
+    log_GRAPH_global_delta(label->graph, &delta);
 }
 
 /*
- * Helper function to delete a specific global graph context used by the
- * process.
+ * Helper function to bring a GRAPH global context up to date with the active
+ * snapshot by applying its logged deltas. This is only possible if every change
+ * the snapshot can see, that the context can't, was made by this backend and
+ * logged. It returns false if the context needs to be rebuilt.
  */
-static bool delete_specific_GRAPH_global_contexts(char *graph_name)
+static bool apply_GRAPH_global_deltas(GRAPH_global_context *ggctx)
 {
-    GRAPH_global_context *prev_ggctx = NULL;
-    GRAPH_global_context *curr_ggctx = NULL;
-    Oid graph_oid = InvalidOid;
+    Snapshot snapshot = GetActiveSnapshot();
+    ListCell *lc;
 
-    if (graph_name == NULL)
+    if (ggctx->deltas_invalid)
     {
         return false;
     }
 
-    /* get the graph oid */
-    graph_oid = get_graph_oid(graph_name);
-
-    /* get the first context, if any */
-    curr_ggctx = global_graph_contexts;
+    if (!is_snapshot_change_own(ggctx, snapshot))
+    {
+        return false;
+    }
 
-    /* find the specified GRAPH global context */
-    while (curr_ggctx != NULL)
+    /* every delta must be visible to the snapshot */
+    foreach (lc, ggctx->deltas)
     {
-        GRAPH_global_context *next_ggctx = curr_ggctx->next;
+        GRAPH_delta *delta = lfirst(lc);
 
-        if (curr_ggctx->graph_oid == graph_oid)
+        if (delta->lxid == MyProc->lxid && delta->cid >= snapshot->curcid)
         {
-            /*
-             * If prev_ggctx is NULL then we are freeing the top of the
-             * contexts. So, we need to point the global variable to the
-             * new (next) top context, if there is one.
-             */
-            if (prev_ggctx == NULL)
-            {
-                global_graph_contexts = next_ggctx;
-            }
-            else
-            {
-                prev_ggctx->next = curr_ggctx->next;
-            }
+            return false;
+        }
+    }
 
-            /* free the current graph context */
-            free_specific_GRAPH_global_context(curr_ggctx);
+    /* the entries of an image are read only, so they are hashed to patch */
+    if (ggctx->image != NULL && ggctx->deltas != NIL)
+    {
+        hash_GRAPH_global_image(ggctx);
+    }
 
-            /* we found and freed it, return true */
-            return true;
+    /* a failure part way through leaves the context to be rebuilt */
+    foreach (lc, ggctx->deltas)
+    {
+        GRAPH_delta *delta = lfirst(lc);
+
+        if (!apply_GRAPH_global_delta(ggctx, delta))
+        {
+            return false;
         }
 
-        /* advance to the next one */
-        curr_ggctx = next_ggctx;
+        /* the context now references the properties */
+        if (delta->properties != (Datum)0)
+        {
+            ggctx->delta_properties = lappend(ggctx->delta_properties,
+                                              DatumGetPointer(
+                                                  delta->properties));
+            delta->properties = (Datum)0;
+        }
     }
 
-    /* we didn't find it, return false */
-    return false;
-}
+    free_GRAPH_global_deltas(ggctx);
+    ggctx->num_own_xids = 0;
+    set_GRAPH_global_snapshot(ggctx, snapshot);
+    ggctx->version++;
 
-/*
- * Helper function to retrieve a vertex_entry from the graph's vertex hash
- * table. If there isn't one, it returns a NULL. The latter is necessary for
- * checking if the vsid and veid entries exist.
- */
-vertex_entry *get_vertex_entry(GRAPH_global_context *ggctx, graphid vertex_id)
-{
-    vertex_entry *ve = NULL;
-    bool found = false;
+    /* it may now hold uncommitted changes, which the counts can't vouch for */
+    ggctx->changes_counted = false;
 
-    /* retrieve the current vertex entry */
-    ve = (vertex_entry *)hash_search(ggctx->vertex_hashtable,
-                                     (void *)&vertex_id, HASH_FIND, &found);
-    return ve;
+    return true;
 }
 
-/* helper function to retrieve an edge_entry from the graph's edge hash table */
-edge_entry *get_edge_entry(GRAPH_global_context *ggctx, graphid edge_id)
+/* helper function to apply one delta to a GRAPH global context */
+static bool apply_GRAPH_global_delta(GRAPH_global_context *ggctx,
+                                     GRAPH_delta *delta)
 {
+    vertex_entry *ve = NULL;
     edge_entry *ee = NULL;
-    bool found = false;
 
-    /* retrieve the current edge entry */
-    ee = (edge_entry *)hash_search(ggctx->edge_hashtable, (void *)&edge_id,
-                                   HASH_FIND, &found);
-    /* it should be found, otherwise we have problems */
-    Assert(found);
+    switch (delta->type)
+    {
+    case GRAPH_DELTA_INSERT_VERTEX:
+        return insert_vertex_entry(ggctx, delta->id, delta->label_table_oid,
+                                   delta->properties, NULL);
+
+    case GRAPH_DELTA_INSERT_EDGE:
+        /* both vertices must already be there */
+        if (get_vertex_entry(ggctx, delta->start_vertex_id) == NULL ||
+            get_vertex_entry(ggctx, delta->end_vertex_id) == NULL)
+        {
+            return false;
+        }
+        if (!insert_edge(ggctx, delta->id, delta->properties,
+                         delta->start_vertex_id, delta->end_vertex_id,
+                         delta->label_table_oid, NULL))
+        {
+            return false;
+        }
+        return insert_vertex_edge(ggctx, delta->start_vertex_id,
+                                  delta->end_vertex_id, delta->id);
 
-    return ee;
+    case GRAPH_DELTA_UPDATE:
+        ve = get_vertex_entry(ggctx, delta->id);
+        if (ve != NULL)
+        {
+            ve->vertex_properties = delta->properties;
+            return true;
+        }
+        ee = (edge_entry *)hash_search(ggctx->edge_hashtable,
+                                       (void *)&delta->id, HASH_FIND, NULL);
+        if (ee != NULL)
+        {
+            ee->edge_properties = delta->properties;
+            return true;
+        }
+        return false;
+
+    case GRAPH_DELTA_DELETE:
+        return delete_GRAPH_global_entity(ggctx, delta->id);
+
+    default:
+        return false;
+    }
 }
 
 /*
- * Helper function to find the GRAPH_global_context used by the specified
- * graph_oid. If not found, it returns NULL.
+ * Helper function to remove a vertex or edge from a GRAPH global context. A
+ * vertex can only be removed once all of its edges have been.
  */
-GRAPH_global_context *find_GRAPH_global_context(Oid graph_oid)
+static bool delete_GRAPH_global_entity(GRAPH_global_context *ggctx, graphid id)
 {
-    GRAPH_global_context *ggctx = NULL;
+    vertex_entry *ve = NULL;
+    edge_entry *ee = NULL;
 
-    /* get the root */
-    ggctx = global_graph_contexts;
+    ve = get_vertex_entry(ggctx, id);
+    if (ve != NULL)
+    {
+        if (get_vertex_entry_degree(ggctx, ve, VERTEX_EDGES_IN) > 0 ||
+            get_vertex_entry_degree(ggctx, ve, VERTEX_EDGES_OUT) > 0 ||
+            get_vertex_entry_degree(ggctx, ve, VERTEX_EDGES_SELF) > 0)
+        {
+            return false;
+        }
 
-    while(ggctx != NULL)
+        free_ListGraphId(ve->edges_in);
+        free_ListGraphId(ve->edges_out);
+        free_ListGraphId(ve->edges_self);
+
+        /* its dense index isn't reused */
+        ggctx->vertex_index_entries[ve->vertex_index] = NULL;
+        hash_search(ggctx->vertex_hashtable, (void *)&id, HASH_REMOVE, NULL);
+        ggctx->num_loaded_vertices--;
+
+        return true;
+    }
+
+    ee = (edge_entry *)hash_search(ggctx->edge_hashtable, (void *)&id,
+                                   HASH_FIND, NULL);
+    if (ee == NULL)
     {
-        /* if we found it return it */
-        if (ggctx->graph_oid == graph_oid)
+        return false;
+    }
+
+    /*
+     * Remove the edge from its vertices' edge lists. The CSR arrays of an
+     * image, shared or mapped from a snapshot file, are read only.
+     */
+    ve = get_vertex_entry(ggctx, ee->start_vertex_id);
+    if (ve == NULL)
+    {
+        return false;
+    }
+    if (ee->start_vertex_id == ee->end_vertex_id)
+    {
+        if (!remove_graphid(ve->edges_self, id) &&
+            (ggctx->csr_in_image ||
+             !delete_csr_edge(ggctx, ve, VERTEX_EDGES_SELF, id)))
         {
-            return ggctx;
+            return false;
+        }
+    }
+    else
+    {
+        if (!remove_graphid(ve->edges_out, id) &&
+            (ggctx->csr_in_image ||
+             !delete_csr_edge(ggctx, ve, VERTEX_EDGES_OUT, id)))
+        {
+            return false;
         }
 
-        /* advance to the next context */
-        ggctx = ggctx->next;
+        ve = get_vertex_entry(ggctx, ee->end_vertex_id);
+        if (ve == NULL ||
+            (!remove_graphid(ve->edges_in, id) &&
+             (ggctx->csr_in_image ||
+              !delete_csr_edge(ggctx, ve, VERTEX_EDGES_IN, id))))
+        {
+            return false;
+        }
     }
 
-    /* we did not find it so return NULL */
-    return NULL;
-}
+    hash_search(ggctx->edge_hashtable, (void *)&id, HASH_REMOVE, NULL);
+    ggctx->num_loaded_edges--;
 
-/* graph vertices accessor */
-ListGraphId *get_graph_vertices(GRAPH_global_context *ggctx)
-{
-    return ggctx->vertices;
+    return true;
 }
 
-/* vertex_entry accessor functions */
-graphid get_vertex_entry_id(vertex_entry *ve)
+/*
+ * Helper function to determine if every transaction that the snapshot sees as
+ * committed, but the GRAPH global context's snapshot didn't, belongs to this
+ * backend. Transactions that are too far apart are not checked.
+ */
+static bool is_snapshot_change_own(GRAPH_global_context *ggctx,
+                                   Snapshot snapshot)
 {
-    return ve->vertex_id;
-}
+    TransactionId *xip = NULL;
+    TransactionId xid;
+    bool result = true;
+    uint32 i;
+
+    /* an older snapshot can't be reached by applying deltas */
+    if (TransactionIdPrecedes(snapshot->xmax, ggctx->xmax) ||
+        snapshot->xmax - ggctx->xmax > GRAPH_DELTA_MAX_XID_RANGE)
+    {
+        return false;
+    }
 
-ListGraphId *get_vertex_entry_edges_in(vertex_entry *ve)
-{
-    return ve->edges_in;
-}
+    xip = palloc(sizeof(TransactionId) * Max(snapshot->xcnt, 1));
+    memcpy(xip, snapshot->xip, sizeof(TransactionId) * snapshot->xcnt);
+    qsort(xip, snapshot->xcnt, sizeof(TransactionId), xid_cmp);
 
-ListGraphId *get_vertex_entry_edges_out(vertex_entry *ve)
-{
-    return ve->edges_out;
-}
+    /* transactions that were in progress, and have since committed */
+    for (i = 0; i < ggctx->xcnt && result; i++)
+    {
+        xid = ggctx->xip[i];
 
-ListGraphId *get_vertex_entry_edges_self(vertex_entry *ve)
-{
-    return ve->edges_self;
-}
+        if (bsearch(&xid, xip, snapshot->xcnt, sizeof(TransactionId),
+                    xid_cmp) == NULL &&
+            !is_own_xid(ggctx, xid) &&
+            TransactionIdDidCommit(xid))
+        {
+            result = false;
+        }
+    }
 
+    /* transactions that started after the context's snapshot, and committed */
+    for (xid = ggctx->xmax;
+         result && TransactionIdPrecedes(xid, snapshot->xmax);
+         TransactionIdAdvance(xid))
+    {
+        if (bsearch(&xid, xip, snapshot->xcnt, sizeof(TransactionId),
+                    xid_cmp) == NULL &&
+            !is_own_xid(ggctx, xid) &&
+            TransactionIdDidCommit(xid))
+        {
+            result = false;
+        }
+    }
 
-Oid get_vertex_entry_label_table_oid(vertex_entry *ve)
-{
-    return ve->vertex_label_table_oid;
-}
+    pfree(xip);
 
-Datum get_vertex_entry_properties(vertex_entry *ve)
-{
-    return ve->vertex_properties;
+    return result;
 }
 
-/* edge_entry accessor functions */
-graphid get_edge_entry_id(edge_entry *ee)
+/* helper function to check for an xid of our own committed transactions */
+static bool is_own_xid(GRAPH_global_context *ggctx, TransactionId xid)
 {
-    return ee->edge_id;
-}
+    int i;
 
-Oid get_edge_entry_label_table_oid(edge_entry *ee)
-{
-    return ee->edge_label_table_oid;
+    for (i = 0; i < ggctx->num_own_xids; i++)
+    {
+        if (TransactionIdEquals(ggctx->own_xids[i], xid))
+        {
+            return true;
+        }
+    }
+
+    return false;
 }
 
-Datum get_edge_entry_properties(edge_entry *ee)
+/* helper function to record the snapshot a GRAPH global context reflects */
+static void set_GRAPH_global_snapshot(GRAPH_global_context *ggctx,
+                                      Snapshot snapshot)
 {
-    return ee->edge_properties;
+    ggctx->xmin = snapshot->xmin;
+    ggctx->xmax = snapshot->xmax;
+    ggctx->curcid = snapshot->curcid;
+
+    if (ggctx->xip != NULL)
+    {
+        pfree(ggctx->xip);
+    }
+
+    ggctx->xcnt = snapshot->xcnt;
+    ggctx->xip = MemoryContextAlloc(ggctx->memory_context,
+                                    sizeof(TransactionId) *
+                                    Max(snapshot->xcnt, 1));
+    memcpy(ggctx->xip, snapshot->xip, sizeof(TransactionId) * snapshot->xcnt);
+    qsort(ggctx->xip, ggctx->xcnt, sizeof(TransactionId), xid_cmp);
 }
 
-graphid get_edge_entry_start_vertex_id(edge_entry *ee)
+/* helper function to free the pending deltas of a GRAPH global context */
+static void free_GRAPH_global_deltas(GRAPH_global_context *ggctx)
 {
-    return ee->start_vertex_id;
+    ListCell *lc;
+
+    foreach (lc, ggctx->deltas)
+    {
+        GRAPH_delta *delta = lfirst(lc);
+
+        if (delta->properties != (Datum)0)
+        {
+            pfree(DatumGetPointer(delta->properties));
+        }
+    }
+
+    list_free_deep(ggctx->deltas);
+    ggctx->deltas = NIL;
 }
 
-graphid get_edge_entry_end_vertex_id(edge_entry *ee)
+/*
+ * Return the version of the GRAPH global context. It changes whenever deltas
+ * are applied, so anything derived from the context should be rebuilt.
+ */
+int64 get_ggctx_version(GRAPH_global_context *ggctx)
 {
-    return ee->end_vertex_id;
+    return ggctx->version;
 }
 
 /* PostgreSQL SQL facing functions */
@@ -1019,6 +4578,7 @@ Datum age_delete_global_graphs(PG_FUNCTION_ARGS)
     if (agtv_temp == NULL || agtv_temp->type == AGTV_NULL)
     {
         success = delete_GRAPH_global_contexts();
+        success |= remove_shared_GRAPH_global_images(InvalidOid);
     }
     else if (agtv_temp->type == AGTV_STRING)
     {
@@ -1026,6 +4586,8 @@ Datum age_delete_global_graphs(PG_FUNCTION_ARGS)
 
         graph_name = agtv_temp->val.string.val;
         success = delete_specific_GRAPH_global_contexts(graph_name);
+        success |= remove_shared_GRAPH_global_images(
+                       get_graph_oid(graph_name));
     }
     else
     {
@@ -1037,6 +4599,96 @@ Datum age_delete_global_graphs(PG_FUNCTION_ARGS)
     PG_RETURN_BOOL(success);
 }
 
+/*
+ * Reports, per GRAPH global context of this backend, the memory it uses, when
+ * and how quickly it was loaded, and how many times it was reused.
+ */
+PG_FUNCTION_INFO_V1(age_global_graph_stats);
+
+Datum age_global_graph_stats(PG_FUNCTION_ARGS)
+{
+    ReturnSetInfo *rsi = (ReturnSetInfo *)fcinfo->resultinfo;
+    GRAPH_global_context *ggctx = NULL;
+    Tuplestorestate *tuple_store = NULL;
+    TupleDesc tupdesc;
+    MemoryContext oldctx = NULL;
+
+    if (rsi == NULL || !IsA(rsi, ReturnSetInfo) ||
+        (rsi->allowedModes & SFRM_Materialize) == 0)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                 errmsg("global_graph_stats: materialize mode required, but it is not allowed in this context")));
+    }
+
+    if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+    {
+        elog(ERROR, "return type must be a row type");
+    }
+
+    oldctx = MemoryContextSwitchTo(rsi->econtext->ecxt_per_query_memory);
+
+    tupdesc = CreateTupleDescCopy(tupdesc);
+    tuple_store =
+        tuplestore_begin_heap(rsi->allowedModes & SFRM_Materialize_Random,
+                              false, work_mem);
+
+    MemoryContextSwitchTo(oldctx);
+
+    for (ggctx = global_graph_contexts; ggctx != NULL; ggctx = ggctx->next)
+    {
+        Datum values[GLOBAL_GRAPH_STATS_COLUMNS];
+        bool nulls[GLOBAL_GRAPH_STATS_COLUMNS];
+
+        MemSet(nulls, 0, sizeof(nulls));
+
+        values[0] = CStringGetTextDatum(ggctx->graph_name);
+        values[1] = ObjectIdGetDatum(ggctx->graph_oid);
+        values[2] = Int64GetDatum(
+            MemoryContextMemAllocated(ggctx->memory_context, true));
+        values[3] = Int64GetDatum(ggctx->num_loaded_vertices);
+        values[4] = Int64GetDatum(ggctx->num_loaded_edges);
+        values[5] = TimestampTzGetDatum(ggctx->loaded_at);
+        values[6] = Float8GetDatum(ggctx->load_time);
+        values[7] = Int64GetDatum(ggctx->num_hits);
+
+        tuplestore_putvalues(tuple_store, tupdesc, values, nulls);
+    }
+
+    rsi->returnMode = SFRM_Materialize;
+    rsi->setResult = tuple_store;
+    rsi->setDesc = tupdesc;
+
+    return (Datum)0;
+}
+
+/* PG wrapper function for save_GRAPH_global_snapshot_file */
+PG_FUNCTION_INFO_V1(age_save_graph_snapshot);
+
+Datum age_save_graph_snapshot(PG_FUNCTION_ARGS)
+{
+    Name graph_name;
+    char *graph_name_str;
+    Oid graph_oid;
+
+    if (PG_ARGISNULL(0))
+    {
+        ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                        errmsg("graph name must not be NULL")));
+    }
+    graph_name = PG_GETARG_NAME(0);
+    graph_name_str = NameStr(*graph_name);
+
+    graph_oid = get_graph_oid(graph_name_str);
+    if (!OidIsValid(graph_oid))
+    {
+        ereport(ERROR, (errcode(ERRCODE_UNDEFINED_SCHEMA),
+                        errmsg("graph \"%s\" does not exist", graph_name_str)));
+    }
+
+    PG_RETURN_BOOL(save_GRAPH_global_snapshot_file(graph_name_str, graph_oid));
+}
+
 /* PG wrapper function for age_vertex_degree */
 PG_FUNCTION_INFO_V1(age_vertex_stats);
 
@@ -1044,7 +4696,6 @@ Datum age_vertex_stats(PG_FUNCTION_ARGS)
 {
     GRAPH_global_context *ggctx = NULL;
     vertex_entry *ve = NULL;
-    ListGraphId *edges = NULL;
     agtype_value *agtv_vertex = NULL;
     agtype_value *agtv_temp = NULL;
     agtype_value agtv_integer;
@@ -1124,24 +4775,21 @@ Datum age_vertex_stats(PG_FUNCTION_ARGS)
     agtv_temp->val.int_value = 0;
 
     /* get and store the self_loops */
-    edges = get_vertex_entry_edges_self(ve);
-    self_loops = (edges != NULL) ? get_list_size(edges) : 0;
+    self_loops = get_vertex_entry_degree(ggctx, ve, VERTEX_EDGES_SELF);
     agtv_temp->val.int_value = self_loops;
     result.res = push_agtype_value(&result.parse_state, WAGT_KEY,
                                    string_to_agtype_value("self_loops"));
     result.res = push_agtype_value(&result.parse_state, WAGT_VALUE, agtv_temp);
 
     /* get and store the in_degree */
-    edges = get_vertex_entry_edges_in(ve);
-    degree = (edges != NULL) ? get_list_size(edges) : 0;
+    degree = get_vertex_entry_degree(ggctx, ve, VERTEX_EDGES_IN);
     agtv_temp->val.int_value = degree + self_loops;
     result.res = push_agtype_value(&result.parse_state, WAGT_KEY,
                                    string_to_agtype_value("in_degree"));
     result.res = push_agtype_value(&result.parse_state, WAGT_VALUE, agtv_temp);
 
     /* get and store the out_degree */
-    edges = get_vertex_entry_edges_out(ve);
-    degree = (edges != NULL) ? get_list_size(edges) : 0;
+    degree = get_vertex_entry_degree(ggctx, ve, VERTEX_EDGES_OUT);
     agtv_temp->val.int_value = degree + self_loops;
     result.res = push_agtype_value(&result.parse_state, WAGT_KEY,
                                    string_to_agtype_value("out_degree"));
@@ -19,10 +19,18 @@
 
 #include "postgres.h"
 
+#include "commands/tablespace.h"
+#include "storage/buffile.h"
+
 #include "utils/graphid.h"
 #include "utils/age_graphid_ds.h"
 
 /* defines */
+#define GRAPHID_NODE_CHUNK_MIN_SIZE 4
+#define GRAPHID_NODE_CHUNK_MAX_SIZE 1024
+/* the number of graphids in a block of a stack's spill file */
+#define GRAPHID_STACK_SPILL_BLOCK_SIZE ((int64)(BLCKSZ / sizeof(graphid)))
+
 /*
  * A simple linked list node for graphid lists (int64). PG's implementation
  * has too much overhead for this type of list as it only directly supports
@@ -34,17 +42,245 @@ typedef struct GraphIdNode
     struct GraphIdNode *next;
 } GraphIdNode;
 
+/*
+ * A chunk of GraphIdNodes. The nodes of a list are handed out from its chunks,
+ * rather than allocated one at a time. Each chunk is twice the size of the one
+ * before it, up to GRAPHID_NODE_CHUNK_MAX_SIZE nodes.
+ */
+typedef struct GraphIdNodeChunk
+{
+    struct GraphIdNodeChunk *next; /* the chunk allocated before this one */
+    int64 num_nodes;               /* the number of nodes in this chunk */
+    GraphIdNode nodes[FLEXIBLE_ARRAY_MEMBER];
+} GraphIdNodeChunk;
+
 /* a container for a linked list of GraphIdNodes */
 typedef struct ListGraphId
 {
     GraphIdNode *head;
     GraphIdNode *tail;
     int64 size;
+    GraphIdNodeChunk *chunks;      /* its chunks, the newest first */
+    int64 num_unused;              /* nodes not yet handed out of the newest */
+    GraphIdNode *free_nodes;       /* nodes that were popped or removed */
+    /* a stack spills beyond this many nodes in memory, 0 if it never does */
+    int64 max_nodes_in_memory;
+    BufFile *spill_file;           /* the spilled bottom of the stack */
+    int64 num_spilled_blocks;      /* the blocks of it in the spill file */
 } ListGraphId;
 
+/*
+ * The bytes that the graphid stacks of this backend have spilled, counted as
+ * they are written. It is never reset, so callers measure it by differences.
+ */
+static int64 graphid_stacks_spilled_bytes = 0;
+
 /* declarations */
+static GraphIdNode *alloc_GraphIdNode(ListGraphId *container);
+static void release_GraphIdNode(ListGraphId *container, GraphIdNode *node);
+static void free_GraphIdNode_chunks(ListGraphId *container);
+static void link_graphid_stack_head(ListGraphId *stack, graphid id);
+static void spill_graphid_stack(ListGraphId *stack);
+static void unspill_graphid_stack(ListGraphId *stack);
 
 /* definitions */
+/*
+ * Helper function to get a new GraphIdNode for a container. A node that was
+ * released is reused first, then the next unused node of the newest chunk. A
+ * new chunk is only allocated when both run out.
+ */
+static GraphIdNode *alloc_GraphIdNode(ListGraphId *container)
+{
+    GraphIdNodeChunk *chunk = NULL;
+    GraphIdNode *node = NULL;
+
+    /* reuse a released node, if there is one */
+    if (container->free_nodes != NULL)
+    {
+        node = container->free_nodes;
+        container->free_nodes = node->next;
+
+        return node;
+    }
+
+    /* add in a new chunk, if the newest is used up */
+    if (container->num_unused == 0)
+    {
+        int64 num_nodes = GRAPHID_NODE_CHUNK_MIN_SIZE;
+
+        if (container->chunks != NULL)
+        {
+            num_nodes = Min(container->chunks->num_nodes * 2,
+                            GRAPHID_NODE_CHUNK_MAX_SIZE);
+        }
+
+        chunk = palloc(offsetof(GraphIdNodeChunk, nodes) +
+                       sizeof(GraphIdNode) * num_nodes);
+        chunk->next = container->chunks;
+        chunk->num_nodes = num_nodes;
+
+        container->chunks = chunk;
+        container->num_unused = num_nodes;
+    }
+
+    /* hand out the next node of the newest chunk */
+    chunk = container->chunks;
+    node = &chunk->nodes[chunk->num_nodes - container->num_unused];
+    container->num_unused--;
+
+    return node;
+}
+
+/* helper function to release a GraphIdNode, so its container can reuse it */
+static void release_GraphIdNode(ListGraphId *container, GraphIdNode *node)
+{
+    node->next = container->free_nodes;
+    container->free_nodes = node;
+}
+
+/*
+ * Helper function to free all of the chunks of a container. This frees all of
+ * its nodes at once, so the container must be reset afterwards.
+ */
+static void free_GraphIdNode_chunks(ListGraphId *container)
+{
+    GraphIdNodeChunk *chunk = container->chunks;
+
+    while (chunk != NULL)
+    {
+        GraphIdNodeChunk *next = chunk->next;
+
+        pfree(chunk);
+        chunk = next;
+    }
+
+    container->chunks = NULL;
+    container->num_unused = 0;
+    container->free_nodes = NULL;
+}
+
+/* helper function to link a new node, for the graphid, on top of a stack */
+static void link_graphid_stack_head(ListGraphId *stack, graphid id)
+{
+    GraphIdNode *new_node = NULL;
+
+    /* create the new element */
+    new_node = alloc_GraphIdNode(stack);
+    new_node->id = id;
+
+    /* insert (push) the new element on the top */
+    new_node->next = stack->head;
+    stack->head = new_node;
+}
+
+/*
+ * Helper function to spill the bottom half of the nodes that a stack has in
+ * memory, in whole blocks, to its spill file. The file holds the spilled
+ * blocks from the bottom of the stack up, so these are written after the
+ * blocks already in it. The nodes are released, to be reused by later pushes.
+ */
+static void spill_graphid_stack(ListGraphId *stack)
+{
+    GraphIdNode *last_kept = NULL;
+    GraphIdNode *node = NULL;
+    graphid *buffer = NULL;
+    int64 num_in_memory;
+    int64 num_blocks;
+    int64 num_kept;
+    int64 i;
+
+    num_in_memory = stack->size -
+                    stack->num_spilled_blocks * GRAPHID_STACK_SPILL_BLOCK_SIZE;
+    num_blocks = (num_in_memory / 2) / GRAPHID_STACK_SPILL_BLOCK_SIZE;
+    num_kept = num_in_memory - num_blocks * GRAPHID_STACK_SPILL_BLOCK_SIZE;
+
+    if (num_blocks == 0)
+    {
+        return;
+    }
+
+    /* find the last node kept in memory and unlink the nodes below it */
+    last_kept = stack->head;
+    for (i = 1; i < num_kept; i++)
+    {
+        last_kept = last_kept->next;
+    }
+    node = last_kept->next;
+    last_kept->next = NULL;
+
+    /* copy them into the buffer from the bottom of the stack up */
+    buffer = palloc(num_blocks * BLCKSZ);
+    i = num_blocks * GRAPHID_STACK_SPILL_BLOCK_SIZE;
+    while (node != NULL)
+    {
+        GraphIdNode *next = node->next;
+
+        buffer[--i] = node->id;
+        release_GraphIdNode(stack, node);
+        node = next;
+    }
+    Assert(i == 0);
+
+    /* the file goes away with the current resource owner, if not closed */
+    if (stack->spill_file == NULL)
+    {
+        /* temp_tablespaces must be set up before a temp file is created */
+        PrepareTempTablespaces();
+        stack->spill_file = BufFileCreateTemp(false);
+    }
+
+    if (BufFileSeekBlock(stack->spill_file, stack->num_spilled_blocks) != 0)
+    {
+        ereport(ERROR,
+                (errcode_for_file_access(),
+                 errmsg("could not seek in graphid stack spill file")));
+    }
+    BufFileWrite(stack->spill_file, buffer, num_blocks * BLCKSZ);
+
+    stack->num_spilled_blocks += num_blocks;
+    graphid_stacks_spilled_bytes += num_blocks * BLCKSZ;
+
+    pfree(buffer);
+}
+
+/*
+ * Helper function to read the top block of a stack's spill file back into
+ * memory. It is called once all of the nodes in memory have been popped.
+ */
+static void unspill_graphid_stack(ListGraphId *stack)
+{
+    PGAlignedBlock buffer;
+    graphid *ids = (graphid *)buffer.data;
+    size_t nread;
+    int64 i;
+
+    Assert(stack->head == NULL);
+    Assert(stack->num_spilled_blocks > 0);
+
+    stack->num_spilled_blocks--;
+
+    if (BufFileSeekBlock(stack->spill_file, stack->num_spilled_blocks) != 0)
+    {
+        ereport(ERROR,
+                (errcode_for_file_access(),
+                 errmsg("could not seek in graphid stack spill file")));
+    }
+    nread = BufFileRead(stack->spill_file, buffer.data, BLCKSZ);
+    if (nread != BLCKSZ)
+    {
+        ereport(ERROR,
+                (errcode_for_file_access(),
+                 errmsg("could not read from graphid stack spill file: read only %zu of %zu bytes",
+                        nread, (size_t)BLCKSZ)));
+    }
+
+    /* push them back from the bottom of the block up */
+    for (i = 0; i < GRAPHID_STACK_SPILL_BLOCK_SIZE; i++)
+    {
+        link_graphid_stack_head(stack, ids[i]);
+    }
+}
+
 /* return the next GraphIdNode */
 GraphIdNode *next_GraphIdNode(GraphIdNode *node)
 {
@@ -100,18 +336,20 @@ ListGraphId *append_graphid(ListGraphId *container, graphid id)
 {
     GraphIdNode *new_node = NULL;
 
+    /* if the container is NULL then this is a new list, so create it */
+    if (container == NULL)
+    {
+        container = palloc0(sizeof(ListGraphId));
+    }
+
     /* create the new link */
-    new_node = palloc0(sizeof(GraphIdNode));
+    new_node = alloc_GraphIdNode(container);
     new_node->id = id;
     new_node->next = NULL;
 
-    /*
-     * If the container is NULL then this is a new list. So, create the
-     * container and add in the new link.
-     */
-    if (container == NULL)
+    /* if the list is empty, the new link is all of it */
+    if (container->head == NULL)
     {
-        container = palloc0(sizeof(ListGraphId));
         container->head = new_node;
         container->tail = new_node;
         container->size = 1;
@@ -127,28 +365,63 @@ ListGraphId *append_graphid(ListGraphId *container, graphid id)
     return container;
 }
 
-/* free (delete) a ListGraphId list */
-void free_ListGraphId(ListGraphId *container)
+/*
+ * Helper function to remove the first occurrence of a graphid from a
+ * ListGraphId container. It returns true if the graphid was found.
+ */
+bool remove_graphid(ListGraphId *container, graphid id)
 {
+    GraphIdNode *prev_node = NULL;
     GraphIdNode *curr_node = NULL;
-    GraphIdNode *next_node = NULL;
 
-    /* if the container is NULL we don't need to delete anything */
     if (container == NULL)
     {
-        return;
+        return false;
     }
 
-    /* otherwise, start from the head, free, and delete the links */
     curr_node = container->head;
     while (curr_node != NULL)
     {
-        next_node = curr_node->next;
-        /* we can do this because this is just a list of ints */
-        pfree(curr_node);
-        curr_node = next_node;
+        if (curr_node->id == id)
+        {
+            /* unlink the node, fixing up the head and tail as needed */
+            if (prev_node == NULL)
+            {
+                container->head = curr_node->next;
+            }
+            else
+            {
+                prev_node->next = curr_node->next;
+            }
+            if (container->tail == curr_node)
+            {
+                container->tail = prev_node;
+            }
+            container->size--;
+
+            release_GraphIdNode(container, curr_node);
+            return true;
+        }
+
+        prev_node = curr_node;
+        curr_node = curr_node->next;
     }
 
+    return false;
+}
+
+/* free (delete) a ListGraphId list */
+void free_ListGraphId(ListGraphId *container)
+{
+    /* if the container is NULL we don't need to delete anything */
+    if (container == NULL)
+    {
+        return;
+    }
+
+    /* otherwise, free the links, by their chunks */
+    free_GraphIdNode_chunks(container);
+
     /* free the container */
     pfree(container);
 }
@@ -165,6 +438,12 @@ ListGraphId *new_graphid_stack(void)
     stack->head = NULL;
     stack->tail = NULL;
     stack->size = 0;
+    stack->chunks = NULL;
+    stack->num_unused = 0;
+    stack->free_nodes = NULL;
+    stack->max_nodes_in_memory = 0;
+    stack->spill_file = NULL;
+    stack->num_spilled_blocks = 0;
 
     /* return the new stack */
     return stack;
@@ -180,31 +459,51 @@ void free_graphid_stack(ListGraphId *stack)
         elog(ERROR, "free_graphid_stack: NULL stack");
     }
 
-    /* while there are entries */
-    while (stack->head != NULL)
-    {
-        /* get the next element in the stack */
-        GraphIdNode *next = stack->head->next;
+    /* free the entries, by their chunks */
+    free_GraphIdNode_chunks(stack);
 
-        /* free the head element */
-        pfree(stack->head);
-        /* move the head to the next */
-        stack->head = next;
+    /* and the spilled entries */
+    if (stack->spill_file != NULL)
+    {
+        BufFileClose(stack->spill_file);
+        stack->spill_file = NULL;
     }
+    stack->num_spilled_blocks = 0;
 
-    /* reset the tail and size */
+    /* reset the head, tail, and size */
+    stack->head = NULL;
     stack->tail = NULL;
     stack->size = 0;
 }
 
+/*
+ * Helper function to limit the memory that a graphid stack's nodes use to
+ * about mem_limit_kb kilobytes. Beyond that, the bottom of the stack spills
+ * to a temporary file, and is read back in once the top has been popped.
+ */
+void set_graphid_stack_mem_limit(ListGraphId *stack, int mem_limit_kb)
+{
+    int64 max_nodes = ((int64)mem_limit_kb * 1024) / sizeof(GraphIdNode);
+
+    Assert(stack != NULL);
+
+    /* it needs to hold at least 2 blocks to spill one of them */
+    stack->max_nodes_in_memory = Max(max_nodes,
+                                     2 * GRAPHID_STACK_SPILL_BLOCK_SIZE);
+}
+
+/* return the number of bytes all graphid stacks of this backend spilled */
+int64 get_graphid_stacks_spilled_bytes(void)
+{
+    return graphid_stacks_spilled_bytes;
+}
+
 /*
  * Helper function for a generic push graphid (int64) to a stack. If the stack
  * is NULL, it will error out.
  */
 void push_graphid_stack(ListGraphId *stack, graphid id)
 {
-    GraphIdNode *new_node = NULL;
-
     Assert(stack != NULL);
 
     if (stack == NULL)
@@ -212,14 +511,18 @@ void push_graphid_stack(ListGraphId *stack, graphid id)
         elog(ERROR, "push_graphid_stack: NULL stack");
     }
 
-    /* create the new element */
-    new_node = palloc0(sizeof(GraphIdNode));
-    new_node->id = id;
-
     /* insert (push) the new element on the top */
-    new_node->next = stack->head;
-    stack->head = new_node;
+    link_graphid_stack_head(stack, id);
     stack->size++;
+
+    /* spill the bottom of the stack if it has outgrown its memory */
+    if (stack->max_nodes_in_memory > 0 &&
+        stack->size - stack->num_spilled_blocks *
+                      GRAPHID_STACK_SPILL_BLOCK_SIZE >
+        stack->max_nodes_in_memory)
+    {
+        spill_graphid_stack(stack);
+    }
 }
 
 /*
@@ -251,8 +554,14 @@ graphid pop_graphid_stack(ListGraphId *stack)
     id = node->id;
     stack->head = stack->head->next;
     stack->size--;
-    /* free the element */
-    pfree(node);
+    /* release the element, for the next push */
+    release_GraphIdNode(stack, node);
+
+    /* read the spilled top back in once the rest has been popped */
+    if (stack->head == NULL && stack->num_spilled_blocks > 0)
+    {
+        unspill_graphid_stack(stack);
+    }
 
     /* return the id */
     return id;
@@ -19,15 +19,41 @@
 
 #include "postgres.h"
 
+#include <math.h>
+
 #include "access/heapam.h"
+#include "access/htup_details.h"
+#include "access/parallel.h"
 #include "catalog/namespace.h"
+#include "catalog/pg_class.h"
+#include "catalog/pg_inherits.h"
 #include "catalog/pg_type.h"
+#include "commands/explain.h"
 #include "common/hashfn.h"
+#include "executor/instrument.h"
 #include "funcapi.h"
+#include "lib/ilist.h"
+#include "lib/pairingheap.h"
+#include "miscadmin.h"
+#include "nodes/supportnodes.h"
+#include "optimizer/optimizer.h"
+#include "port/atomics.h"
+#include "postmaster/autovacuum.h"
+#include "replication/walsender.h"
+#include "storage/backendid.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "tcop/tcopprot.h"
 #include "utils/lsyscache.h"
+#include "utils/syscache.h"
 
 #include "utils/age_vle.h"
+#include "utils/ag_cache.h"
+#include "utils/ag_guc.h"
 #include "catalog/ag_graph.h"
+#include "catalog/ag_label.h"
+#include "commands/label_commands.h"
 #include "utils/graphid.h"
 #include "utils/age_graphid_ds.h"
 #include "nodes/cypher_nodes.h"
@@ -37,19 +63,88 @@
             (graphid *) (&vpc->graphid_array_data)
 #define EDGE_STATE_HTAB_NAME "Edge state "
 #define EDGE_STATE_HTAB_INITIAL_SIZE 100000
+#define PATH_EDGE_SET_INITIAL_SIZE 64 /* must be a power of 2 */
+#define PATH_EDGE_HASH(id) murmurhash32((uint32)(id) ^ (uint32)((id) >> 32))
+#define VLE_SPILLED_BYTES_NAME "AGE VLE spilled bytes"
+#define VERTEX_DISTANCE_HTAB_NAME "Vertex distances"
+#define VERTEX_DISTANCE_HTAB_INITIAL_SIZE 1000
+#define WEIGHTED_PATH_HTAB_NAME "Weighted path vertices"
+#define WEIGHTED_PATH_HTAB_INITIAL_SIZE 1000
+#define VERTEX_STATE_HTAB_NAME "Vertex state"
+#define VERTEX_STATE_HTAB_INITIAL_SIZE 1000
 #define EXISTS_HTAB_NAME "known edges"
 #define EXISTS_HTAB_NAME_INITIAL_SIZE 1000
-#define MAXIMUM_NUMBER_OF_CACHED_LOCAL_CONTEXTS 5
+#define VLE_CACHE_HTAB_NAME "VLE local context cache"
+#define VLE_CACHE_HTAB_INITIAL_SIZE 16
+#define VLE_CACHE_STATS_COLUMNS 5
+/* the most path lengths counted in a row estimate without an upper bound */
+#define VLE_ROW_ESTIMATE_MAX_DEPTH 10
+#define IS_SHORTEST_PATH_MODE(mode) \
+            ((mode) == CYPHER_PATH_SHORTEST || (mode) == CYPHER_PATH_ALL_SHORTEST)
 
 /* edge state entry for the edge_state_hashtable */
 typedef struct edge_state_entry
 {
     graphid edge_id;               /* edge id, it is also the hash key */
-    bool used_in_path;             /* like visited but more descriptive */
     bool has_been_matched;         /* have we checked for a  match */
     bool matched;                  /* is it a match */
 } edge_state_entry;
 
+/* vertex state entry for the vertex_state_hashtable */
+typedef struct vertex_state_entry
+{
+    graphid vertex_id;             /* vertex id, it is also the hash key */
+    bool matched;                  /* does it match the vertex prototype */
+} vertex_state_entry;
+
+/*
+ * vertex distance entry for the vertex_distance_hashtable. The distances are in
+ * edges and are -1 until the vertex is reached by that side's search.
+ */
+typedef struct vertex_distance_entry
+{
+    graphid vertex_id;             /* vertex id, it is also the hash key */
+    int64 forward_distance;        /* distance from the start vertex */
+    int64 backward_distance;       /* distance to the end vertex */
+} vertex_distance_entry;
+
+/*
+ * vertex entry for the weighted shortest path search. The entry records the
+ * least cost found so far to reach the vertex and the edge it was reached by.
+ */
+typedef struct weighted_path_entry
+{
+    graphid vertex_id;             /* vertex id, it is also the hash key */
+    float8 cost;                   /* least cost found from the start vertex */
+    graphid parent_edge_id;        /* the edge that cost was found through */
+    graphid parent_vertex_id;      /* the vertex at the other end of it */
+    int64 num_edges;               /* number of edges in the path to it */
+    bool settled;                  /* is the cost final */
+} weighted_path_entry;
+
+/*
+ * Pairing heap node for the weighted shortest path search. A vertex can be in
+ * the heap more than once, the nodes with a stale cost are skipped.
+ */
+typedef struct weighted_path_heap_node
+{
+    pairingheap_node ph_node;
+    graphid vertex_id;             /* the vertex reached */
+    float8 cost;                   /* the cost it was reached with */
+} weighted_path_heap_node;
+
+/*
+ * One compiled edge or vertex property constraint. The entity must have the
+ * key, with an equal scalar value or a container value that contains this one.
+ * The key and value point into the property constraint they were compiled
+ * from.
+ */
+typedef struct property_predicate
+{
+    agtype_value key;              /* the property key, an AGTV_STRING */
+    agtype_value value;            /* the value, a scalar or AGTV_BINARY */
+} property_predicate;
+
 /*
  * VLE_path_function is an enum for the path function to use. This currently can
  * be one of two possibilities - where the target vertex is provided and where
@@ -70,26 +165,57 @@ typedef struct VLE_local_context
     char *graph_name;              /* name of the graph */
     Oid graph_oid;                 /* graph oid for searching */
     GRAPH_global_context *ggctx;   /* global graph context pointer */
+    int64 ggctx_version;           /* version of ggctx this was built with */
     graphid vsid;                  /* starting vertex id */
     graphid veid;                  /* ending vertex id */
-    char *edge_label_name;         /* edge label name for match */
+    bool has_edge_label;           /* is there an edge label to match */
+    int32 edge_label_id;           /* its label id, INVALID_LABEL_ID if none */
     agtype *edge_property_constraint; /* edge property constraint as agtype */
+    /* the constraint compiled into one predicate per property */
+    property_predicate *edge_property_predicates;
+    int num_edge_property_predicates;
+    /* the prototype intermediate vertices must match, if there is one */
+    bool has_vertex_constraint;
+    bool has_vertex_label;         /* is there a vertex label to match */
+    int32 vertex_label_id;         /* its label id, INVALID_LABEL_ID if none */
+    agtype *vertex_property_constraint; /* vertex property constraint */
+    property_predicate *vertex_property_predicates;
+    int num_vertex_property_predicates;
+    HTAB *vertex_state_hashtable;  /* which vertices match their properties */
     int64 lidx;                    /* lower (start) bound index */
     int64 uidx;                    /* upper (end) bound index */
     bool uidx_infinite;            /* flag if the upper bound is omitted */
     cypher_rel_dir edge_direction; /* the direction of the edge */
     HTAB *edge_state_hashtable;    /* local state hashtable for our edges */
+    /* distances found by the bidirectional search, for PATHS_BETWEEN */
+    HTAB *vertex_distance_hashtable;
+    int64 backward_search_depth;   /* how far the end vertex was searched from */
+    bool backward_search_complete; /* were all vertices reaching it found */
+    cypher_path_mode path_mode;    /* all paths, the shortest, or any one */
+    int64 shortest_path_length;    /* their length, -1 if there aren't any */
+    int64 row_bound;               /* most rows to return, -1 if unbounded */
     ListGraphId *dfs_vertex_stack; /* dfs stack for vertices */
     ListGraphId *dfs_edge_stack;   /* dfs stack for edges */
     ListGraphId *dfs_path_stack;   /* dfs stack containing the path */
+    /* open addressing set of the edges in dfs_path_stack, 0 is empty */
+    graphid *path_edge_set;
+    uint32 path_edge_set_size;     /* number of slots, a power of 2 */
+    uint32 path_edge_set_count;    /* number of edges in the set */
     VLE_path_function path_function; /* which path function to use */
-    GraphIdNode *next_vertex;      /* for VLE_FUNCTION_PATHS_TO */
+    uint32 next_vertex_index;      /* next start vertex, for _TO and _ALL */
     int64 vle_grammar_node_id;     /* the unique VLE grammar assigned node id */
     bool use_cache;                /* are we using VLE_local_context cache */
-    struct VLE_local_context *next;  /* the next chained VLE_local_context */
+    dlist_node lru_node;           /* its place in the cache's LRU list */
     bool is_dirty;                 /* is this VLE context reusable */
 } VLE_local_context;
 
+/* entry of the VLE local context cache, by VLE grammar node id */
+typedef struct VLE_cache_entry
+{
+    int64 vle_grammar_node_id;     /* VLE grammar node id, the hash key */
+    VLE_local_context *vlelctx;    /* the cached context */
+} VLE_cache_entry;
+
 /*
  * Container to hold the graphid array that contains one valid path. This
  * structure will allow it to be easily passed as an AGTYPE pointer. The
@@ -108,11 +234,38 @@ typedef struct VLE_path_container
 
 /* declarations */
 
-/* global variable to hold the per process global cached VLE_local contexts */
-static VLE_local_context *global_vle_local_contexts = NULL;
+/*
+ * The per process cache of VLE_local contexts. The hashtable finds them by
+ * their VLE grammar node id, and the list orders them from the most to the
+ * least recently used.
+ */
+static HTAB *vle_local_context_cache = NULL;
+static dlist_head vle_local_context_lru =
+    DLIST_STATIC_INIT(vle_local_context_lru);
+/* and its counters */
+static int64 vle_cache_hits = 0;
+static int64 vle_cache_misses = 0;
+static int64 vle_cache_evictions = 0;
+
+/*
+ * The bytes spilled by the dfs stacks of parallel workers, one counter per
+ * backend, that the workers add to for their leader. It is only available
+ * when age is loaded via shared_preload_libraries.
+ */
+static pg_atomic_uint64 *vle_shared_spilled_bytes = NULL;
+/* the bytes spilled by this parallel worker that its leader was given */
+static int64 vle_reported_spilled_bytes = 0;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+static ExplainOneQuery_hook_type prev_explain_one_query_hook = NULL;
 
 /* agtype functions */
 static bool is_an_edge_match(VLE_local_context *vlelctx, edge_entry *ee);
+static bool is_an_edge_label_match(VLE_local_context *vlelctx,
+                                   graphid edge_id);
+static property_predicate *compile_property_constraint(agtype *constraint,
+                                                       int *num_predicates);
+static bool is_a_property_match(property_predicate *predicate,
+                                agtype_container *agtc_edge_property);
 /* VLE local context functions */
 static VLE_local_context *build_local_vle_context(FunctionCallInfo fcinfo,
                                                   FuncCallContext *funcctx);
@@ -125,168 +278,231 @@ static edge_state_entry *get_edge_state(VLE_local_context *vlelctx,
 static void load_initial_dfs_stacks(VLE_local_context *vlelctx);
 static bool dfs_find_a_path_between(VLE_local_context *vlelctx);
 static bool dfs_find_a_path_from(VLE_local_context *vlelctx);
+static void clear_dfs_stacks(VLE_local_context *vlelctx);
+static void set_dfs_stack_mem_limits(VLE_local_context *vlelctx);
 static bool do_vsid_and_veid_exist(VLE_local_context *vlelctx);
+static bool search_from_both_ends(VLE_local_context *vlelctx);
+static void expand_search_frontier(VLE_local_context *vlelctx,
+                                   ListGraphId **frontier, bool backward,
+                                   int64 depth, bool forward_only,
+                                   int64 *shortest);
+static bool can_reach_end_vertex(VLE_local_context *vlelctx,
+                                 graphid vertex_id, int64 path_size);
+static bool is_end_vertex_reachable(VLE_local_context *vlelctx);
+static bool is_a_valid_edge(VLE_local_context *vlelctx, graphid edge_id);
+static bool is_a_valid_vertex(VLE_local_context *vlelctx, graphid vertex_id);
+static bool is_a_vertex_property_match(VLE_local_context *vlelctx,
+                                       vertex_entry *ve);
+static void get_prototype_label(agtype_value *agtv_label, Oid graph_oid,
+                                bool *has_label, int32 *label_id);
 static void add_valid_vertex_edges(VLE_local_context *vlelctx,
                                    graphid vertex_id);
 static graphid get_next_vertex(VLE_local_context *vlelctx, edge_entry *ee);
+static bool get_next_start_vertex(VLE_local_context *vlelctx);
+static void check_VLE_path_mode(VLE_local_context *vlelctx);
 static bool is_edge_in_path(VLE_local_context *vlelctx, graphid edge_id);
+static uint32 get_path_edge_slot(VLE_local_context *vlelctx, graphid edge_id);
+static void grow_path_edge_set(VLE_local_context *vlelctx);
+static void push_path_edge(VLE_local_context *vlelctx, graphid edge_id);
+static void pop_path_edge(VLE_local_context *vlelctx);
 /* VLE path and edge building functions */
 static VLE_path_container *create_VLE_path_container(int64 path_size);
 static VLE_path_container *build_VLE_path_container(VLE_local_context *vlelctx);
 static VLE_path_container *build_VLE_zero_container(VLE_local_context *vlelctx);
 static agtype_value *build_path(VLE_path_container *vpc);
 static agtype_value *build_edge_list(VLE_path_container *vpc);
+static GRAPH_global_context *get_VLE_path_container_ggctx(
+    VLE_path_container *vpc);
 /* VLE_local_context cache management */
 static VLE_local_context *get_cached_VLE_local_context(int64 vle_node_id);
 static void cache_VLE_local_context(VLE_local_context *vlelctx);
+static void uncache_VLE_local_context(VLE_local_context *vlelctx);
+static void trim_VLE_local_context_cache(int cache_size);
+/* weighted shortest path functions */
+static graphid get_vertex_id_argument(FunctionCallInfo fcinfo, int argno,
+                                      char *argname);
+static int weighted_path_heap_compare(const pairingheap_node *a,
+                                      const pairingheap_node *b, void *arg);
+static bool get_edge_weight(edge_entry *ee, agtype_value *weight_key,
+                            float8 *weight);
+static VLE_path_container *find_weighted_shortest_path(
+    GRAPH_global_context *ggctx, graphid vsid, graphid veid,
+    bool has_edge_label, int32 edge_label_id, agtype_value *weight_key);
+/* planner support functions */
+static Const *get_estimated_const_arg(PlannerInfo *root, List *args,
+                                      int argno);
+static bool is_const_arg_null(Const *c);
+static agtype_value *get_estimated_arg_value(PlannerInfo *root, List *args,
+                                             int argno,
+                                             enum agtype_value_type type);
+static double get_label_num_entities(const char *label_name, Oid graph_oid);
+static double estimate_VLE_rows(PlannerInfo *root, List *args);
+/* EXPLAIN functions */
+static int vle_shmem_max_backends(void);
+static void vle_shmem_startup(void);
+static void report_vle_spilled_bytes(void);
+static int64 get_vle_spilled_bytes(void);
+static void vle_ExplainOneQuery(Query *query, int cursorOptions,
+                                IntoClause *into, ExplainState *es,
+                                const char *queryString, ParamListInfo params,
+                                QueryEnvironment *queryEnv);
 
 /* definitions */
 
 /*
- * Helper function to retrieve a cached VLE local context. It will also purge
- * off any contexts beyond the maximum defined number of cached contexts. It
- * will promote (a very basic LRU) the recently fetched context to the head of
- * the list. If a context doesn't exist or is dirty, it will purge it off and
- * return NULL.
+ * Helper function to retrieve a cached VLE local context. The context is
+ * promoted to the head of the LRU list. If a context doesn't exist or is
+ * dirty, or its GRAPH global context has changed, it is purged and NULL is
+ * returned.
  */
 static VLE_local_context *get_cached_VLE_local_context(int64 vle_grammar_node_id)
 {
-    VLE_local_context *vlelctx = global_vle_local_contexts;
-    VLE_local_context *prev = NULL;
-    VLE_local_context *next = NULL;
-    int cache_size = 0;
+    VLE_cache_entry *vce = NULL;
+    VLE_local_context *vlelctx = NULL;
+    GRAPH_global_context *ggctx = NULL;
 
-    /* while we have contexts to check */
-    while (vlelctx != NULL)
+    /* find the context for this grammar node */
+    if (vle_local_context_cache != NULL)
     {
-        /* purge any contexts past the maximum cache size */
-        if (cache_size >= MAXIMUM_NUMBER_OF_CACHED_LOCAL_CONTEXTS)
-        {
-            /* set the next pointer to the context that follows */
-            next = vlelctx->next;
+        vce = hash_search(vle_local_context_cache,
+                          (void *)&vle_grammar_node_id, HASH_FIND, NULL);
+    }
 
-            /*
-             * Clear (unlink) the previous context's next pointer, if needed.
-             * Also clear prev as we are at the end of avaiable cached contexts
-             * and just purging them off. Remember, this forms a loop that will
-             * exit the while after purging.
-             */
-            if (prev != NULL)
-            {
-                prev->next = NULL;
-                prev = NULL;
-            }
+    if (vce == NULL)
+    {
+        vle_cache_misses++;
+        return NULL;
+    }
 
-            /* free the context */
-            free_VLE_local_context(vlelctx);
+    vlelctx = vce->vlelctx;
 
-            /* set to the next one */
-            vlelctx = next;
+    /* a dirty context can't be reused */
+    if (vlelctx->is_dirty == false)
+    {
+        /*
+         * Get the GRAPH global context associated with this local VLE context.
+         * We need to verify it still exists and that the pointer is valid.
+         *
+         * If ggctx == NULL, vlelctx is bad and vlelctx needs to be removed.
+         * If ggctx == vlelctx->ggctx, then vlelctx is good.
+         * If ggctx != vlelctx->ggctx, then vlelctx needs to be updated.
+         * In the end, vlelctx->ggctx will be set to ggctx.
+         */
+        ggctx = find_GRAPH_global_context(vlelctx->graph_oid);
 
-            /* if there is another context beyond the max, we will re-enter */
-            continue;
+        /*
+         * If the returned ggctx isn't valid (there was some update to the
+         * underlying graph), or has had deltas applied since, then set it to
+         * NULL. This will force a rebuild of it.
+         */
+        if (ggctx != NULL &&
+            (is_ggctx_invalid(ggctx) ||
+             get_ggctx_version(ggctx) != vlelctx->ggctx_version))
+        {
+            ggctx = NULL;
         }
 
-        /* if this context belongs to this grammar node */
-        if (vlelctx->vle_grammar_node_id == vle_grammar_node_id)
-        {
-            /* and isn't dirty */
-            if (vlelctx->is_dirty == false)
-            {
-                GRAPH_global_context *ggctx = NULL;
+        vlelctx->ggctx = ggctx;
+    }
 
-                /*
-                 * Get the GRAPH global context associated with this local VLE
-                 * context. We need to verify it still exists and that the
-                 * pointer is valid.
-                 */
-                ggctx = find_GRAPH_global_context(vlelctx->graph_oid);
+    /* if we have a good one, promote it and return it */
+    if (ggctx != NULL)
+    {
+        dlist_move_head(&vle_local_context_lru, &vlelctx->lru_node);
+        vle_cache_hits++;
+        return vlelctx;
+    }
 
-                /*
-                 * If ggctx == NULL, vlelctx is bad and vlelctx needs to be
-                 * removed.
-                 * If ggctx == vlelctx->ggctx, then vlelctx is good.
-                 * If ggctx != vlelctx->ggctx, then vlelctx needs to be updated.
-                 * In the end, vlelctx->ggctx will be set to ggctx.
-                 */
+    /* otherwise, clean and remove it, and return NULL */
+    uncache_VLE_local_context(vlelctx);
+    free_VLE_local_context(vlelctx);
+    vle_cache_misses++;
 
-                /*
-                 * If the returned ggctx isn't valid (there was some update to
-                 * the underlying graph), then set it to NULL. This will force a
-                 * rebuild of it.
-                 */
-                if (ggctx != NULL && is_ggctx_invalid(ggctx))
-                {
-                    ggctx = NULL;
-                }
+    return NULL;
+}
 
-                vlelctx->ggctx = ggctx;
+/*
+ * Helper function to add a VLE local context to the head of the cache. The
+ * least recently used contexts past age.vle_local_context_cache_size are
+ * evicted.
+ */
+static void cache_VLE_local_context(VLE_local_context *vlelctx)
+{
+    VLE_cache_entry *vce = NULL;
+    bool found = false;
 
-                /*
-                 * If the context is good and isn't at the head of the cache,
-                 * promote it to the head.
-                 */
-                if (ggctx != NULL && vlelctx != global_vle_local_contexts)
-                {
-                    /* adjust the links to cut out the node */
-                    prev->next = vlelctx->next;
-                    /* point the context to the old head of the list */
-                    vlelctx->next = global_vle_local_contexts;
-                    /* point the head to this context */
-                    global_vle_local_contexts = vlelctx;
-                }
+    /* if the context passed is null, just return */
+    if (vlelctx == NULL)
+    {
+        return;
+    }
 
-                /* if we have a good one, return it. */
-                if (ggctx != NULL)
-                {
-                    return vlelctx;
-                }
-            }
+    /* create the cache on first use, it lasts for the life of the process */
+    if (vle_local_context_cache == NULL)
+    {
+        HASHCTL vle_cache_ctl;
+
+        MemSet(&vle_cache_ctl, 0, sizeof(vle_cache_ctl));
+        vle_cache_ctl.keysize = sizeof(int64);
+        vle_cache_ctl.entrysize = sizeof(VLE_cache_entry);
+        vle_cache_ctl.hash = tag_hash;
+        vle_local_context_cache = hash_create(VLE_CACHE_HTAB_NAME,
+                                              VLE_CACHE_HTAB_INITIAL_SIZE,
+                                              &vle_cache_ctl,
+                                              HASH_ELEM | HASH_FUNCTION);
+    }
 
-            /* otherwise, clean and remove it, and return NULL */
+    vce = hash_search(vle_local_context_cache,
+                      (void *)&vlelctx->vle_grammar_node_id, HASH_ENTER,
+                      &found);
 
-            /* set the top if necessary and unlink it */
-            if (prev == NULL)
-            {
-                global_vle_local_contexts = vlelctx->next;
-            }
-            else
-            {
-                prev->next = vlelctx->next;
-            }
+    /* a context already cached for this grammar node is replaced */
+    if (found)
+    {
+        VLE_local_context *old_vlelctx = vce->vlelctx;
 
-            /* now free it and return NULL */
-            free_VLE_local_context(vlelctx);
-            return NULL;
-        }
-        /* save the previous context */
-        prev = vlelctx;
-        /* get the next context */
-        vlelctx = vlelctx->next;
-        /* keep track of cache size */
-        cache_size++;
+        dlist_delete(&old_vlelctx->lru_node);
+        free_VLE_local_context(old_vlelctx);
     }
-    return vlelctx;
+
+    vce->vlelctx = vlelctx;
+    dlist_push_head(&vle_local_context_lru, &vlelctx->lru_node);
+
+    /* keep the cache within its size */
+    trim_VLE_local_context_cache(age_vle_local_context_cache_size);
 }
 
-static void cache_VLE_local_context(VLE_local_context *vlelctx)
+/* helper function to remove a VLE local context from the cache */
+static void uncache_VLE_local_context(VLE_local_context *vlelctx)
 {
-    /* if the context passed is null, just return */
-    if (vlelctx == NULL)
+    hash_search(vle_local_context_cache, (void *)&vlelctx->vle_grammar_node_id,
+                HASH_REMOVE, NULL);
+    dlist_delete(&vlelctx->lru_node);
+}
+
+/*
+ * Helper function to evict the least recently used VLE local contexts until
+ * there are at most cache_size of them. The cache size can be lowered at any
+ * time, so this is also done before the cache is used.
+ */
+static void trim_VLE_local_context_cache(int cache_size)
+{
+    if (vle_local_context_cache == NULL)
     {
         return;
     }
 
-    /* if the global link is null, just assign it the local context */
-    if (global_vle_local_contexts == NULL)
+    while (hash_get_num_entries(vle_local_context_cache) > cache_size)
     {
-        global_vle_local_contexts = vlelctx;
-        return;
-    }
+        VLE_local_context *vlelctx = NULL;
+
+        vlelctx = dlist_tail_element(VLE_local_context, lru_node,
+                                     &vle_local_context_lru);
 
-    /* if there is a global link, add the local context to the top */
-    vlelctx->next = global_vle_local_contexts;
-    global_vle_local_contexts = vlelctx;
+        uncache_VLE_local_context(vlelctx);
+        free_VLE_local_context(vlelctx);
+        vle_cache_evictions++;
+    }
 }
 
 /* helper function to create the local VLE edge state hashtable. */
@@ -322,69 +538,175 @@ static void create_VLE_local_state_hashtable(VLE_local_context *vlelctx)
     pfree(eshn);
 }
 
+/*
+ * Helper function to compile a property constraint into a flat array of
+ * predicates, one per property, so that each edge or vertex can be checked
+ * without walking the constraint. It returns NULL if there aren't any.
+ */
+static property_predicate *compile_property_constraint(agtype *constraint,
+                                                       int *num_predicates)
+{
+    property_predicate *predicates = NULL;
+    agtype_iterator *it = NULL;
+    agtype_iterator_token token;
+    agtype_value value;
+    int num_pairs;
+    int i = 0;
+
+    num_pairs = AGT_ROOT_COUNT(constraint);
+
+    *num_predicates = num_pairs;
+
+    if (num_pairs == 0)
+    {
+        return NULL;
+    }
+
+    predicates = palloc(sizeof(property_predicate) * num_pairs);
+
+    /* walk the top level pairs only, nested containers are kept as binary */
+    it = agtype_iterator_init(&constraint->root);
+    while ((token = agtype_iterator_next(&it, &value, true)) != WAGT_DONE)
+    {
+        if (token == WAGT_KEY)
+        {
+            Assert(i < num_pairs);
+            predicates[i].key = value;
+        }
+        else if (token == WAGT_VALUE)
+        {
+            predicates[i++].value = value;
+        }
+    }
+
+    Assert(i == num_pairs);
+
+    return predicates;
+}
+
+/*
+ * Helper function to check one compiled predicate against an edge's or a
+ * vertex's properties. The key is found by binary search and scalars are
+ * compared directly. This is the same test agtype_deep_contains applies to
+ * each pair.
+ */
+static bool is_a_property_match(property_predicate *predicate,
+                                agtype_container *agtc_edge_property)
+{
+    agtype_value *property = NULL;
+    bool is_match = false;
+
+    property = find_agtype_value_from_container(agtc_edge_property,
+                                                AGT_FOBJECT, &predicate->key);
+    if (property == NULL)
+    {
+        return false;
+    }
+
+    if (property->type != predicate->value.type)
+    {
+        is_match = false;
+    }
+    else if (IS_A_AGTYPE_SCALAR(property))
+    {
+        is_match = equals_agtype_scalar_value(property, &predicate->value);
+    }
+    else
+    {
+        agtype_iterator *property_it = NULL;
+        agtype_iterator *constraint_it = NULL;
+
+        /* nested containers still need the deep containment test */
+        property_it = agtype_iterator_init(property->val.binary.data);
+        constraint_it = agtype_iterator_init(predicate->value.val.binary.data);
+        is_match = agtype_deep_contains(&property_it, &constraint_it);
+    }
+
+    pfree(property);
+
+    return is_match;
+}
+
 /*
  * Helper function to compare the edge constraint (properties we are looking
  * for in a matching edge) against an edge entry's property.
  */
 static bool is_an_edge_match(VLE_local_context *vlelctx, edge_entry *ee)
 {
+    Datum edge_properties;
     agtype *edge_property = NULL;
     agtype_container *agtc_edge_property = NULL;
-    agtype_container *agtc_edge_property_constraint = NULL;
-    agtype_iterator *constraint_it = NULL;
-    agtype_iterator *property_it = NULL;
-    char *edge_label_name = NULL;
     int num_edge_property_constraints = 0;
-    int num_edge_properties = 0;
+    bool is_match = true;
+    int i;
 
     /* get the number of conditions from the prototype edge */
-    num_edge_property_constraints = AGT_ROOT_COUNT(vlelctx->edge_property_constraint);
+    num_edge_property_constraints = vlelctx->num_edge_property_predicates;
 
     /*
      * We only care about verifying that we have all of the property conditions.
      * We don't care about extra unmatched properties. If there aren't any edge
      * constraints, then the edge passes by default.
      */
-    if (vlelctx->edge_label_name == NULL && num_edge_property_constraints == 0)
+    if (!vlelctx->has_edge_label && num_edge_property_constraints == 0)
+    {
+        return true;
+    }
+
+    /*
+     * Check for a label constraint. The label id is part of the edge id. This
+     * is checked first as the properties may need to be fetched.
+     */
+    if (!is_an_edge_label_match(vlelctx, get_edge_entry_id(ee)))
+    {
+        return false;
+    }
+
+    /* if there aren't any property constraints, the edge passes */
+    if (num_edge_property_constraints == 0)
     {
         return true;
     }
 
-    /* get the edge label name from the oid */
-    edge_label_name = get_rel_name(get_edge_entry_label_table_oid(ee));
     /* get our edge's properties */
-    edge_property = DATUM_GET_AGTYPE_P(get_edge_entry_properties(ee));
-    /* get the containers */
-    agtc_edge_property_constraint = &vlelctx->edge_property_constraint->root;
+    edge_properties = get_edge_entry_properties(ee);
+    edge_property = DATUM_GET_AGTYPE_P(edge_properties);
+    /* get the container */
     agtc_edge_property = &edge_property->root;
-    /* get the number of properties in the edge to be matched */
-    num_edge_properties = AGTYPE_CONTAINER_SIZE(agtc_edge_property);
 
     /*
      * Check to see if the edge_properties object has AT LEAST as many pairs
      * to compare as the edge_property_constraint object has pairs. If not, it
      * can't possibly match.
      */
-    if (num_edge_property_constraints > num_edge_properties)
+    if (num_edge_property_constraints >
+        AGTYPE_CONTAINER_SIZE(agtc_edge_property))
     {
-        return false;
+        is_match = false;
     }
 
-    /*
-     * Check for a label constraint. If the label name is NULL, there isn't one.
-     */
-    if (vlelctx->edge_label_name != NULL &&
-        strcmp(vlelctx->edge_label_name, edge_label_name) != 0)
+    /* check each of the compiled predicates */
+    for (i = 0; i < num_edge_property_constraints && is_match; i++)
     {
-        return false;
+        is_match = is_a_property_match(&vlelctx->edge_property_predicates[i],
+                                       agtc_edge_property);
     }
 
-    /* get the iterators */
-    constraint_it = agtype_iterator_init(agtc_edge_property_constraint);
-    property_it = agtype_iterator_init(agtc_edge_property);
+    /* release the properties, if they were fetched */
+    free_edge_entry_properties(ee, edge_properties);
 
-    /* return the value of deep contains */
-    return agtype_deep_contains(&property_it, &constraint_it);
+    return is_match;
+}
+
+/*
+ * Helper function to check an edge against the label constraint, if any. It
+ * only needs the edge id, so the edge doesn't need to be looked up.
+ */
+static bool is_an_edge_label_match(VLE_local_context *vlelctx,
+                                   graphid edge_id)
+{
+    return (!vlelctx->has_edge_label ||
+            GET_LABEL_ID(edge_id) == vlelctx->edge_label_id);
 }
 
 /*
@@ -410,17 +732,38 @@ static void free_VLE_local_context(VLE_local_context *vlelctx)
         vlelctx->graph_name = NULL;
     }
 
-    /* free the stored edge label name */
-    if (vlelctx->edge_label_name != NULL)
+    /* free the compiled edge property predicates */
+    if (vlelctx->edge_property_predicates != NULL)
+    {
+        pfree(vlelctx->edge_property_predicates);
+        vlelctx->edge_property_predicates = NULL;
+    }
+
+    /* and the vertex prototype's */
+    if (vlelctx->vertex_property_predicates != NULL)
     {
-        pfree(vlelctx->edge_label_name);
-        vlelctx->edge_label_name = NULL;
+        pfree(vlelctx->vertex_property_predicates);
+        vlelctx->vertex_property_predicates = NULL;
     }
 
     /* we need to free our state hashtable */
     hash_destroy(vlelctx->edge_state_hashtable);
     vlelctx->edge_state_hashtable = NULL;
 
+    /* and the vertex states, if there is a vertex prototype */
+    if (vlelctx->vertex_state_hashtable != NULL)
+    {
+        hash_destroy(vlelctx->vertex_state_hashtable);
+        vlelctx->vertex_state_hashtable = NULL;
+    }
+
+    /* and the vertex distances, if there was a search */
+    if (vlelctx->vertex_distance_hashtable != NULL)
+    {
+        hash_destroy(vlelctx->vertex_distance_hashtable);
+        vlelctx->vertex_distance_hashtable = NULL;
+    }
+
     /*
      * We need to free the contents of our stacks if the context is not dirty.
      * These stacks are created in a more volatile memory context. If the
@@ -442,6 +785,10 @@ static void free_VLE_local_context(VLE_local_context *vlelctx)
     vlelctx->dfs_edge_stack = NULL;
     vlelctx->dfs_path_stack = NULL;
 
+    /* free the path edge set */
+    pfree(vlelctx->path_edge_set);
+    vlelctx->path_edge_set = NULL;
+
     /* and finally the context itself */
     pfree(vlelctx);
     vlelctx = NULL;
@@ -471,6 +818,9 @@ static bool do_vsid_and_veid_exist(VLE_local_context *vlelctx)
 /* load the initial edges into the dfs_edge_stack */
 static void load_initial_dfs_stacks(VLE_local_context *vlelctx)
 {
+    /* a cached context may hold the length from its last search */
+    vlelctx->shortest_path_length = -1;
+
     /*
      * If either the vsid or veid don't exist - don't load anything because
      * there won't be anything to find.
@@ -480,93 +830,475 @@ static void load_initial_dfs_stacks(VLE_local_context *vlelctx)
         return;
     }
 
+    /*
+     * When there is an end vertex, search from both ends first. If the
+     * searches don't meet, there are no paths to find.
+     */
+    if ((vlelctx->path_function == VLE_FUNCTION_PATHS_BETWEEN ||
+         vlelctx->path_function == VLE_FUNCTION_PATHS_TO) &&
+        !search_from_both_ends(vlelctx))
+    {
+        return;
+    }
+
     /* add in the edges for the start vertex */
     add_valid_vertex_edges(vlelctx, vlelctx->vsid);
 }
 
 /*
- * Helper function to build the local VLE context. This is also the point
- * where, if necessary, the global GRAPH contexts are created and freed.
+ * Helper function to search outward from both the start and the end vertex for
+ * VLE_FUNCTION_PATHS_BETWEEN. The smaller frontier is expanded a level at a
+ * time until the depths of the two searches add up to the upper bound, or
+ * until every vertex that can reach the end vertex has been found. Any path
+ * within the bounds then passes through vertices that are recorded, with their
+ * distances, in the vertex distance hashtable.
+ *
+ * The distances ignore the rule that an edge can't repeat in a path, so they
+ * are lower bounds. The dfs uses them to skip edges that can't get it to the
+ * end vertex within the upper bound. This function returns false if the two
+ * searches never met, as then there aren't any paths.
+ *
+ * For shortestPath() and allShortestPaths(), the searches stop at the first
+ * level where they meet. That gives the length of the shortest paths, which
+ * is kept in the VLE local context.
  */
-static VLE_local_context *build_local_vle_context(FunctionCallInfo fcinfo,
-                                                  FuncCallContext *funcctx)
+static bool search_from_both_ends(VLE_local_context *vlelctx)
 {
-    MemoryContext oldctx = NULL;
-    GRAPH_global_context *ggctx = NULL;
-    VLE_local_context *vlelctx = NULL;
-    agtype_value *agtv_temp = NULL;
-    agtype_value *agtv_object = NULL;
-    char *graph_name = NULL;
-    Oid graph_oid = InvalidOid;
-    int64 vle_grammar_node_id = 0;
-    bool use_cache = false;
+    HASHCTL vertex_distance_ctl;
+    ListGraphId *forward_frontier = NULL;
+    ListGraphId *backward_frontier = NULL;
+    vertex_distance_entry *vde = NULL;
+    int64 forward_depth = 0;
+    int64 backward_depth = 0;
+    int64 shortest = -1;
+    bool found = false;
 
-    /*
-     * Get the VLE grammar node id, if it exists. Remember, we overload the
-     * age_vle function, for now, for backwards compatability
-     */
-    if (PG_NARGS() == 8)
+    /* the distances from a prior start and end vertex are of no use */
+    if (vlelctx->vertex_distance_hashtable != NULL)
     {
-        /* get the VLE grammar node id */
-        agtv_temp = get_agtype_value("age_vle", AG_GET_ARG_AGTYPE_P(7),
-                                     AGTV_INTEGER, true);
-        vle_grammar_node_id = agtv_temp->val.int_value;
+        hash_destroy(vlelctx->vertex_distance_hashtable);
+        vlelctx->vertex_distance_hashtable = NULL;
+    }
 
-        /* we are using the VLE local context cache, so set it */
-        use_cache = true;
+    MemSet(&vertex_distance_ctl, 0, sizeof(vertex_distance_ctl));
+    vertex_distance_ctl.keysize = sizeof(int64);
+    vertex_distance_ctl.entrysize = sizeof(vertex_distance_entry);
+    vertex_distance_ctl.hash = tag_hash;
+    vlelctx->vertex_distance_hashtable =
+        hash_create(VERTEX_DISTANCE_HTAB_NAME,
+                    VERTEX_DISTANCE_HTAB_INITIAL_SIZE, &vertex_distance_ctl,
+                    HASH_ELEM | HASH_FUNCTION);
+
+    /* seed the searches with the start and end vertices */
+    vde = hash_search(vlelctx->vertex_distance_hashtable,
+                      (void *)&vlelctx->vsid, HASH_ENTER, NULL);
+    vde->vertex_id = vlelctx->vsid;
+    vde->forward_distance = 0;
+    vde->backward_distance = -1;
+
+    /* if the end vertex is also the start vertex, the searches have met */
+    vde = hash_search(vlelctx->vertex_distance_hashtable,
+                      (void *)&vlelctx->veid, HASH_ENTER, &found);
+    if (found)
+    {
+        shortest = 0;
     }
+    else
+    {
+        vde->vertex_id = vlelctx->veid;
+        vde->forward_distance = -1;
+    }
+    vde->backward_distance = 0;
 
-    /* fetch the VLE_local_context if it is cached */
-    vlelctx = get_cached_VLE_local_context(vle_grammar_node_id);
+    forward_frontier = new_graphid_stack();
+    backward_frontier = new_graphid_stack();
+    push_graphid_stack(forward_frontier, vlelctx->vsid);
+    push_graphid_stack(backward_frontier, vlelctx->veid);
 
-    /* if we are caching VLE_local_contexts and this grammar node is cached */
-    if (use_cache && vlelctx != NULL)
+    vlelctx->backward_search_complete = false;
+
+    for (;;)
     {
-        /*
-         * No context change is needed here as the cache entry is in the proper
-         * context. Additionally, all of the modifications are either pointers
-         * to objects already in the proper context or primative types that will
-         * be stored in that context since the memory is allocated there.
-         */
+        bool forward_exhausted = IS_GRAPHID_STACK_EMPTY(forward_frontier);
 
-        /* get and update the start vertex id */
-        if (PG_ARGISNULL(1) || is_agtype_null(AG_GET_ARG_AGTYPE_P(1)))
+        CHECK_FOR_INTERRUPTS();
+
+        /* the shortest paths have been found */
+        if (vlelctx->path_mode != CYPHER_PATH_ALL && shortest >= 0)
+        {
+            break;
+        }
+
+        /* every vertex that can reach the end vertex has been found */
+        if (IS_GRAPHID_STACK_EMPTY(backward_frontier))
         {
-            vlelctx->vsid = get_graphid(vlelctx->next_vertex);
-            /* increment to the next vertex */
-            vlelctx->next_vertex = next_GraphIdNode(vlelctx->next_vertex);
+            vlelctx->backward_search_complete = true;
+            break;
         }
-        else
+
+        /* every path within the upper bound passes through the frontiers */
+        if (!vlelctx->uidx_infinite &&
+            forward_depth + backward_depth >= vlelctx->uidx)
         {
-            agtv_temp = get_agtype_value("age_vle", AG_GET_ARG_AGTYPE_P(1),
-                                         AGTV_VERTEX, false);
-            if (agtv_temp != NULL && agtv_temp->type == AGTV_VERTEX)
-            {
-                agtv_temp = GET_AGTYPE_VALUE_OBJECT_VALUE(agtv_temp, "id");
-            }
-            else if (agtv_temp == NULL || agtv_temp->type != AGTV_INTEGER)
-            {
-                ereport(ERROR,
-                        (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                         errmsg("start vertex argument must be a vertex or the integer id")));
-            }
-            vlelctx->vsid = agtv_temp->val.int_value;
+            break;
         }
 
-        /* get and update the end vertex id */
-        if (PG_ARGISNULL(2) || is_agtype_null(AG_GET_ARG_AGTYPE_P(2)))
+        /*
+         * Expand the smaller frontier. Once the forward search is exhausted,
+         * only the vertices it found can be in a path, so the backward search
+         * is limited to those.
+         */
+        if (!forward_exhausted &&
+            get_stack_size(forward_frontier) <=
+            get_stack_size(backward_frontier))
         {
-            vlelctx->veid = 0;
+            forward_depth++;
+            expand_search_frontier(vlelctx, &forward_frontier, false,
+                                   forward_depth, false, &shortest);
         }
         else
         {
-            agtv_temp = get_agtype_value("age_vle", AG_GET_ARG_AGTYPE_P(2),
-                                         AGTV_VERTEX, false);
-            if (agtv_temp != NULL && agtv_temp->type == AGTV_VERTEX)
-            {
-                agtv_temp = GET_AGTYPE_VALUE_OBJECT_VALUE(agtv_temp, "id");
-            }
-            else if (agtv_temp == NULL || agtv_temp->type != AGTV_INTEGER)
+            backward_depth++;
+            expand_search_frontier(vlelctx, &backward_frontier, true,
+                                   backward_depth, forward_exhausted,
+                                   &shortest);
+        }
+    }
+
+    vlelctx->backward_search_depth = backward_depth;
+    vlelctx->shortest_path_length = shortest;
+
+    free_graphid_stack(forward_frontier);
+    free_graphid_stack(backward_frontier);
+    pfree(forward_frontier);
+    pfree(backward_frontier);
+
+    return (shortest >= 0);
+}
+
+/*
+ * Helper function to expand one level of a search frontier. The vertices that
+ * are reached for the first time by this side's search are given the depth as
+ * their distance and become the new frontier. If forward_only is set, vertices
+ * not already found by the forward search are ignored. Shortest is lowered to
+ * the length of any path, through a vertex reached by both searches, that is
+ * shorter. It is -1 while the searches haven't met.
+ */
+static void expand_search_frontier(VLE_local_context *vlelctx,
+                                   ListGraphId **frontier, bool backward,
+                                   int64 depth, bool forward_only,
+                                   int64 *shortest)
+{
+    ListGraphId *next_frontier = NULL;
+    cypher_rel_dir direction = vlelctx->edge_direction;
+
+    /* the backward search goes against the direction of the edges */
+    if (backward && direction == CYPHER_REL_DIR_RIGHT)
+    {
+        direction = CYPHER_REL_DIR_LEFT;
+    }
+    else if (backward && direction == CYPHER_REL_DIR_LEFT)
+    {
+        direction = CYPHER_REL_DIR_RIGHT;
+    }
+
+    next_frontier = new_graphid_stack();
+
+    while (!(IS_GRAPHID_STACK_EMPTY(*frontier)))
+    {
+        vertex_entry *ve = NULL;
+        vertex_edge_iterator iterators[2];
+        int num_iterators = 0;
+        int i;
+
+        ve = get_vertex_entry(vlelctx->ggctx, pop_graphid_stack(*frontier));
+        if (ve == NULL)
+        {
+            elog(ERROR, "expand_search_frontier: no vertex found");
+        }
+
+        /* selfloop edges are skipped as they don't get any closer */
+        if (direction == CYPHER_REL_DIR_RIGHT ||
+            direction == CYPHER_REL_DIR_NONE)
+        {
+            init_vertex_edge_iterator(vlelctx->ggctx, ve, VERTEX_EDGES_OUT,
+                                      &iterators[num_iterators++]);
+        }
+        if (direction == CYPHER_REL_DIR_LEFT ||
+            direction == CYPHER_REL_DIR_NONE)
+        {
+            init_vertex_edge_iterator(vlelctx->ggctx, ve, VERTEX_EDGES_IN,
+                                      &iterators[num_iterators++]);
+        }
+
+        for (i = 0; i < num_iterators; i++)
+        {
+            graphid edge_id;
+            graphid other_vertex_id;
+
+            while (next_vertex_edge(&iterators[i], &edge_id, &other_vertex_id))
+            {
+                vertex_distance_entry *vde = NULL;
+                int64 *distance = NULL;
+                bool found = false;
+                bool is_terminal = false;
+
+                if (!is_a_valid_edge(vlelctx, edge_id))
+                {
+                    continue;
+                }
+
+                /*
+                 * A vertex that doesn't match the intermediate vertex prototype
+                 * can only be where the paths end, for the forward search, or
+                 * where they start, for the backward search. It isn't searched
+                 * past.
+                 */
+                is_terminal = !is_a_valid_vertex(vlelctx, other_vertex_id);
+                if (is_terminal &&
+                    other_vertex_id != (backward ? vlelctx->vsid :
+                                                   vlelctx->veid))
+                {
+                    continue;
+                }
+
+                vde = hash_search(vlelctx->vertex_distance_hashtable,
+                                  (void *)&other_vertex_id,
+                                  forward_only ? HASH_FIND : HASH_ENTER,
+                                  &found);
+                if (vde == NULL)
+                {
+                    continue;
+                }
+                if (!found)
+                {
+                    vde->vertex_id = other_vertex_id;
+                    vde->forward_distance = -1;
+                    vde->backward_distance = -1;
+                }
+
+                distance = backward ? &vde->backward_distance :
+                                      &vde->forward_distance;
+
+                /* skip it if this side has already reached it */
+                if (*distance >= 0)
+                {
+                    continue;
+                }
+
+                *distance = depth;
+                if (!is_terminal)
+                {
+                    push_graphid_stack(next_frontier, other_vertex_id);
+                }
+
+                if (vde->forward_distance >= 0 && vde->backward_distance >= 0 &&
+                    (*shortest < 0 ||
+                     vde->forward_distance + vde->backward_distance <
+                     *shortest))
+                {
+                    *shortest = vde->forward_distance + vde->backward_distance;
+                }
+            }
+        }
+    }
+
+    free_graphid_stack(*frontier);
+    pfree(*frontier);
+    *frontier = next_frontier;
+}
+
+/*
+ * Helper function to check if the end vertex may still be reached, within the
+ * upper bound, from a vertex that ends a path of path_size edges. It uses the
+ * distances found by search_from_both_ends.
+ */
+static bool can_reach_end_vertex(VLE_local_context *vlelctx,
+                                 graphid vertex_id, int64 path_size)
+{
+    vertex_distance_entry *vde = NULL;
+    int64 distance;
+
+    vde = hash_search(vlelctx->vertex_distance_hashtable, (void *)&vertex_id,
+                      HASH_FIND, NULL);
+
+    if (vde != NULL && vde->backward_distance >= 0)
+    {
+        distance = vde->backward_distance;
+    }
+    /* if the backward search is complete, it can't reach the end vertex */
+    else if (vlelctx->backward_search_complete)
+    {
+        return false;
+    }
+    /* otherwise, it is further away than the backward search went */
+    else
+    {
+        distance = vlelctx->backward_search_depth + 1;
+    }
+
+    /* shortest paths can't be any longer than the shortest length */
+    if (IS_SHORTEST_PATH_MODE(vlelctx->path_mode))
+    {
+        return (path_size + distance <= vlelctx->shortest_path_length);
+    }
+
+    return (vlelctx->uidx_infinite || path_size + distance <= vlelctx->uidx);
+}
+
+/*
+ * Helper function for CYPHER_PATH_REACHABLE, to check if there is a path from
+ * the start to the end vertex within the bounds. The search from both ends
+ * stops at the first level where they meet, which gives the shortest distance
+ * between them. If that is within the lower bound, a shortest path is the
+ * path. Otherwise, the dfs looks for one long enough, stopping at the first.
+ * Either way, no path is built.
+ */
+static bool is_end_vertex_reachable(VLE_local_context *vlelctx)
+{
+    bool found = false;
+
+    /* the searches never met, or a vertex doesn't exist */
+    if (vlelctx->shortest_path_length < 0)
+    {
+        found = false;
+    }
+    else if (vlelctx->shortest_path_length >= vlelctx->lidx)
+    {
+        found = true;
+    }
+    else
+    {
+        found = dfs_find_a_path_between(vlelctx);
+    }
+
+    /* the context may be cached, so leave the dfs stacks empty */
+    clear_dfs_stacks(vlelctx);
+
+    return found;
+}
+
+/*
+ * Helper function to check that the path mode of the local VLE context can be
+ * used with its path function and bounds. Shortest paths, and reachability,
+ * are only searched for between two known vertices.
+ */
+static void check_VLE_path_mode(VLE_local_context *vlelctx)
+{
+    if (IS_SHORTEST_PATH_MODE(vlelctx->path_mode) &&
+        vlelctx->path_function != VLE_FUNCTION_PATHS_BETWEEN)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("shortest paths require a start and an end vertex")));
+    }
+    if (vlelctx->path_mode == CYPHER_PATH_REACHABLE &&
+        vlelctx->path_function != VLE_FUNCTION_PATHS_BETWEEN)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("reachability requires a start and an end vertex")));
+    }
+    if (IS_SHORTEST_PATH_MODE(vlelctx->path_mode) && vlelctx->lidx > 1)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                 errmsg("shortest paths require a lower bound of 0 or 1")));
+    }
+}
+
+/*
+ * Helper function to build the local VLE context. This is also the point
+ * where, if necessary, the global GRAPH contexts are created and freed.
+ */
+static VLE_local_context *build_local_vle_context(FunctionCallInfo fcinfo,
+                                                  FuncCallContext *funcctx)
+{
+    MemoryContext oldctx = NULL;
+    GRAPH_global_context *ggctx = NULL;
+    VLE_local_context *vlelctx = NULL;
+    agtype_value *agtv_temp = NULL;
+    agtype_value *agtv_object = NULL;
+    char *graph_name = NULL;
+    Oid graph_oid = InvalidOid;
+    int64 vle_grammar_node_id = 0;
+    bool use_cache = false;
+
+    /*
+     * Get the VLE grammar node id, if it exists. Remember, we overload the
+     * age_vle function, for now, for backwards compatability
+     */
+    if (PG_NARGS() >= 8)
+    {
+        /* get the VLE grammar node id */
+        agtv_temp = get_agtype_value("age_vle", AG_GET_ARG_AGTYPE_P(7),
+                                     AGTV_INTEGER, true);
+        vle_grammar_node_id = agtv_temp->val.int_value;
+
+        /* a cache size of 0 turns off the VLE local context cache */
+        trim_VLE_local_context_cache(age_vle_local_context_cache_size);
+        use_cache = (age_vle_local_context_cache_size > 0);
+    }
+
+    /* fetch the VLE_local_context if it is cached */
+    if (use_cache)
+    {
+        vlelctx = get_cached_VLE_local_context(vle_grammar_node_id);
+    }
+
+    /* if we are caching VLE_local_contexts and this grammar node is cached */
+    if (use_cache && vlelctx != NULL)
+    {
+        /*
+         * No context change is needed here as the cache entry is in the proper
+         * context. Additionally, all of the modifications are either pointers
+         * to objects already in the proper context or primative types that will
+         * be stored in that context since the memory is allocated there.
+         */
+
+        /*
+         * Get and update the start vertex id. Without one, the start vertices
+         * are walked again from the first.
+         */
+        if (PG_ARGISNULL(1) || is_agtype_null(AG_GET_ARG_AGTYPE_P(1)))
+        {
+            vlelctx->next_vertex_index = 0;
+            if (!get_next_start_vertex(vlelctx))
+            {
+                elog(ERROR, "age_vle: empty graph");
+            }
+        }
+        else
+        {
+            agtv_temp = get_agtype_value("age_vle", AG_GET_ARG_AGTYPE_P(1),
+                                         AGTV_VERTEX, false);
+            if (agtv_temp != NULL && agtv_temp->type == AGTV_VERTEX)
+            {
+                agtv_temp = GET_AGTYPE_VALUE_OBJECT_VALUE(agtv_temp, "id");
+            }
+            else if (agtv_temp == NULL || agtv_temp->type != AGTV_INTEGER)
+            {
+                ereport(ERROR,
+                        (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                         errmsg("start vertex argument must be a vertex or the integer id")));
+            }
+            vlelctx->vsid = agtv_temp->val.int_value;
+        }
+
+        /* get and update the end vertex id */
+        if (PG_ARGISNULL(2) || is_agtype_null(AG_GET_ARG_AGTYPE_P(2)))
+        {
+            vlelctx->veid = 0;
+        }
+        else
+        {
+            agtv_temp = get_agtype_value("age_vle", AG_GET_ARG_AGTYPE_P(2),
+                                         AGTV_VERTEX, false);
+            if (agtv_temp != NULL && agtv_temp->type == AGTV_VERTEX)
+            {
+                agtv_temp = GET_AGTYPE_VALUE_OBJECT_VALUE(agtv_temp, "id");
+            }
+            else if (agtv_temp == NULL || agtv_temp->type != AGTV_INTEGER)
             {
                 ereport(ERROR,
                         (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
@@ -574,8 +1306,31 @@ static VLE_local_context *build_local_vle_context(FunctionCallInfo fcinfo,
             }
             vlelctx->veid = agtv_temp->val.int_value;
         }
+
+        /*
+         * The end vertex id can come from a parameter, so whether there is one
+         * can change between calls. Pick the path function again.
+         */
+        if (PG_ARGISNULL(1) || is_agtype_null(AG_GET_ARG_AGTYPE_P(1)))
+        {
+            vlelctx->path_function = (vlelctx->veid != 0) ?
+                                     VLE_FUNCTION_PATHS_TO :
+                                     VLE_FUNCTION_PATHS_ALL;
+        }
+        else
+        {
+            vlelctx->path_function = (vlelctx->veid != 0) ?
+                                     VLE_FUNCTION_PATHS_BETWEEN :
+                                     VLE_FUNCTION_PATHS_FROM;
+        }
         vlelctx->is_dirty = true;
 
+        /* the path function may no longer suit the path mode */
+        check_VLE_path_mode(vlelctx);
+
+        /* work_mem may have changed since the context was cached */
+        set_dfs_stack_mem_limits(vlelctx);
+
         /* we need the SRF context to add in the edges to the stacks */
         oldctx = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
 
@@ -634,32 +1389,28 @@ static VLE_local_context *build_local_vle_context(FunctionCallInfo fcinfo,
 
     /* set the global context referenced by this local VLE context */
     vlelctx->ggctx = ggctx;
+    vlelctx->ggctx_version = get_ggctx_version(ggctx);
 
     /* initialize the path function */
     vlelctx->path_function = VLE_FUNCTION_PATHS_BETWEEN;
 
-    /* initialize the next vertex, in this case the first */
-    vlelctx->next_vertex = peek_stack_head(get_graph_vertices(ggctx));
+    /* initialize the next vertex, in this case the first, as the start */
+    vlelctx->next_vertex_index = 0;
 
     /* if there isn't one, the graph is empty */
-    if (vlelctx->next_vertex == NULL)
+    if (!get_next_start_vertex(vlelctx))
     {
         elog(ERROR, "age_vle: empty graph");
     }
     /*
      * Get the start vertex id - this is an optional parameter and determines
      * which path function is used. If a start vertex isn't provided, we
-     * retrieve them incrementally from the vertices list.
+     * retrieve them incrementally, by dense vertex index.
      */
     if (PG_ARGISNULL(1) || is_agtype_null(AG_GET_ARG_AGTYPE_P(1)))
     {
-        /* set _TO */
+        /* set _TO, starting with the first vertex */
         vlelctx->path_function = VLE_FUNCTION_PATHS_TO;
-
-        /* get the start vertex */
-        vlelctx->vsid = get_graphid(vlelctx->next_vertex);
-        /* increment to the next vertex */
-        vlelctx->next_vertex = next_GraphIdNode(vlelctx->next_vertex);
     }
     else
     {
@@ -708,7 +1459,11 @@ static VLE_local_context *build_local_vle_context(FunctionCallInfo fcinfo,
                     (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
                      errmsg("end vertex argument must be a vertex or the integer id")));
         }
-        vlelctx->path_function = VLE_FUNCTION_PATHS_BETWEEN;
+        /* without a start vertex, every vertex is walked to the end vertex */
+        if (vlelctx->path_function != VLE_FUNCTION_PATHS_TO)
+        {
+            vlelctx->path_function = VLE_FUNCTION_PATHS_BETWEEN;
+        }
         vlelctx->veid = agtv_temp->val.int_value;
     }
 
@@ -720,18 +1475,38 @@ static VLE_local_context *build_local_vle_context(FunctionCallInfo fcinfo,
     agtv_object = GET_AGTYPE_VALUE_OBJECT_VALUE(agtv_temp, "properties");
     /* store the properties as an agtype */
     vlelctx->edge_property_constraint = agtype_value_to_agtype(agtv_object);
+    /* and compile them into predicates */
+    vlelctx->edge_property_predicates = compile_property_constraint(
+        vlelctx->edge_property_constraint,
+        &vlelctx->num_edge_property_predicates);
 
-    /* get the edge prototype's label name */
+    /* get the edge prototype's label */
     agtv_temp = GET_AGTYPE_VALUE_OBJECT_VALUE(agtv_temp, "label");
-    if (agtv_temp->type == AGTV_STRING &&
-        agtv_temp->val.string.len != 0)
-    {
-        vlelctx->edge_label_name = pnstrdup(agtv_temp->val.string.val,
-                                            agtv_temp->val.string.len);
-    }
-    else
+    get_prototype_label(agtv_temp, graph_oid, &vlelctx->has_edge_label,
+                        &vlelctx->edge_label_id);
+
+    /* get the intermediate vertex prototype, if it exists */
+    vlelctx->has_vertex_constraint = false;
+    vlelctx->has_vertex_label = false;
+    vlelctx->vertex_label_id = INVALID_LABEL_ID;
+    if (PG_NARGS() >= 11 && !PG_ARGISNULL(10) &&
+        !is_agtype_null(AG_GET_ARG_AGTYPE_P(10)))
     {
-        vlelctx->edge_label_name = NULL;
+        agtv_temp = get_agtype_value("age_vle", AG_GET_ARG_AGTYPE_P(10),
+                                     AGTV_VERTEX, true);
+
+        agtv_object = GET_AGTYPE_VALUE_OBJECT_VALUE(agtv_temp, "properties");
+        vlelctx->vertex_property_constraint =
+            agtype_value_to_agtype(agtv_object);
+        vlelctx->vertex_property_predicates = compile_property_constraint(
+            vlelctx->vertex_property_constraint,
+            &vlelctx->num_vertex_property_predicates);
+
+        agtv_temp = GET_AGTYPE_VALUE_OBJECT_VALUE(agtv_temp, "label");
+        get_prototype_label(agtv_temp, graph_oid, &vlelctx->has_vertex_label,
+                            &vlelctx->vertex_label_id);
+
+        vlelctx->has_vertex_constraint = true;
     }
 
     /* get the left range index */
@@ -764,20 +1539,58 @@ static VLE_local_context *build_local_vle_context(FunctionCallInfo fcinfo,
                                  AGTV_INTEGER, true);
     vlelctx->edge_direction = agtv_temp->val.int_value;
 
+    /* get the path mode, if it exists */
+    if (PG_NARGS() >= 9 && !PG_ARGISNULL(8))
+    {
+        agtv_temp = get_agtype_value("age_vle", AG_GET_ARG_AGTYPE_P(8),
+                                     AGTV_INTEGER, true);
+        vlelctx->path_mode = agtv_temp->val.int_value;
+    }
+    else
+    {
+        vlelctx->path_mode = CYPHER_PATH_ALL;
+    }
+    vlelctx->shortest_path_length = -1;
+
+    /* check that the path mode can be used with the path function */
+    check_VLE_path_mode(vlelctx);
+
     /* create the local state hashtable */
     create_VLE_local_state_hashtable(vlelctx);
 
-    /* initialize the dfs stacks */
+    /* the vertex property matches are kept too, if they are needed */
+    if (vlelctx->num_vertex_property_predicates > 0)
+    {
+        HASHCTL vertex_state_ctl;
+
+        MemSet(&vertex_state_ctl, 0, sizeof(vertex_state_ctl));
+        vertex_state_ctl.keysize = sizeof(int64);
+        vertex_state_ctl.entrysize = sizeof(vertex_state_entry);
+        vertex_state_ctl.hash = tag_hash;
+        vlelctx->vertex_state_hashtable =
+            hash_create(VERTEX_STATE_HTAB_NAME, VERTEX_STATE_HTAB_INITIAL_SIZE,
+                        &vertex_state_ctl, HASH_ELEM | HASH_FUNCTION);
+    }
+
+    /*
+     * Initialize the dfs stacks. The vertex and edge stacks hold the frontier
+     * of the search, which can grow much larger than the path. So, they spill
+     * to disk beyond work_mem, which they share.
+     */
     vlelctx->dfs_vertex_stack = new_graphid_stack();
     vlelctx->dfs_edge_stack = new_graphid_stack();
     vlelctx->dfs_path_stack = new_graphid_stack();
+    set_dfs_stack_mem_limits(vlelctx);
+
+    /* and the set of edges in the path */
+    vlelctx->path_edge_set_size = PATH_EDGE_SET_INITIAL_SIZE;
+    vlelctx->path_edge_set = palloc0(sizeof(graphid) *
+                                     PATH_EDGE_SET_INITIAL_SIZE);
+    vlelctx->path_edge_set_count = 0;
 
     /* load in the starting edge(s) */
     load_initial_dfs_stacks(vlelctx);
 
-    /* this is a new one so nothing follows it */
-    vlelctx->next = NULL;
-
     /* mark as dirty */
     vlelctx->is_dirty = true;
 
@@ -813,7 +1626,6 @@ static edge_state_entry *get_edge_state(VLE_local_context *vlelctx,
     {
         /* the edge id is also the hash key for resolving collisions */
         ese->edge_id = edge_id;
-        ese->used_in_path = false;
         ese->has_been_matched = false;
         ese->matched = false;
     }
@@ -875,6 +1687,31 @@ static graphid get_next_vertex(VLE_local_context *vlelctx, edge_entry *ee)
     return terminal_vertex_id;
 }
 
+/*
+ * Helper function to get the next start vertex, by dense vertex index, for the
+ * path functions that walk every vertex. Deleted vertices are skipped. It
+ * returns false if there aren't any left.
+ */
+static bool get_next_start_vertex(VLE_local_context *vlelctx)
+{
+    uint32 num_vertex_indexes = get_ggctx_num_vertex_indexes(vlelctx->ggctx);
+
+    while (vlelctx->next_vertex_index < num_vertex_indexes)
+    {
+        vertex_entry *ve = NULL;
+
+        ve = get_vertex_entry_by_index(vlelctx->ggctx,
+                                       vlelctx->next_vertex_index++);
+        if (ve != NULL)
+        {
+            vlelctx->vsid = get_vertex_entry_id(ve);
+            return true;
+        }
+    }
+
+    return false;
+}
+
 /*
  * Helper function to find one path BETWEEN two vertices.
  *
@@ -893,6 +1730,9 @@ static bool dfs_find_a_path_between(VLE_local_context *vlelctx)
     ListGraphId *edge_stack = NULL;
     ListGraphId *path_stack = NULL;
     graphid end_vertex_id;
+    int64 lidx;
+    int64 uidx;
+    bool uidx_infinite;
 
     Assert(vlelctx != NULL);
 
@@ -901,29 +1741,44 @@ static bool dfs_find_a_path_between(VLE_local_context *vlelctx)
     edge_stack = vlelctx->dfs_edge_stack;
     path_stack = vlelctx->dfs_path_stack;
     end_vertex_id = vlelctx->veid;
+    lidx = vlelctx->lidx;
+    uidx = vlelctx->uidx;
+    uidx_infinite = vlelctx->uidx_infinite;
+
+    /* shortest paths are exactly as long as the shortest length */
+    if (IS_SHORTEST_PATH_MODE(vlelctx->path_mode))
+    {
+        /* shortestPath() is done once it has returned its path */
+        if (vlelctx->path_mode == CYPHER_PATH_SHORTEST &&
+            !(IS_GRAPHID_STACK_EMPTY(path_stack)))
+        {
+            clear_dfs_stacks(vlelctx);
+            return false;
+        }
+
+        lidx = vlelctx->shortest_path_length;
+        uidx = vlelctx->shortest_path_length;
+        uidx_infinite = false;
+    }
 
     /* while we have edges to process */
     while (!(IS_GRAPHID_STACK_EMPTY(edge_stack)))
     {
         graphid edge_id;
         graphid next_vertex_id;
-        edge_state_entry *ese = NULL;
         edge_entry *ee = NULL;
         bool found = false;
 
         /* get an edge, but leave it on the stack for now */
         edge_id = PEEK_GRAPHID_STACK(edge_stack);
-        /* get the edge's state */
-        ese = get_edge_state(vlelctx, edge_id);
         /*
-         * If the edge is already in use, it means that the edge is in the path.
-         * So, we need to see if it is the last path entry (we are backing up -
-         * we need to remove the edge from the path stack and reset its state
+         * If the edge is in the path, we need to see if it is the last path
+         * entry (we are backing up - we need to remove the edge from the path
          * and from the edge stack as we are done with it) or an interior edge
          * in the path (loop - we need to remove the edge from the edge stack
          * and start with the next edge).
          */
-        if (ese->used_in_path)
+        if (is_edge_in_path(vlelctx, edge_id))
         {
             graphid path_edge_id;
 
@@ -931,12 +1786,11 @@ static bool dfs_find_a_path_between(VLE_local_context *vlelctx)
             path_edge_id = PEEK_GRAPHID_STACK(path_stack);
             /*
              * If the ids are the same, we're backing up. So, remove it from the
-             * path stack and reset used_in_path.
+             * path.
              */
             if (edge_id == path_edge_id)
             {
-                pop_graphid_stack(path_stack);
-                ese->used_in_path = false;
+                pop_path_edge(vlelctx);
             }
             /* now remove it from the edge stack */
             pop_graphid_stack(edge_stack);
@@ -955,11 +1809,10 @@ static bool dfs_find_a_path_between(VLE_local_context *vlelctx)
         }
 
         /*
-         * Mark it and push it on the path stack. There is no need to push it on
-         * the edge stack as it is already there.
+         * Add it to the path. There is no need to push it on the edge stack as
+         * it is already there.
          */
-        ese->used_in_path = true;
-        push_graphid_stack(path_stack, edge_id);
+        push_path_edge(vlelctx, edge_id);
 
         /* now get the edge entry so we can get the next vertex to move to */
         ee = get_edge_entry(vlelctx->ggctx, edge_id);
@@ -970,9 +1823,8 @@ static bool dfs_find_a_path_between(VLE_local_context *vlelctx)
          * within the bounds specified?
          */
         if (next_vertex_id == end_vertex_id &&
-            get_stack_size(path_stack) >= vlelctx->lidx &&
-            (vlelctx->uidx_infinite ||
-             get_stack_size(path_stack) <= vlelctx->uidx))
+            get_stack_size(path_stack) >= lidx &&
+            (uidx_infinite || get_stack_size(path_stack) <= uidx))
         {
             /* we found one */
             found = true;
@@ -983,15 +1835,14 @@ static bool dfs_find_a_path_between(VLE_local_context *vlelctx)
          * the graph if we aren't within our lower bounds, though.
          */
         if (next_vertex_id == end_vertex_id &&
-            !vlelctx->uidx_infinite &&
-            get_stack_size(path_stack) > vlelctx->uidx)
+            !uidx_infinite &&
+            get_stack_size(path_stack) > uidx)
         {
             continue;
         }
 
         /* add in the edges for the next vertex if we won't exceed the bounds */
-        if (vlelctx->uidx_infinite ||
-            get_stack_size(path_stack) < vlelctx->uidx)
+        if (uidx_infinite || get_stack_size(path_stack) < uidx)
         {
             add_valid_vertex_edges(vlelctx, next_vertex_id);
         }
@@ -1035,23 +1886,19 @@ static bool dfs_find_a_path_from(VLE_local_context *vlelctx)
     {
         graphid edge_id;
         graphid next_vertex_id;
-        edge_state_entry *ese = NULL;
         edge_entry *ee = NULL;
         bool found = false;
 
         /* get an edge, but leave it on the stack for now */
         edge_id = PEEK_GRAPHID_STACK(edge_stack);
-        /* get the edge's state */
-        ese = get_edge_state(vlelctx, edge_id);
         /*
-         * If the edge is already in use, it means that the edge is in the path.
-         * So, we need to see if it is the last path entry (we are backing up -
-         * we need to remove the edge from the path stack and reset its state
+         * If the edge is in the path, we need to see if it is the last path
+         * entry (we are backing up - we need to remove the edge from the path
          * and from the edge stack as we are done with it) or an interior edge
          * in the path (loop - we need to remove the edge from the edge stack
          * and start with the next edge).
          */
-        if (ese->used_in_path)
+        if (is_edge_in_path(vlelctx, edge_id))
         {
             graphid path_edge_id;
 
@@ -1059,12 +1906,11 @@ static bool dfs_find_a_path_from(VLE_local_context *vlelctx)
             path_edge_id = PEEK_GRAPHID_STACK(path_stack);
             /*
              * If the ids are the same, we're backing up. So, remove it from the
-             * path stack and reset used_in_path.
+             * path.
              */
             if (edge_id == path_edge_id)
             {
-                pop_graphid_stack(path_stack);
-                ese->used_in_path = false;
+                pop_path_edge(vlelctx);
             }
             /* now remove it from the edge stack */
             pop_graphid_stack(edge_stack);
@@ -1083,11 +1929,10 @@ static bool dfs_find_a_path_from(VLE_local_context *vlelctx)
         }
 
         /*
-         * Mark it and push it on the path stack. There is no need to push it on
-         * the edge stack as it is already there.
+         * Add it to the path. There is no need to push it on the edge stack as
+         * it is already there.
          */
-        ese->used_in_path = true;
-        push_graphid_stack(path_stack, edge_id);
+        push_path_edge(vlelctx, edge_id);
 
         /* now get the edge entry so we can get the next vertex to move to */
         ee = get_edge_entry(vlelctx->ggctx, edge_id);
@@ -1122,30 +1967,136 @@ static bool dfs_find_a_path_from(VLE_local_context *vlelctx)
 }
 
 /*
- * Helper routine to quickly check if an edge_id is in the path stack. It is
- * only meant as a quick check to avoid doing a much more costly hash search for
- * smaller sized lists. But, it is O(n) so it should only be used for small
- * path_stacks and where appropriate.
+ * Helper function to split work_mem between the dfs vertex and edge stacks.
+ * The vertex stack is only used when the edges have no direction, so it only
+ * gets half of it then.
  */
-static bool is_edge_in_path(VLE_local_context *vlelctx, graphid edge_id)
+static void set_dfs_stack_mem_limits(VLE_local_context *vlelctx)
 {
-    GraphIdNode *edge = NULL;
-
-    /* start at the top of the stack */
-    edge = peek_stack_head(vlelctx->dfs_path_stack);
+    int edge_mem_limit = work_mem;
 
-    /* go through the path stack, return true if we find the edge */
-    while (edge != NULL)
+    if (vlelctx->edge_direction == CYPHER_REL_DIR_NONE)
+    {
+        edge_mem_limit = work_mem / 2;
+    }
+
+    set_graphid_stack_mem_limit(vlelctx->dfs_edge_stack, edge_mem_limit);
+    set_graphid_stack_mem_limit(vlelctx->dfs_vertex_stack,
+                                work_mem - edge_mem_limit);
+}
+
+/* helper function to empty the dfs stacks and the path edge set */
+static void clear_dfs_stacks(VLE_local_context *vlelctx)
+{
+    /*
+     * Free the stacks' nodes all at once. This also releases the chunks they
+     * were allocated in, which may be in the SRF's memory context.
+     */
+    free_graphid_stack(vlelctx->dfs_path_stack);
+    free_graphid_stack(vlelctx->dfs_edge_stack);
+    free_graphid_stack(vlelctx->dfs_vertex_stack);
+
+    MemSet(vlelctx->path_edge_set, 0,
+           sizeof(graphid) * vlelctx->path_edge_set_size);
+    vlelctx->path_edge_set_count = 0;
+}
+
+/* helper function to check if an edge_id is in the path, in constant time */
+static bool is_edge_in_path(VLE_local_context *vlelctx, graphid edge_id)
+{
+    return (vlelctx->path_edge_set[get_path_edge_slot(vlelctx, edge_id)] ==
+            edge_id);
+}
+
+/*
+ * Helper function to find the slot of the path edge set that holds the edge,
+ * or the empty slot where it would go. The set uses linear probing and is
+ * never more than half full.
+ */
+static uint32 get_path_edge_slot(VLE_local_context *vlelctx, graphid edge_id)
+{
+    uint32 mask = vlelctx->path_edge_set_size - 1;
+    uint32 slot;
+
+    slot = PATH_EDGE_HASH(edge_id) & mask;
+
+    while (vlelctx->path_edge_set[slot] != 0 &&
+           vlelctx->path_edge_set[slot] != edge_id)
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+/* helper function to double the size of the path edge set */
+static void grow_path_edge_set(VLE_local_context *vlelctx)
+{
+    graphid *old_set = vlelctx->path_edge_set;
+    uint32 old_size = vlelctx->path_edge_set_size;
+    uint32 i;
+
+    /* keep it in the same memory context as the VLE local context */
+    vlelctx->path_edge_set_size = old_size * 2;
+    vlelctx->path_edge_set = MemoryContextAllocZero(
+        GetMemoryChunkContext(old_set),
+        sizeof(graphid) * vlelctx->path_edge_set_size);
+
+    for (i = 0; i < old_size; i++)
     {
-        if (get_graphid(edge) == edge_id)
+        if (old_set[i] != 0)
         {
-            return true;
+            vlelctx->path_edge_set[get_path_edge_slot(vlelctx, old_set[i])] =
+                old_set[i];
         }
-        /* get the next stack element */
-        edge = next_GraphIdNode(edge);
     }
-    /* we didn't find it if we get here */
-    return false;
+
+    pfree(old_set);
+}
+
+/* helper function to add an edge to the end of the path */
+static void push_path_edge(VLE_local_context *vlelctx, graphid edge_id)
+{
+    if ((vlelctx->path_edge_set_count + 1) * 2 > vlelctx->path_edge_set_size)
+    {
+        grow_path_edge_set(vlelctx);
+    }
+
+    push_graphid_stack(vlelctx->dfs_path_stack, edge_id);
+    vlelctx->path_edge_set[get_path_edge_slot(vlelctx, edge_id)] = edge_id;
+    vlelctx->path_edge_set_count++;
+}
+
+/*
+ * Helper function to remove the edge at the end of the path. The entries
+ * following its slot are shifted back, so that no tombstones are needed.
+ */
+static void pop_path_edge(VLE_local_context *vlelctx)
+{
+    graphid *set = vlelctx->path_edge_set;
+    uint32 mask = vlelctx->path_edge_set_size - 1;
+    graphid edge_id;
+    uint32 hole;
+    uint32 slot;
+
+    edge_id = pop_graphid_stack(vlelctx->dfs_path_stack);
+    hole = get_path_edge_slot(vlelctx, edge_id);
+    Assert(set[hole] == edge_id);
+
+    for (slot = (hole + 1) & mask; set[slot] != 0; slot = (slot + 1) & mask)
+    {
+        uint32 home = PATH_EDGE_HASH(set[slot]) & mask;
+
+        /* move it into the hole, unless its home is after the hole */
+        if (((slot - home) & mask) >= ((slot - hole) & mask))
+        {
+            set[hole] = set[slot];
+            hole = slot;
+        }
+    }
+
+    set[hole] = 0;
+    vlelctx->path_edge_set_count--;
 }
 
 /*
@@ -1154,7 +2105,12 @@ static bool is_edge_in_path(VLE_local_context *vlelctx, graphid edge_id)
  *
  *     1) Edge matches the correct direction specified.
  *     2) Edge is not currently in the path.
- *     3) Edge matches minimum edge properties specified.
+ *     3) Edge can still lead to the end vertex, for PATHS_BETWEEN.
+ *     4) Edge matches the label and minimum edge properties specified.
+ *
+ * The vertex itself must match the intermediate vertex prototype, if there is
+ * one, unless it is the start vertex. Otherwise, no edges are added and the
+ * paths through it are pruned.
  *
  * Note: The vertex must exist.
  */
@@ -1163,11 +2119,11 @@ static void add_valid_vertex_edges(VLE_local_context *vlelctx,
 {
     ListGraphId *vertex_stack = NULL;
     ListGraphId *edge_stack = NULL;
-    ListGraphId *edges = NULL;
     vertex_entry *ve = NULL;
-    GraphIdNode *edge_in = NULL;
-    GraphIdNode *edge_out = NULL;
-    GraphIdNode *edge_self = NULL;
+    vertex_edge_iterator iterators[3];
+    int num_iterators = 0;
+    int64 path_size;
+    int i;
 
     /* get the vertex entry */
     ve = get_vertex_entry(vlelctx->ggctx, vertex_id);
@@ -1180,126 +2136,222 @@ static void add_valid_vertex_edges(VLE_local_context *vlelctx,
     /* point to stacks */
     vertex_stack = vlelctx->dfs_vertex_stack;
     edge_stack = vlelctx->dfs_edge_stack;
+    path_size = get_stack_size(vlelctx->dfs_path_stack);
+
+    /* any vertex reached by an edge is an intermediate vertex past here */
+    if (path_size > 0 && !is_a_valid_vertex(vlelctx, vertex_id))
+    {
+        return;
+    }
 
-    /* set to the first edge for each edge list for the specified direction */
+    /* set up an iterator for each edge list for the specified direction */
     if (vlelctx->edge_direction == CYPHER_REL_DIR_RIGHT ||
         vlelctx->edge_direction == CYPHER_REL_DIR_NONE)
     {
-        edges = get_vertex_entry_edges_out(ve);
-        edge_out = (edges != NULL) ? get_list_head(edges) : NULL;
+        init_vertex_edge_iterator(vlelctx->ggctx, ve, VERTEX_EDGES_OUT,
+                                  &iterators[num_iterators++]);
     }
     if (vlelctx->edge_direction == CYPHER_REL_DIR_LEFT ||
         vlelctx->edge_direction == CYPHER_REL_DIR_NONE)
     {
-        edges = get_vertex_entry_edges_in(ve);
-        edge_in = (edges != NULL) ? get_list_head(edges) : NULL;
+        init_vertex_edge_iterator(vlelctx->ggctx, ve, VERTEX_EDGES_IN,
+                                  &iterators[num_iterators++]);
     }
-    /* set to the first selfloop edge */
-    edges = get_vertex_entry_edges_self(ve);
-    edge_self = (edges != NULL) ? get_list_head(edges) : NULL;
+    /* and for the selfloop edges */
+    init_vertex_edge_iterator(vlelctx->ggctx, ve, VERTEX_EDGES_SELF,
+                              &iterators[num_iterators++]);
 
     /* add in valid vertex edges */
-    while (edge_out != NULL || edge_in != NULL || edge_self != NULL)
+    for (i = 0; i < num_iterators; i++)
     {
-        edge_entry *ee = NULL;
-        edge_state_entry *ese = NULL;
         graphid edge_id;
+        graphid other_vertex_id;
 
-        /* get the edge_id from the next available edge*/
-        if (edge_out != NULL)
-        {
-            edge_id = get_graphid(edge_out);
-        }
-        else if (edge_in != NULL)
-        {
-            edge_id = get_graphid(edge_in);
-        }
-        else
-        {
-            edge_id = get_graphid(edge_self);
-        }
-
-        /*
-         * This is a fast existence check, relative to the hash search, for when
-         * the path stack is small. If the edge is in the path, we skip it.
-         */
-        if (get_stack_size(vlelctx->dfs_path_stack) < 10 &&
-            is_edge_in_path(vlelctx, edge_id))
+        while (next_vertex_edge(&iterators[i], &edge_id, &other_vertex_id))
         {
-            /* set to the next available edge */
-            if (edge_out != NULL)
+            /*
+             * Don't add any edges that are in the path because they will cause
+             * a loop to form.
+             */
+            if (is_edge_in_path(vlelctx, edge_id))
             {
-                edge_out = next_GraphIdNode(edge_out);
+                continue;
             }
-            else if (edge_in != NULL)
+
+            /*
+             * Don't add edges that lead to vertices from which the end vertex
+             * can't be reached within the upper bound.
+             */
+            if ((vlelctx->path_function == VLE_FUNCTION_PATHS_BETWEEN ||
+                 vlelctx->path_function == VLE_FUNCTION_PATHS_TO) &&
+                !can_reach_end_vertex(vlelctx, other_vertex_id, path_size + 1))
             {
-                edge_in = next_GraphIdNode(edge_in);
+                continue;
             }
-            else
+
+            /* if it is a match, add it */
+            if (is_a_valid_edge(vlelctx, edge_id))
             {
-                edge_self = next_GraphIdNode(edge_self);
+                /*
+                 * We need to maintain our source vertex for each edge added if
+                 * the edge_direction is CYPHER_REL_DIR_NONE. This is due to the
+                 * edges having a fixed direction and the dfs algorithm working
+                 * strictly through edges. With an un-directional VLE edge, you
+                 * don't know the vertex that you just came from. So, we need to
+                 * store it.
+                 */
+                if (vlelctx->edge_direction == CYPHER_REL_DIR_NONE)
+                {
+                    push_graphid_stack(vertex_stack, get_vertex_entry_id(ve));
+                }
+                push_graphid_stack(edge_stack, edge_id);
             }
-            continue;
         }
+    }
+}
+
+/*
+ * Helper function to check if an edge matches the label and properties
+ * specified. The result is kept in the edge state hashtable so that each edge
+ * is only matched once.
+ */
+static bool is_a_valid_edge(VLE_local_context *vlelctx, graphid edge_id)
+{
+    edge_entry *ee = NULL;
+    edge_state_entry *ese = NULL;
 
+    /* skip edges with the wrong label, without looking them up */
+    if (!is_an_edge_label_match(vlelctx, edge_id))
+    {
+        return false;
+    }
+
+    /* get its state */
+    ese = get_edge_state(vlelctx, edge_id);
+
+    /* validate the edge if it hasn't been already */
+    if (!ese->has_been_matched)
+    {
         /* get the edge entry */
         ee = get_edge_entry(vlelctx->ggctx, edge_id);
         /* it better exist */
         if (ee == NULL)
         {
-            elog(ERROR, "add_valid_vertex_edges: no edge found");
-        }
-        /* get its state */
-        ese = get_edge_state(vlelctx, edge_id);
-        /*
-         * Don't add any edges that we have already seen because they will
-         * cause a loop to form.
-         */
-        if (!ese->used_in_path)
-        {
-            /* validate the edge if it hasn't been already */
-            if (!ese->has_been_matched && is_an_edge_match(vlelctx, ee))
-            {
-                ese->has_been_matched = true;
-                ese->matched = true;
-            }
-            else if (!ese->has_been_matched)
-            {
-                ese->has_been_matched = true;
-                ese->matched = false;
-            }
-            /* if it is a match, add it */
-            if (ese->has_been_matched && ese->matched)
-            {
-                /*
-                 * We need to maintain our source vertex for each edge added
-                 * if the edge_direction is CYPHER_REL_DIR_NONE. This is due
-                 * to the edges having a fixed direction and the dfs
-                 * algorithm working strictly through edges. With an
-                 * un-directional VLE edge, you don't know the vertex that
-                 * you just came from. So, we need to store it.
-                 */
-                 if (vlelctx->edge_direction == CYPHER_REL_DIR_NONE)
-                 {
-                     push_graphid_stack(vertex_stack, get_vertex_entry_id(ve));
-                 }
-                 push_graphid_stack(edge_stack, edge_id);
-            }
-        }
-        /* get the next working edge */
-        if (edge_out != NULL)
-        {
-            edge_out = next_GraphIdNode(edge_out);
-        }
-        else if (edge_in != NULL)
-        {
-            edge_in = next_GraphIdNode(edge_in);
+            elog(ERROR, "is_a_valid_edge: no edge found");
         }
-        else
+
+        ese->matched = is_an_edge_match(vlelctx, ee);
+        ese->has_been_matched = true;
+    }
+
+    return ese->matched;
+}
+
+/*
+ * Helper function to check if a vertex matches the intermediate vertex
+ * prototype. The label is checked by the vertex id. Property matches are kept
+ * in the vertex state hashtable so that each vertex is only matched once.
+ */
+static bool is_a_valid_vertex(VLE_local_context *vlelctx, graphid vertex_id)
+{
+    vertex_state_entry *vse = NULL;
+    bool found = false;
+
+    /* if there isn't a vertex prototype, every vertex matches */
+    if (!vlelctx->has_vertex_constraint)
+    {
+        return true;
+    }
+
+    if (vlelctx->has_vertex_label &&
+        GET_LABEL_ID(vertex_id) != vlelctx->vertex_label_id)
+    {
+        return false;
+    }
+
+    if (vlelctx->num_vertex_property_predicates == 0)
+    {
+        return true;
+    }
+
+    vse = hash_search(vlelctx->vertex_state_hashtable, (void *)&vertex_id,
+                      HASH_ENTER, &found);
+    if (!found)
+    {
+        vertex_entry *ve = NULL;
+
+        ve = get_vertex_entry(vlelctx->ggctx, vertex_id);
+        /* it better exist */
+        if (ve == NULL)
         {
-            edge_self = next_GraphIdNode(edge_self);
+            elog(ERROR, "is_a_valid_vertex: no vertex found");
         }
+
+        vse->vertex_id = vertex_id;
+        vse->matched = is_a_vertex_property_match(vlelctx, ve);
+    }
+
+    return vse->matched;
+}
+
+/*
+ * Helper function to compare the vertex property constraint against a vertex
+ * entry's properties. Extra unmatched properties don't matter.
+ */
+static bool is_a_vertex_property_match(VLE_local_context *vlelctx,
+                                       vertex_entry *ve)
+{
+    Datum vertex_properties;
+    agtype_container *agtc_vertex_property = NULL;
+    bool is_match = true;
+    int i;
+
+    vertex_properties = get_vertex_entry_properties(ve);
+    agtc_vertex_property = &DATUM_GET_AGTYPE_P(vertex_properties)->root;
+
+    /* it needs at least as many pairs as there are predicates */
+    if (vlelctx->num_vertex_property_predicates >
+        AGTYPE_CONTAINER_SIZE(agtc_vertex_property))
+    {
+        is_match = false;
+    }
+
+    for (i = 0; i < vlelctx->num_vertex_property_predicates && is_match; i++)
+    {
+        is_match = is_a_property_match(&vlelctx->vertex_property_predicates[i],
+                                       agtc_vertex_property);
+    }
+
+    free_vertex_entry_properties(ve, vertex_properties);
+
+    return is_match;
+}
+
+/*
+ * Helper function to resolve the label of an edge or vertex prototype, once,
+ * so that edges and vertices can be checked by the label id in their ids. No
+ * entity can match a label that doesn't exist.
+ */
+static void get_prototype_label(agtype_value *agtv_label, Oid graph_oid,
+                                bool *has_label, int32 *label_id)
+{
+    char *label_name = NULL;
+    label_cache_data *label = NULL;
+
+    if (agtv_label->type != AGTV_STRING || agtv_label->val.string.len == 0)
+    {
+        *has_label = false;
+        *label_id = INVALID_LABEL_ID;
+        return;
     }
+
+    label_name = pnstrdup(agtv_label->val.string.val,
+                          agtv_label->val.string.len);
+    label = search_label_name_graph_cache(label_name, graph_oid);
+    pfree(label_name);
+
+    *has_label = true;
+    *label_id = (label != NULL) ? label->id : INVALID_LABEL_ID;
 }
 
 /*
@@ -1480,18 +2532,12 @@ static agtype_value *build_edge_list(VLE_path_container *vpc)
 {
     GRAPH_global_context *ggctx = NULL;
     agtype_in_state edges_result;
-    Oid graph_oid = InvalidOid;
     graphid *graphid_array = NULL;
     int64 graphid_array_size = 0;
     int index = 0;
 
-    /* get the graph_oid */
-    graph_oid = vpc->graph_oid;
-
     /* get the GRAPH global context for this graph */
-    ggctx = find_GRAPH_global_context(graph_oid);
-    /* verify we got a global context */
-    Assert(ggctx != NULL);
+    ggctx = get_VLE_path_container_ggctx(vpc);
 
     /* get the graphid_array and size */
     graphid_array = GET_GRAPHID_ARRAY_FROM_CONTAINER(vpc);
@@ -1544,18 +2590,12 @@ static agtype_value *build_path(VLE_path_container *vpc)
 {
     GRAPH_global_context *ggctx = NULL;
     agtype_in_state path_result;
-    Oid graph_oid = InvalidOid;
     graphid *graphid_array = NULL;
     int64 graphid_array_size = 0;
     int index = 0;
 
-    /* get the graph_oid */
-    graph_oid = vpc->graph_oid;
-
     /* get the GRAPH global context for this graph */
-    ggctx = find_GRAPH_global_context(graph_oid);
-    /* verify we got a global context */
-    Assert(ggctx != NULL);
+    ggctx = get_VLE_path_container_ggctx(vpc);
 
     /* get the graphid_array and size */
     graphid_array = GET_GRAPHID_ARRAY_FROM_CONTAINER(vpc);
@@ -1620,6 +2660,37 @@ static agtype_value *build_path(VLE_path_container *vpc)
     return path_result.res;
 }
 
+/*
+ * Helper function to get the GRAPH global context of the graph a path was
+ * found in. A path found by a parallel worker may be materialized by the
+ * leader, which won't have needed the context yet. In that case, it is
+ * created here. The planner only runs age_vle in parallel workers when the
+ * GRAPH global contexts are shared, so the leader then attaches to the same
+ * shared image as the workers.
+ */
+static GRAPH_global_context *get_VLE_path_container_ggctx(
+    VLE_path_container *vpc)
+{
+    GRAPH_global_context *ggctx = NULL;
+    graph_cache_data *graph = NULL;
+
+    ggctx = find_GRAPH_global_context(vpc->graph_oid);
+    if (ggctx != NULL)
+    {
+        return ggctx;
+    }
+
+    /* the graph oid is also the oid of its namespace */
+    graph = search_graph_namespace_cache(vpc->graph_oid);
+    if (graph == NULL)
+    {
+        elog(ERROR, "graph with oid %u does not exist", vpc->graph_oid);
+    }
+
+    return manage_GRAPH_global_contexts(NameStr(graph->name),
+                                        vpc->graph_oid);
+}
+
 /*
  * All front facing PG and exposed functions below
  */
@@ -1651,6 +2722,17 @@ static agtype_value *build_path(VLE_path_container *vpc)
  *     5 - agtype OPTIONAL uidx (upper range index)
  *                 Note: A NULL is appropriate here for an infinite upper bound.
  *     6 - agtype REQUIRED edge direction (enum) as an integer. REQUIRED
+ *     7 - agtype OPTIONAL VLE grammar node id, for caching the local context
+ *     8 - agtype OPTIONAL path mode (cypher_path_mode) as an integer
+ *                 Note: The shortest path and reachability modes require
+ *                       both the start and the end vertex. A reachability
+ *                       search returns a single true if there is a path.
+ *     9 - agtype OPTIONAL row bound as an integer
+ *                 Note: This is added by the planner from a LIMIT, when
+ *                       every row returned is a row of the result.
+ *    10 - agtype OPTIONAL intermediate vertex prototype as a vertex
+ *                 Note: Every vertex in a path, other than its start and end
+ *                       vertex, must match its label and properties.
  *
  * This is a set returning function. This means that the first call sets
  * up the initial structures and then outputs the first row. After that each
@@ -1695,8 +2777,26 @@ Datum age_vle(PG_FUNCTION_ARGS)
          */
         funcctx->user_fctx = vlelctx;
 
-        /* if we are starting from zero [*0..x] flag it */
-        if (vlelctx->lidx == 0)
+        /* get the row bound, it is set on each call as it isn't cached */
+        vlelctx->row_bound = -1;
+        if (PG_NARGS() >= 10 && !PG_ARGISNULL(9) &&
+            !is_agtype_null(AG_GET_ARG_AGTYPE_P(9)))
+        {
+            agtype_value *agtv_temp = NULL;
+
+            agtv_temp = get_agtype_value("age_vle", AG_GET_ARG_AGTYPE_P(9),
+                                         AGTV_INTEGER, true);
+            vlelctx->row_bound = agtv_temp->val.int_value;
+        }
+
+        /*
+         * If we are starting from zero [*0..x] flag it. With an end vertex,
+         * the only zero length path is from a vertex to itself.
+         */
+        if (vlelctx->lidx == 0 &&
+            (vlelctx->path_mode == CYPHER_PATH_ALL ||
+             IS_SHORTEST_PATH_MODE(vlelctx->path_mode)) &&
+            (vlelctx->veid == 0 || vlelctx->vsid == vlelctx->veid))
         {
             is_zero_bound = true;
             done = true;
@@ -1715,6 +2815,24 @@ Datum age_vle(PG_FUNCTION_ARGS)
      */
     oldctx = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
 
+    /*
+     * Once the row bound has been returned, stop. The dfs stacks are emptied
+     * now rather than when the SRF context goes away.
+     */
+    if (vlelctx->row_bound >= 0 && funcctx->call_cntr >= vlelctx->row_bound)
+    {
+        clear_dfs_stacks(vlelctx);
+        is_zero_bound = false;
+        done = true;
+    }
+    /* a reachability search only returns one row, if there is a path */
+    else if (vlelctx->path_mode == CYPHER_PATH_REACHABLE)
+    {
+        found_a_path = (funcctx->call_cntr == 0 &&
+                        is_end_vertex_reachable(vlelctx));
+        done = true;
+    }
+
     while (done == false)
     {
         /* find one path based on specific input */
@@ -1737,7 +2855,6 @@ Datum age_vle(PG_FUNCTION_ARGS)
 
         /* if we found a path, or are done, flag it so we can output the data */
         if (found_a_path == true ||
-            (found_a_path == false && vlelctx->next_vertex == NULL) ||
             (found_a_path == false &&
              (vlelctx->path_function == VLE_FUNCTION_PATHS_BETWEEN ||
               vlelctx->path_function == VLE_FUNCTION_PATHS_FROM)))
@@ -1748,17 +2865,19 @@ Datum age_vle(PG_FUNCTION_ARGS)
         else if ((vlelctx->path_function == VLE_FUNCTION_PATHS_ALL) ||
                  (vlelctx->path_function == VLE_FUNCTION_PATHS_TO))
         {
-            /* get the next start vertex id */
-            vlelctx->vsid = get_graphid(vlelctx->next_vertex);
-
-            /* increment to the next vertex */
-            vlelctx->next_vertex = next_GraphIdNode(vlelctx->next_vertex);
+            /* get the next start vertex id, if there are any left */
+            if (!get_next_start_vertex(vlelctx))
+            {
+                done = true;
+                break;
+            }
 
             /* load in the starting edge(s) */
             load_initial_dfs_stacks(vlelctx);
 
-            /* if we are starting from zero [*0..x] flag it */
-            if (vlelctx->lidx == 0)
+            /* if we are starting from zero [*0..x] flag it, as above */
+            if (vlelctx->lidx == 0 &&
+                (vlelctx->veid == 0 || vlelctx->vsid == vlelctx->veid))
             {
                 is_zero_bound = true;
                 done = true;
@@ -1781,6 +2900,9 @@ Datum age_vle(PG_FUNCTION_ARGS)
     /* switch back to a more volatile context */
     MemoryContextSwitchTo(oldctx);
 
+    /* a parallel worker hands what its dfs stacks spilled to its leader */
+    report_vle_spilled_bytes();
+
     /*
      * If we find a path, we need to convert the path_stack into a list that
      * the outside world can use.
@@ -1789,6 +2911,12 @@ Datum age_vle(PG_FUNCTION_ARGS)
     {
         VLE_path_container *vpc = NULL;
 
+        /* there isn't a path to return for a reachability search */
+        if (vlelctx->path_mode == CYPHER_PATH_REACHABLE)
+        {
+            SRF_RETURN_NEXT(funcctx, boolean_to_agtype(true));
+        }
+
         /* if this isn't the zero boundary case generate a normal vpc */
         if (!is_zero_bound)
         {
@@ -1814,6 +2942,12 @@ Datum age_vle(PG_FUNCTION_ARGS)
     /* otherwise, we are done and we need to cleanup and signal done */
     else
     {
+        /*
+         * Free what is left of the dfs stacks. Their nodes are in the SRF's
+         * memory context, which a cached context outlives.
+         */
+        clear_dfs_stacks(vlelctx);
+
         /* mark local context as clean */
         vlelctx->is_dirty = false;
 
@@ -2370,49 +3504,172 @@ Datum age_build_vle_match_edge(PG_FUNCTION_ARGS)
 }
 
 /*
- * This function checks the edges in a MATCH clause to see if they are unique or
- * not. Filters out all the paths where the edge uniques rules are not met.
- * Arguements can be a combination of agtype ints and VLE_path_containers.
+ * PG helper function to build an agtype (Datum) vertex for matching the
+ * intermediate vertices of a VLE
  */
-PG_FUNCTION_INFO_V1(_ag_enforce_edge_uniqueness);
+PG_FUNCTION_INFO_V1(age_build_vle_match_vertex);
 
-Datum _ag_enforce_edge_uniqueness(PG_FUNCTION_ARGS)
+Datum age_build_vle_match_vertex(PG_FUNCTION_ARGS)
 {
-    HTAB *exists_hash = NULL;
-    HASHCTL exists_ctl;
-    Datum *args = NULL;
-    bool *nulls = NULL;
-    Oid *types = NULL;
-    int nargs = 0;
-    int i = 0;
+    agtype_in_state result;
+    agtype_value agtv_zero;
+    agtype_value agtv_nstr;
+    agtype_value *agtv_temp = NULL;
 
-    /* extract our arguments */
-    nargs = extract_variadic_args(fcinfo, 0, true, &args, &types, &nulls);
+    /* create an agtype_value integer 0 */
+    agtv_zero.type = AGTV_INTEGER;
+    agtv_zero.val.int_value = 0;
 
-    /* verify the arguments */
-    for (i = 0; i < nargs; i++)
-    {
-        if (nulls[i])
-        {
-             ereport(ERROR,
-                     (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                      errmsg("_ag_enforce_edge_uniqueness argument %d must not be NULL",
-                             i)));
-        }
-        if (types[i] != AGTYPEOID &&
-            types[i] != INT8OID &&
-            types[i] != GRAPHIDOID)
-        {
-             ereport(ERROR,
-                     (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                      errmsg("_ag_enforce_edge_uniqueness argument %d must be AGTYPE, INT8, or GRAPHIDOID",
-                             i)));
-        }
-    }
+    /* create an agtype_value null string */
+    agtv_nstr.type = AGTV_STRING;
+    agtv_nstr.val.string.len = 0;
+    agtv_nstr.val.string.val = NULL;
 
-    /* configure the hash table */
-    MemSet(&exists_ctl, 0, sizeof(exists_ctl));
-    exists_ctl.keysize = sizeof(int64);
+    /* zero the state */
+    memset(&result, 0, sizeof(agtype_in_state));
+
+    /* start the object */
+    result.res = push_agtype_value(&result.parse_state, WAGT_BEGIN_OBJECT,
+                                   NULL);
+    /* create dummy graph id */
+    result.res = push_agtype_value(&result.parse_state, WAGT_KEY,
+                                   string_to_agtype_value("id"));
+    result.res = push_agtype_value(&result.parse_state, WAGT_VALUE, &agtv_zero);
+    /* process the label */
+    result.res = push_agtype_value(&result.parse_state, WAGT_KEY,
+                                   string_to_agtype_value("label"));
+    if (!PG_ARGISNULL(0))
+    {
+        agtv_temp = get_agtype_value("build_vle_match_vertex",
+                                     AG_GET_ARG_AGTYPE_P(0), AGTV_STRING, true);
+        result.res = push_agtype_value(&result.parse_state, WAGT_VALUE,
+                                       agtv_temp);
+    }
+    else
+    {
+        result.res = push_agtype_value(&result.parse_state, WAGT_VALUE,
+                                       &agtv_nstr);
+    }
+
+    /* process the properties */
+    result.res = push_agtype_value(&result.parse_state, WAGT_KEY,
+                                   string_to_agtype_value("properties"));
+    if (!PG_ARGISNULL(1))
+    {
+        agtype *properties = NULL;
+
+        properties = AG_GET_ARG_AGTYPE_P(1);
+
+        if (!AGT_ROOT_IS_OBJECT(properties))
+        {
+            ereport(ERROR,
+                    (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                     errmsg("build_vle_match_vertex(): properties argument must be an object")));
+        }
+
+        add_agtype((Datum)properties, false, &result, AGTYPEOID, false);
+    }
+    else
+    {
+        result.res = push_agtype_value(&result.parse_state, WAGT_BEGIN_OBJECT,
+                                       NULL);
+        result.res = push_agtype_value(&result.parse_state, WAGT_END_OBJECT,
+                                       NULL);
+    }
+
+    result.res = push_agtype_value(&result.parse_state, WAGT_END_OBJECT, NULL);
+
+    result.res->type = AGTV_VERTEX;
+
+    PG_RETURN_POINTER(agtype_value_to_agtype(result.res));
+}
+
+/*
+ * PG helper function to turn a value that the id of a VLE's end vertex is
+ * compared to into the end vertex argument of the VLE function. Only an
+ * integer, or a float with an integral value, can be equal to a vertex id. For
+ * anything else NULL is returned, so that the VLE function finds every path
+ * from its start vertex and the comparison is left to the WHERE clause.
+ */
+PG_FUNCTION_INFO_V1(age_vle_end_vertex_id);
+
+Datum age_vle_end_vertex_id(PG_FUNCTION_ARGS)
+{
+    agtype *agt_arg = NULL;
+    agtype_value *agtv_id = NULL;
+
+    agt_arg = AG_GET_ARG_AGTYPE_P(0);
+
+    if (!AGT_ROOT_IS_SCALAR(agt_arg))
+    {
+        PG_RETURN_NULL();
+    }
+
+    agtv_id = get_ith_agtype_value_from_container(&agt_arg->root, 0);
+
+    if (agtv_id->type == AGTV_INTEGER)
+    {
+        PG_RETURN_POINTER(agt_arg);
+    }
+
+    if (agtv_id->type == AGTV_FLOAT)
+    {
+        float8 f = agtv_id->val.float_value;
+
+        if (f == rint(f) && f >= (float8)PG_INT64_MIN &&
+            f < -((float8)PG_INT64_MIN))
+        {
+            PG_RETURN_DATUM(integer_to_agtype((int64)f));
+        }
+    }
+
+    PG_RETURN_NULL();
+}
+
+/*
+ * This function checks the edges in a MATCH clause to see if they are unique or
+ * not. Filters out all the paths where the edge uniques rules are not met.
+ * Arguements can be a combination of agtype ints and VLE_path_containers.
+ */
+PG_FUNCTION_INFO_V1(_ag_enforce_edge_uniqueness);
+
+Datum _ag_enforce_edge_uniqueness(PG_FUNCTION_ARGS)
+{
+    HTAB *exists_hash = NULL;
+    HASHCTL exists_ctl;
+    Datum *args = NULL;
+    bool *nulls = NULL;
+    Oid *types = NULL;
+    int nargs = 0;
+    int i = 0;
+
+    /* extract our arguments */
+    nargs = extract_variadic_args(fcinfo, 0, true, &args, &types, &nulls);
+
+    /* verify the arguments */
+    for (i = 0; i < nargs; i++)
+    {
+        if (nulls[i])
+        {
+             ereport(ERROR,
+                     (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                      errmsg("_ag_enforce_edge_uniqueness argument %d must not be NULL",
+                             i)));
+        }
+        if (types[i] != AGTYPEOID &&
+            types[i] != INT8OID &&
+            types[i] != GRAPHIDOID)
+        {
+             ereport(ERROR,
+                     (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                      errmsg("_ag_enforce_edge_uniqueness argument %d must be AGTYPE, INT8, or GRAPHIDOID",
+                             i)));
+        }
+    }
+
+    /* configure the hash table */
+    MemSet(&exists_ctl, 0, sizeof(exists_ctl));
+    exists_ctl.keysize = sizeof(int64);
     exists_ctl.entrysize = sizeof(int64);
     exists_ctl.hash = tag_hash;
 
@@ -2558,3 +3815,880 @@ Datum _ag_enforce_edge_uniqueness(PG_FUNCTION_ARGS)
     hash_destroy(exists_hash);
     PG_RETURN_BOOL(true);
 }
+
+/*
+ * PG function to report on this backend's VLE local context cache. It returns
+ * the configured size, the number of cached contexts, and how many lookups
+ * were hits and misses and how many contexts were evicted.
+ */
+PG_FUNCTION_INFO_V1(age_vle_cache_stats);
+
+Datum age_vle_cache_stats(PG_FUNCTION_ARGS)
+{
+    TupleDesc tupdesc;
+    Datum values[VLE_CACHE_STATS_COLUMNS];
+    bool nulls[VLE_CACHE_STATS_COLUMNS];
+    int64 num_cached = 0;
+
+    if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+    {
+        elog(ERROR, "return type must be a row type");
+    }
+    tupdesc = BlessTupleDesc(tupdesc);
+
+    if (vle_local_context_cache != NULL)
+    {
+        num_cached = hash_get_num_entries(vle_local_context_cache);
+    }
+
+    MemSet(nulls, 0, sizeof(nulls));
+
+    values[0] = Int32GetDatum(age_vle_local_context_cache_size);
+    values[1] = Int64GetDatum(num_cached);
+    values[2] = Int64GetDatum(vle_cache_hits);
+    values[3] = Int64GetDatum(vle_cache_misses);
+    values[4] = Int64GetDatum(vle_cache_evictions);
+
+    PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values,
+                                                      nulls)));
+}
+
+/*
+ * Helper function to get a vertex id from an argument that is either a vertex
+ * or the integer id of one.
+ */
+static graphid get_vertex_id_argument(FunctionCallInfo fcinfo, int argno,
+                                      char *argname)
+{
+    agtype_value *agtv_temp = NULL;
+
+    if (PG_ARGISNULL(argno) || is_agtype_null(AG_GET_ARG_AGTYPE_P(argno)))
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("weighted_shortest_path: %s vertex cannot be NULL",
+                        argname)));
+    }
+
+    agtv_temp = get_agtype_value("weighted_shortest_path",
+                                 AG_GET_ARG_AGTYPE_P(argno), AGTV_VERTEX,
+                                 false);
+    if (agtv_temp != NULL && agtv_temp->type == AGTV_VERTEX)
+    {
+        agtv_temp = GET_AGTYPE_VALUE_OBJECT_VALUE(agtv_temp, "id");
+    }
+    else if (agtv_temp == NULL || agtv_temp->type != AGTV_INTEGER)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("weighted_shortest_path: %s vertex argument must be a vertex or the integer id",
+                        argname)));
+    }
+
+    return agtv_temp->val.int_value;
+}
+
+/*
+ * Comparator for the weighted shortest path pairing heap. The pairing heap
+ * keeps the greatest node first, so the lower cost is the greater node.
+ */
+static int weighted_path_heap_compare(const pairingheap_node *a,
+                                      const pairingheap_node *b, void *arg)
+{
+    const weighted_path_heap_node *node_a =
+        (const weighted_path_heap_node *) a;
+    const weighted_path_heap_node *node_b =
+        (const weighted_path_heap_node *) b;
+
+    if (node_a->cost < node_b->cost)
+    {
+        return 1;
+    }
+    if (node_a->cost > node_b->cost)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Helper function to get an edge's weight from its cached properties. It
+ * returns false if the edge doesn't have the weight property, or if it is
+ * null. A weight that isn't a non negative number is an error.
+ */
+static bool get_edge_weight(edge_entry *ee, agtype_value *weight_key,
+                            float8 *weight)
+{
+    Datum edge_properties;
+    agtype *edge_property = NULL;
+    agtype_value *agtv_weight = NULL;
+    bool found = false;
+
+    /* get our edge's properties */
+    edge_properties = get_edge_entry_properties(ee);
+    edge_property = DATUM_GET_AGTYPE_P(edge_properties);
+
+    agtv_weight = find_agtype_value_from_container(&edge_property->root,
+                                                   AGT_FOBJECT, weight_key);
+
+    if (agtv_weight != NULL && agtv_weight->type != AGTV_NULL)
+    {
+        if (agtv_weight->type == AGTV_INTEGER)
+        {
+            *weight = (float8) agtv_weight->val.int_value;
+        }
+        else if (agtv_weight->type == AGTV_FLOAT)
+        {
+            *weight = agtv_weight->val.float_value;
+        }
+        else
+        {
+            ereport(ERROR,
+                    (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                     errmsg("weighted_shortest_path: edge weight must be an integer or a float")));
+        }
+
+        /* this also catches NaN */
+        if (!(*weight >= 0))
+        {
+            ereport(ERROR,
+                    (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                     errmsg("weighted_shortest_path: edge weight cannot be negative")));
+        }
+
+        found = true;
+    }
+
+    if (agtv_weight != NULL)
+    {
+        pfree(agtv_weight);
+    }
+
+    /* release the properties, if they were fetched */
+    free_edge_entry_properties(ee, edge_properties);
+
+    return found;
+}
+
+/*
+ * Helper function to find the least cost path from vsid to veid with
+ * Dijkstra's algorithm. Only the exiting edges are followed. Edges without
+ * the weight property, or without the edge label if there is one, are not
+ * part of any path. The path is returned as a VLE_path_container or NULL if
+ * veid can't be reached.
+ */
+static VLE_path_container *find_weighted_shortest_path(
+    GRAPH_global_context *ggctx, graphid vsid, graphid veid,
+    bool has_edge_label, int32 edge_label_id, agtype_value *weight_key)
+{
+    HASHCTL weighted_path_ctl;
+    HTAB *weighted_path_hashtable = NULL;
+    pairingheap *heap = NULL;
+    weighted_path_heap_node *node = NULL;
+    weighted_path_entry *wpe = NULL;
+    VLE_path_container *vpc = NULL;
+    graphid *graphid_array = NULL;
+    int64 index = 0;
+
+    MemSet(&weighted_path_ctl, 0, sizeof(weighted_path_ctl));
+    weighted_path_ctl.keysize = sizeof(int64);
+    weighted_path_ctl.entrysize = sizeof(weighted_path_entry);
+    weighted_path_ctl.hash = tag_hash;
+    weighted_path_ctl.hcxt = CurrentMemoryContext;
+    weighted_path_hashtable = hash_create(WEIGHTED_PATH_HTAB_NAME,
+                                          WEIGHTED_PATH_HTAB_INITIAL_SIZE,
+                                          &weighted_path_ctl,
+                                          HASH_ELEM | HASH_FUNCTION |
+                                          HASH_CONTEXT);
+
+    /* seed the search with the start vertex */
+    wpe = hash_search(weighted_path_hashtable, (void *)&vsid, HASH_ENTER,
+                      NULL);
+    wpe->vertex_id = vsid;
+    wpe->cost = 0;
+    wpe->parent_edge_id = 0;
+    wpe->parent_vertex_id = 0;
+    wpe->num_edges = 0;
+    wpe->settled = false;
+
+    heap = pairingheap_allocate(weighted_path_heap_compare, NULL);
+    node = palloc(sizeof(weighted_path_heap_node));
+    node->vertex_id = vsid;
+    node->cost = 0;
+    pairingheap_add(heap, &node->ph_node);
+
+    while (!pairingheap_is_empty(heap))
+    {
+        vertex_edge_iterator iterator;
+        vertex_entry *ve = NULL;
+        graphid vertex_id = 0;
+        graphid edge_id = 0;
+        graphid other_vertex_id = 0;
+        float8 cost = 0;
+
+        CHECK_FOR_INTERRUPTS();
+
+        node = (weighted_path_heap_node *) pairingheap_remove_first(heap);
+        vertex_id = node->vertex_id;
+        cost = node->cost;
+        pfree(node);
+
+        wpe = hash_search(weighted_path_hashtable, (void *)&vertex_id,
+                          HASH_FIND, NULL);
+        Assert(wpe != NULL);
+
+        /* skip the nodes left behind when a lower cost was found */
+        if (wpe->settled || cost > wpe->cost)
+        {
+            continue;
+        }
+        wpe->settled = true;
+
+        /* the end vertex's cost is final, so the path is found */
+        if (vertex_id == veid)
+        {
+            break;
+        }
+
+        ve = get_vertex_entry(ggctx, vertex_id);
+        Assert(ve != NULL);
+
+        init_vertex_edge_iterator(ggctx, ve, VERTEX_EDGES_OUT, &iterator);
+        while (next_vertex_edge(&iterator, &edge_id, &other_vertex_id))
+        {
+            weighted_path_entry *other_wpe = NULL;
+            float8 weight = 0;
+            bool found = false;
+
+            if (has_edge_label && GET_LABEL_ID(edge_id) != edge_label_id)
+            {
+                continue;
+            }
+
+            if (!get_edge_weight(get_edge_entry(ggctx, edge_id), weight_key,
+                                 &weight))
+            {
+                continue;
+            }
+
+            other_wpe = hash_search(weighted_path_hashtable,
+                                    (void *)&other_vertex_id, HASH_ENTER,
+                                    &found);
+            if (found &&
+                (other_wpe->settled || other_wpe->cost <= cost + weight))
+            {
+                continue;
+            }
+
+            other_wpe->vertex_id = other_vertex_id;
+            other_wpe->cost = cost + weight;
+            other_wpe->parent_edge_id = edge_id;
+            other_wpe->parent_vertex_id = vertex_id;
+            other_wpe->num_edges = wpe->num_edges + 1;
+            other_wpe->settled = false;
+
+            node = palloc(sizeof(weighted_path_heap_node));
+            node->vertex_id = other_vertex_id;
+            node->cost = other_wpe->cost;
+            pairingheap_add(heap, &node->ph_node);
+        }
+    }
+
+    /* free whatever is left in the heap */
+    while (!pairingheap_is_empty(heap))
+    {
+        pfree(pairingheap_remove_first(heap));
+    }
+    pairingheap_free(heap);
+
+    wpe = hash_search(weighted_path_hashtable, (void *)&veid, HASH_FIND, NULL);
+
+    /* build the path backwards from the end vertex */
+    if (wpe != NULL && wpe->settled)
+    {
+        vpc = create_VLE_path_container((wpe->num_edges * 2) + 1);
+        graphid_array = GET_GRAPHID_ARRAY_FROM_CONTAINER(vpc);
+
+        index = vpc->graphid_array_size - 1;
+        graphid_array[index] = veid;
+        while (index > 0)
+        {
+            graphid_array[index - 1] = wpe->parent_edge_id;
+            graphid_array[index - 2] = wpe->parent_vertex_id;
+            index -= 2;
+
+            wpe = hash_search(weighted_path_hashtable,
+                              (void *)&wpe->parent_vertex_id, HASH_FIND, NULL);
+            Assert(wpe != NULL);
+        }
+    }
+
+    hash_destroy(weighted_path_hashtable);
+
+    return vpc;
+}
+
+/*
+ * PG function to find the least cost path between two vertices, where the cost
+ * of an edge is one of its properties. It takes the following input and
+ * returns the path as an agtype path, or NULL if there isn't one -
+ *
+ *     0 - agtype REQUIRED (graph name as string)
+ *                 Note: This is automatically added by transform_FuncCall.
+ *     1 - agtype REQUIRED (start vertex as a vertex or the integer id)
+ *     2 - agtype REQUIRED (end vertex as a vertex or the integer id)
+ *     3 - agtype OPTIONAL (edge label as a string)
+ *                 Note: A NULL matches edges with any label.
+ *     4 - agtype REQUIRED (the property key of the edge weights as a string)
+ *                 Note: Edges without it are not followed. The weights must
+ *                       be non negative integers or floats.
+ *
+ * The path follows the direction of the edges.
+ */
+PG_FUNCTION_INFO_V1(age_weighted_shortest_path);
+
+Datum age_weighted_shortest_path(PG_FUNCTION_ARGS)
+{
+    GRAPH_global_context *ggctx = NULL;
+    VLE_path_container *vpc = NULL;
+    agtype_value *agtv_temp = NULL;
+    agtype_value *weight_key = NULL;
+    char *graph_name = NULL;
+    Oid graph_oid = InvalidOid;
+    graphid vsid = 0;
+    graphid veid = 0;
+    bool has_edge_label = false;
+    int32 edge_label_id = INVALID_LABEL_ID;
+
+    /* the graph name is required, but this generally isn't user supplied */
+    if (PG_ARGISNULL(0))
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("weighted_shortest_path: graph name cannot be NULL")));
+    }
+
+    /* get the graph name */
+    agtv_temp = get_agtype_value("weighted_shortest_path",
+                                 AG_GET_ARG_AGTYPE_P(0), AGTV_STRING, true);
+    graph_name = pnstrdup(agtv_temp->val.string.val,
+                          agtv_temp->val.string.len);
+
+    /* get the start and end vertex ids */
+    vsid = get_vertex_id_argument(fcinfo, 1, "start");
+    veid = get_vertex_id_argument(fcinfo, 2, "end");
+
+    /* get the weight property key */
+    if (PG_ARGISNULL(4) || is_agtype_null(AG_GET_ARG_AGTYPE_P(4)))
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("weighted_shortest_path: weight key cannot be NULL")));
+    }
+    weight_key = get_agtype_value("weighted_shortest_path",
+                                  AG_GET_ARG_AGTYPE_P(4), AGTV_STRING, true);
+
+    /* get the graph oid */
+    graph_oid = get_graph_oid(graph_name);
+
+    /* get the edge label, if there is one */
+    if (!PG_ARGISNULL(3) && !is_agtype_null(AG_GET_ARG_AGTYPE_P(3)))
+    {
+        char *edge_label_name = NULL;
+        label_cache_data *label = NULL;
+
+        agtv_temp = get_agtype_value("weighted_shortest_path",
+                                     AG_GET_ARG_AGTYPE_P(3), AGTV_STRING,
+                                     true);
+        edge_label_name = pnstrdup(agtv_temp->val.string.val,
+                                   agtv_temp->val.string.len);
+        label = search_label_name_graph_cache(edge_label_name, graph_oid);
+        pfree(edge_label_name);
+
+        /* no edge can match a label that doesn't exist */
+        if (label == NULL)
+        {
+            PG_RETURN_NULL();
+        }
+
+        has_edge_label = true;
+        edge_label_id = label->id;
+    }
+
+    /*
+     * Create or retrieve the GRAPH global context for this graph. This function
+     * will also purge off invalidated contexts.
+     */
+    ggctx = manage_GRAPH_global_contexts(graph_name, graph_oid);
+
+    /* free the graph name */
+    pfree(graph_name);
+
+    /* if either vertex doesn't exist, there isn't a path */
+    if (get_vertex_entry(ggctx, vsid) == NULL ||
+        get_vertex_entry(ggctx, veid) == NULL)
+    {
+        PG_RETURN_NULL();
+    }
+
+    vpc = find_weighted_shortest_path(ggctx, vsid, veid, has_edge_label,
+                                      edge_label_id, weight_key);
+    if (vpc == NULL)
+    {
+        PG_RETURN_NULL();
+    }
+
+    /* build_path needs the graph oid to find the global context */
+    vpc->graph_oid = graph_oid;
+
+    PG_RETURN_POINTER(agtype_value_to_agtype(build_path(vpc)));
+}
+
+/*
+ * Helper function to get a VLE function argument as a Const, as far as the
+ * planner can tell. It returns NULL if the argument isn't known until run time.
+ */
+static Const *get_estimated_const_arg(PlannerInfo *root, List *args,
+                                      int argno)
+{
+    Node *node = NULL;
+
+    if (list_length(args) <= argno)
+    {
+        return NULL;
+    }
+
+    node = estimate_expression_value(root, (Node *)list_nth(args, argno));
+
+    return IsA(node, Const) ? (Const *)node : NULL;
+}
+
+/*
+ * Helper function to get a VLE function argument's agtype value, as far as the
+ * planner can tell. It returns NULL if the argument isn't known until run time,
+ * is null, or isn't a scalar of the type.
+ */
+static agtype_value *get_estimated_arg_value(PlannerInfo *root, List *args,
+                                             int argno,
+                                             enum agtype_value_type type)
+{
+    Const *c = NULL;
+    agtype *agt = NULL;
+    agtype_value *agtv = NULL;
+
+    c = get_estimated_const_arg(root, args, argno);
+    if (c == NULL || c->constisnull)
+    {
+        return NULL;
+    }
+
+    agt = DATUM_GET_AGTYPE_P(c->constvalue);
+    if (!AGTYPE_CONTAINER_IS_SCALAR(&agt->root) || is_agtype_null(agt))
+    {
+        return NULL;
+    }
+
+    agtv = get_agtype_value("age_vle", agt, type, false);
+
+    return (agtv->type == type) ? agtv : NULL;
+}
+
+/* helper function to check if a Const argument is NULL, or an agtype null */
+static bool is_const_arg_null(Const *c)
+{
+    return (c->constisnull ||
+            is_agtype_null(DATUM_GET_AGTYPE_P(c->constvalue)));
+}
+
+/*
+ * Helper function to get the number of entities with a label, including its
+ * child labels, from the statistics of their tables. Tables that haven't been
+ * vacuumed or analyzed yet are skipped. It returns -1 if none of them have
+ * been, and 0 if the label doesn't exist.
+ */
+static double get_label_num_entities(const char *label_name, Oid graph_oid)
+{
+    List *relids = NIL;
+    ListCell *lc = NULL;
+    Oid relid = InvalidOid;
+    double num_entities = 0;
+    bool is_known = false;
+
+    relid = get_label_relation(label_name, graph_oid);
+    if (!OidIsValid(relid))
+    {
+        return 0;
+    }
+
+    relids = find_all_inheritors(relid, NoLock, NULL);
+
+    foreach (lc, relids)
+    {
+        HeapTuple tuple;
+        float4 reltuples;
+
+        tuple = SearchSysCache1(RELOID, ObjectIdGetDatum(lfirst_oid(lc)));
+        if (!HeapTupleIsValid(tuple))
+        {
+            continue;
+        }
+
+        reltuples = ((Form_pg_class)GETSTRUCT(tuple))->reltuples;
+        ReleaseSysCache(tuple);
+
+        /* a reltuples of -1 means it hasn't been counted yet */
+        if (reltuples >= 0)
+        {
+            num_entities += reltuples;
+            is_known = true;
+        }
+    }
+
+    list_free(relids);
+
+    return is_known ? num_entities : -1;
+}
+
+/*
+ * Helper function to estimate the number of rows a VLE function call returns.
+ * From one start vertex, there are about d^k paths of length k, where d is the
+ * average degree of the vertices over the matching edges. These are summed
+ * over the bounds. Without a start vertex, every vertex is a start vertex. With
+ * an end vertex, only the paths that end at it are returned. It returns -1 if
+ * there aren't the statistics to estimate with.
+ */
+static double estimate_VLE_rows(PlannerInfo *root, List *args)
+{
+    Const *c = NULL;
+    agtype_value *agtv_temp = NULL;
+    char *graph_name = NULL;
+    const char *edge_label_name = AG_DEFAULT_LABEL_EDGE;
+    Oid graph_oid = InvalidOid;
+    double num_vertices;
+    double num_edges;
+    double degree;
+    double term = 1;
+    double rows = 0;
+    int64 lidx = 1;
+    int64 max_depth;
+    int64 depth;
+
+    /* the graph name */
+    agtv_temp = get_estimated_arg_value(root, args, 0, AGTV_STRING);
+    if (agtv_temp == NULL)
+    {
+        return -1;
+    }
+    graph_name = pnstrdup(agtv_temp->val.string.val,
+                          agtv_temp->val.string.len);
+    graph_oid = get_graph_oid(graph_name);
+    pfree(graph_name);
+    if (!OidIsValid(graph_oid))
+    {
+        return -1;
+    }
+
+    /* the edge prototype's label, if it has one */
+    agtv_temp = get_estimated_arg_value(root, args, 3, AGTV_EDGE);
+    if (agtv_temp != NULL)
+    {
+        agtv_temp = GET_AGTYPE_VALUE_OBJECT_VALUE(agtv_temp, "label");
+        if (agtv_temp != NULL && agtv_temp->type == AGTV_STRING &&
+            agtv_temp->val.string.len != 0)
+        {
+            edge_label_name = pnstrdup(agtv_temp->val.string.val,
+                                       agtv_temp->val.string.len);
+        }
+    }
+
+    num_vertices = get_label_num_entities(AG_DEFAULT_LABEL_VERTEX, graph_oid);
+    num_edges = get_label_num_entities(edge_label_name, graph_oid);
+    if (num_vertices <= 0 || num_edges < 0)
+    {
+        return -1;
+    }
+
+    /* the average degree, both ends of an edge count without a direction */
+    degree = num_edges / num_vertices;
+    agtv_temp = get_estimated_arg_value(root, args, 6, AGTV_INTEGER);
+    if (agtv_temp != NULL && agtv_temp->val.int_value == CYPHER_REL_DIR_NONE)
+    {
+        degree *= 2;
+    }
+
+    /* the bounds, which default to 1 and infinite */
+    agtv_temp = get_estimated_arg_value(root, args, 4, AGTV_INTEGER);
+    if (agtv_temp != NULL)
+    {
+        lidx = Max(agtv_temp->val.int_value, 0);
+    }
+    max_depth = lidx + VLE_ROW_ESTIMATE_MAX_DEPTH;
+    agtv_temp = get_estimated_arg_value(root, args, 5, AGTV_INTEGER);
+    if (agtv_temp != NULL)
+    {
+        max_depth = Min(agtv_temp->val.int_value, max_depth);
+    }
+
+    /* sum the paths of each length from one start vertex */
+    for (depth = 0; depth <= max_depth; depth++)
+    {
+        if (depth >= lidx)
+        {
+            rows += term;
+        }
+        term *= degree;
+    }
+
+    /* without a start vertex, each vertex is one */
+    c = get_estimated_const_arg(root, args, 1);
+    if (c != NULL && is_const_arg_null(c))
+    {
+        rows *= num_vertices;
+    }
+
+    /* with an end vertex, only the paths that end there are returned */
+    c = get_estimated_const_arg(root, args, 2);
+    if (c == NULL || !is_const_arg_null(c))
+    {
+        rows /= num_vertices;
+    }
+
+    /* the shortest paths and reachability only return a few rows */
+    agtv_temp = get_estimated_arg_value(root, args, VLE_PATH_MODE_ARGNO,
+                                        AGTV_INTEGER);
+    if (agtv_temp != NULL && agtv_temp->val.int_value != CYPHER_PATH_ALL)
+    {
+        rows = Min(rows, 1);
+    }
+
+    /* and no more than the row bound */
+    agtv_temp = get_estimated_arg_value(root, args, VLE_ROW_BOUND_ARGNO,
+                                        AGTV_INTEGER);
+    if (agtv_temp != NULL)
+    {
+        rows = Min(rows, (double)agtv_temp->val.int_value);
+    }
+
+    return clamp_row_est(rows);
+}
+
+/*
+ * Planner support function for age_vle. Without it, the planner assumes that
+ * each call returns 1000 rows. It estimates the rows from the bounds, the
+ * direction, and the average degree, which comes from the statistics of the
+ * graph's label tables.
+ */
+PG_FUNCTION_INFO_V1(age_vle_support);
+
+Datum age_vle_support(PG_FUNCTION_ARGS)
+{
+    Node *rawreq = (Node *)PG_GETARG_POINTER(0);
+    SupportRequestRows *req = NULL;
+    double rows;
+
+    if (!IsA(rawreq, SupportRequestRows))
+    {
+        PG_RETURN_POINTER(NULL);
+    }
+
+    req = (SupportRequestRows *)rawreq;
+
+    /* estimate_expression_value needs the planner info */
+    if (req->root == NULL || !IsA(req->node, FuncExpr))
+    {
+        PG_RETURN_POINTER(NULL);
+    }
+
+    rows = estimate_VLE_rows(req->root, ((FuncExpr *)req->node)->args);
+    if (rows < 0)
+    {
+        PG_RETURN_POINTER(NULL);
+    }
+
+    req->rows = rows;
+
+    PG_RETURN_POINTER(req);
+}
+
+/*
+ * Request the shared memory for the counters of the bytes that the dfs stacks
+ * of parallel workers spill. This is only possible when age is loaded via
+ * shared_preload_libraries. Otherwise, EXPLAIN ANALYZE only reports what the
+ * leader itself spilled.
+ */
+void vle_shmem_init(void)
+{
+    if (!process_shared_preload_libraries_in_progress)
+    {
+        return;
+    }
+
+    RequestAddinShmemSpace(MAXALIGN(mul_size(sizeof(pg_atomic_uint64),
+                                             vle_shmem_max_backends())));
+
+    prev_shmem_startup_hook = shmem_startup_hook;
+    shmem_startup_hook = vle_shmem_startup;
+}
+
+void vle_shmem_fini(void)
+{
+    if (shmem_startup_hook == vle_shmem_startup)
+    {
+        shmem_startup_hook = prev_shmem_startup_hook;
+    }
+}
+
+/*
+ * Helper function to compute the number of backends, as MaxBackends isn't set
+ * yet while the shared_preload_libraries are loaded.
+ */
+static int vle_shmem_max_backends(void)
+{
+    return MaxConnections + autovacuum_max_workers + 1 + max_worker_processes +
+           max_wal_senders;
+}
+
+/* create, or attach to, the spilled bytes counters */
+static void vle_shmem_startup(void)
+{
+    int max_backends = vle_shmem_max_backends();
+    bool found = false;
+    int i;
+
+    if (prev_shmem_startup_hook)
+    {
+        prev_shmem_startup_hook();
+    }
+
+    LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+    vle_shared_spilled_bytes =
+        ShmemInitStruct(VLE_SPILLED_BYTES_NAME,
+                        mul_size(sizeof(pg_atomic_uint64), max_backends),
+                        &found);
+    if (!found)
+    {
+        for (i = 0; i < max_backends; i++)
+        {
+            pg_atomic_init_u64(&vle_shared_spilled_bytes[i], 0);
+        }
+    }
+
+    LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * Helper function for a parallel worker to add the bytes that its dfs stacks
+ * spilled, since it last did, to its leader's counter. It is called on each
+ * call of age_vle, so what a worker spilled is counted even if the rest of
+ * its results are never fetched.
+ */
+static void report_vle_spilled_bytes(void)
+{
+    int64 spilled_bytes = get_graphid_stacks_spilled_bytes();
+    pg_atomic_uint64 *leader_spilled_bytes = NULL;
+
+    if (!IsParallelWorker() || vle_shared_spilled_bytes == NULL ||
+        spilled_bytes == vle_reported_spilled_bytes)
+    {
+        return;
+    }
+
+    leader_spilled_bytes =
+        &vle_shared_spilled_bytes[ParallelLeaderBackendId - 1];
+    pg_atomic_fetch_add_u64(leader_spilled_bytes,
+                            spilled_bytes - vle_reported_spilled_bytes);
+    vle_reported_spilled_bytes = spilled_bytes;
+}
+
+/*
+ * Helper function to get the bytes that the dfs stacks of this backend, and
+ * of the parallel workers it led, have spilled. It is only ever added to, so
+ * it is measured by differences.
+ */
+static int64 get_vle_spilled_bytes(void)
+{
+    int64 spilled_bytes = get_graphid_stacks_spilled_bytes();
+
+    if (vle_shared_spilled_bytes != NULL && MyBackendId != InvalidBackendId)
+    {
+        spilled_bytes +=
+            pg_atomic_read_u64(&vle_shared_spilled_bytes[MyBackendId - 1]);
+    }
+
+    return spilled_bytes;
+}
+
+void vle_explain_hook_init(void)
+{
+    prev_explain_one_query_hook = ExplainOneQuery_hook;
+    ExplainOneQuery_hook = vle_ExplainOneQuery;
+}
+
+void vle_explain_hook_fini(void)
+{
+    ExplainOneQuery_hook = prev_explain_one_query_hook;
+}
+
+/*
+ * EXPLAIN a query, then, for EXPLAIN ANALYZE, report how much the dfs stacks
+ * of its VLE functions spilled to disk. That is only reported in the text
+ * format, where it can follow the plan.
+ *
+ * PG14 has neither a standard_ExplainOneQuery to chain to nor a hook on the
+ * EXPLAIN output. So, without a previous hook, this plans the query and runs
+ * ExplainOnePlan, as the static ExplainOneQuery does for a non-utility query,
+ * which is all this hook is called for.
+ */
+static void vle_ExplainOneQuery(Query *query, int cursorOptions,
+                                IntoClause *into, ExplainState *es,
+                                const char *queryString, ParamListInfo params,
+                                QueryEnvironment *queryEnv)
+{
+    int64 spilled_bytes = get_vle_spilled_bytes();
+
+    if (prev_explain_one_query_hook != NULL)
+    {
+        prev_explain_one_query_hook(query, cursorOptions, into, es,
+                                    queryString, params, queryEnv);
+    }
+    else
+    {
+        PlannedStmt *plan = NULL;
+        instr_time planstart;
+        instr_time planduration;
+        BufferUsage bufusage_start;
+        BufferUsage bufusage;
+
+        if (es->buffers)
+        {
+            bufusage_start = pgBufferUsage;
+        }
+        INSTR_TIME_SET_CURRENT(planstart);
+
+        /* plan the query */
+        plan = pg_plan_query(query, queryString, cursorOptions, params);
+
+        INSTR_TIME_SET_CURRENT(planduration);
+        INSTR_TIME_SUBTRACT(planduration, planstart);
+
+        /* calc differences of buffer counters */
+        if (es->buffers)
+        {
+            memset(&bufusage, 0, sizeof(BufferUsage));
+            BufferUsageAccumDiff(&bufusage, &pgBufferUsage, &bufusage_start);
+        }
+
+        /* run it (if needed) and produce output */
+        ExplainOnePlan(plan, into, es, queryString, params, queryEnv,
+                       &planduration, (es->buffers ? &bufusage : NULL));
+    }
+
+    /* the parallel workers, if any, have finished by now */
+    spilled_bytes = get_vle_spilled_bytes() - spilled_bytes;
+
+    if (es->analyze && es->format == EXPLAIN_FORMAT_TEXT && spilled_bytes > 0)
+    {
+        ExplainPropertyInteger("VLE Spilled", "kB", spilled_bytes / 1024, es);
+    }
+}
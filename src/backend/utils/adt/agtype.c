@@ -49,6 +49,8 @@
 #include "funcapi.h"
 #include "libpq/pqformat.h"
 #include "miscadmin.h"
+#include "nodes/supportnodes.h"
+#include "optimizer/optimizer.h"
 #include "parser/parse_coerce.h"
 #include "nodes/pg_list.h"
 #include "utils/builtins.h"
@@ -4170,7 +4172,7 @@ static char *get_label_name(const char *graph_name, int64 label_id)
     ScanKeyInit(&scan_keys[1], Anum_ag_label_id, BTEqualStrategyNumber,
                 F_INT42EQ, Int32GetDatum(get_graphid_label_id(label_id)));
 
-    ag_label = table_open(ag_label_relation_id(), ShareLock);
+    ag_label = table_open(ag_label_relation_id(), AccessShareLock);
     scan_desc = systable_beginscan(ag_label, ag_label_graph_oid_index_id(), true,
                                    NULL, 2, scan_keys);
 
@@ -4199,7 +4201,7 @@ static char *get_label_name(const char *graph_name, int64 label_id)
 
     /* end the scan and close the relation */
     systable_endscan(scan_desc);
-    table_close(ag_label, ShareLock);
+    table_close(ag_label, AccessShareLock);
 
     return result;
 }
@@ -4227,7 +4229,7 @@ static Datum get_vertex(const char *graph, const char *vertex_label,
                 Int64GetDatum(graphid));
 
     /* open the relation (table), begin the scan, and get the tuple  */
-    graph_vertex_label = table_open(vertex_label_table_oid, ShareLock);
+    graph_vertex_label = table_open(vertex_label_table_oid, AccessShareLock);
     scan_desc = table_beginscan(graph_vertex_label, snapshot, 1, scan_keys);
     tuple = heap_getnext(scan_desc, ForwardScanDirection);
 
@@ -4258,7 +4260,7 @@ static Datum get_vertex(const char *graph, const char *vertex_label,
                                  CStringGetDatum(vertex_label), properties);
     /* end the scan and close the relation */
     table_endscan(scan_desc);
-    table_close(graph_vertex_label, ShareLock);
+    table_close(graph_vertex_label, AccessShareLock);
     /* return the vertex datum */
     return result;
 }
@@ -9576,3 +9578,47 @@ Datum agtype_unnest(PG_FUNCTION_ARGS)
 
     PG_RETURN_NULL();
 }
+
+PG_FUNCTION_INFO_V1(agtype_unnest_support);
+/*
+ * Planner support function for unnest. When the array is known at plan time,
+ * such as the list of an UNWIND or a range() of constants, which is folded
+ * into one, its number of elements is the number of rows.
+ */
+Datum agtype_unnest_support(PG_FUNCTION_ARGS)
+{
+    Node *rawreq = (Node *)PG_GETARG_POINTER(0);
+    SupportRequestRows *req = NULL;
+    Node *arg = NULL;
+    agtype *agt = NULL;
+
+    if (!IsA(rawreq, SupportRequestRows))
+    {
+        PG_RETURN_POINTER(NULL);
+    }
+
+    req = (SupportRequestRows *)rawreq;
+
+    if (req->root == NULL || !IsA(req->node, FuncExpr) ||
+        ((FuncExpr *)req->node)->args == NIL)
+    {
+        PG_RETURN_POINTER(NULL);
+    }
+
+    arg = estimate_expression_value(req->root,
+                                    linitial(((FuncExpr *)req->node)->args));
+    if (!IsA(arg, Const) || ((Const *)arg)->constisnull)
+    {
+        PG_RETURN_POINTER(NULL);
+    }
+
+    agt = DATUM_GET_AGTYPE_P(((Const *)arg)->constvalue);
+    if (!AGT_ROOT_IS_ARRAY(agt) || AGT_ROOT_IS_SCALAR(agt))
+    {
+        PG_RETURN_POINTER(NULL);
+    }
+
+    req->rows = clamp_row_est(AGT_ROOT_COUNT(agt));
+
+    PG_RETURN_POINTER(req);
+}
@@ -58,7 +58,6 @@
 static void fill_agtype_value(agtype_container *container, int index,
                               char *base_addr, uint32 offset,
                               agtype_value *result);
-static bool equals_agtype_scalar_value(const agtype_value *a, const agtype_value *b);
 static agtype *convert_to_agtype(agtype_value *val);
 static void convert_agtype_value(StringInfo buffer, agtentry *header,
                                  agtype_value *val, int level);
@@ -1519,7 +1518,7 @@ static int compare_two_floats_orderability(float8 lhs, float8 rhs)
 /*
  * Are two scalar agtype_values of the same type a and b equal?
  */
-static bool equals_agtype_scalar_value(const agtype_value *a, const agtype_value *b)
+bool equals_agtype_scalar_value(const agtype_value *a, const agtype_value *b)
 {
     /* if the values are of the same type */
     if (a->type == b->type)
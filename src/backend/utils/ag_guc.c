@@ -0,0 +1,132 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "postgres.h"
+
+#include <limits.h>
+
+#include "postmaster/bgworker_internals.h"
+#include "utils/guc.h"
+
+#include "utils/ag_guc.h"
+
+/* GRAPH global context parameters */
+bool age_enable_shared_global_graph = false;
+int age_global_graph_load_workers = -1;
+bool age_global_graph_lazy_properties = false;
+int age_global_graph_memory_limit = -1;
+
+/* VLE parameters */
+int age_vle_local_context_cache_size = 5;
+
+/*
+ * Defines AGE's custom configuration parameters.
+ *
+ * The name of each parameter must start with `age.`. This name is used for
+ * setting the value of the parameter. For example -
+ *
+ *     SET age.enable_shared_global_graph = on;
+ */
+void define_config_params(void)
+{
+    DefineCustomBoolVariable("age.enable_shared_global_graph",
+                             "Share global graph contexts between backends.",
+                             "When enabled, a GRAPH global context is built "
+                             "once into dynamic shared memory and other "
+                             "backends with an equivalent snapshot attach to "
+                             "it instead of scanning the label tables. "
+                             "Requires age in shared_preload_libraries.",
+                             &age_enable_shared_global_graph,
+                             false,
+                             PGC_USERSET,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
+    DefineCustomIntVariable("age.global_graph_load_workers",
+                            "Sets the number of parallel workers used to load "
+                            "a global graph.",
+                            "The label tables are scanned by parallel workers "
+                            "and merged by the loading backend. -1 picks the "
+                            "number from the size of the label tables, up to "
+                            "max_parallel_workers_per_gather. 0 loads the "
+                            "graph without workers.",
+                            &age_global_graph_load_workers,
+                            -1,
+                            -1,
+                            MAX_PARALLEL_WORKER_LIMIT,
+                            PGC_USERSET,
+                            0,
+                            NULL,
+                            NULL,
+                            NULL);
+
+    DefineCustomBoolVariable("age.global_graph_lazy_properties",
+                             "Fetch global graph properties when needed.",
+                             "When enabled, a global graph keeps only the "
+                             "location of each vertex and edge tuple and "
+                             "fetches its properties from the label table "
+                             "when they are needed, instead of holding them "
+                             "all in memory.",
+                             &age_global_graph_lazy_properties,
+                             false,
+                             PGC_USERSET,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
+    DefineCustomIntVariable("age.global_graph_memory_limit",
+                            "Sets the maximum memory used by the global "
+                            "graphs of a backend.",
+                            "When loading a global graph takes the backend "
+                            "over this limit, the least recently used global "
+                            "graphs are freed. Graphs used by the current "
+                            "transaction are kept. -1 means no limit.",
+                            &age_global_graph_memory_limit,
+                            -1,
+                            -1,
+                            MAX_KILOBYTES,
+                            PGC_USERSET,
+                            GUC_UNIT_KB,
+                            NULL,
+                            NULL,
+                            NULL);
+
+    DefineCustomIntVariable("age.vle_local_context_cache_size",
+                            "Sets the number of VLE local contexts a backend "
+                            "keeps for reuse.",
+                            "A VLE local context is kept for each VLE in a "
+                            "query, so that it can be reused when the VLE is "
+                            "run again with another start vertex. The least "
+                            "recently used contexts past this number are "
+                            "freed. 0 turns off the cache.",
+                            &age_vle_local_context_cache_size,
+                            5,
+                            0,
+                            INT_MAX,
+                            PGC_USERSET,
+                            0,
+                            NULL,
+                            NULL,
+                            NULL);
+
+    EmitWarningsOnPlaceholders("age");
+}
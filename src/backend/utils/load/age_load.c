@@ -30,6 +30,7 @@
 
 #include "catalog/ag_graph.h"
 #include "catalog/ag_label.h"
+#include "utils/age_global_graph.h"
 #include "utils/agtype.h"
 #include "utils/graphid.h"
 
@@ -212,6 +213,9 @@ Datum load_labels_from_file(PG_FUNCTION_ARGS)
 
     create_labels_from_csv_file(file_path_str, graph_name_str, graph_oid,
                                 label_name_str, label_id, id_field_exists);
+
+    /* the loaded vertices aren't logged, the graph needs to be reloaded */
+    invalidate_GRAPH_global_contexts(graph_oid);
     PG_RETURN_VOID();
 
 }
@@ -260,6 +264,9 @@ Datum load_edges_from_file(PG_FUNCTION_ARGS)
 
     create_edges_from_csv_file(file_path_str, graph_name_str, graph_oid,
                                label_name_str, label_id);
+
+    /* the loaded edges aren't logged, the graph needs to be reloaded */
+    invalidate_GRAPH_global_contexts(graph_oid);
     PG_RETURN_VOID();
 
 }
\ No newline at end of file
@@ -128,11 +128,24 @@ typedef struct cypher_merge
  * pattern
  */
 
+typedef enum
+{
+    CYPHER_PATH_ALL = 0, // every path that matches
+    CYPHER_PATH_SHORTEST = 1, // shortestPath()
+    CYPHER_PATH_ALL_SHORTEST = 2, // allShortestPaths()
+    CYPHER_PATH_REACHABLE = 3 // only whether there is a path, for EXISTS()
+} cypher_path_mode;
+
+/* the age_vle arguments that follow the VLE grammar node id */
+#define VLE_PATH_MODE_ARGNO 8
+#define VLE_ROW_BOUND_ARGNO 9
+
 typedef struct cypher_path
 {
     ExtensibleNode extensible;
     List *path; // [ node ( , relationship , node , ... ) ]
     char *var_name;
+    cypher_path_mode mode;
     int location;
 } cypher_path;
 
@@ -161,6 +174,7 @@ typedef struct cypher_relationship
     char *label;
     Node *props; // map or parameter
     Node *varlen; // variable length relationships (A_Indices)
+    Node *vle_vertex; // intermediate vertex pattern of a VLE (cypher_node)
     cypher_rel_dir dir;
     int location;
 } cypher_relationship;
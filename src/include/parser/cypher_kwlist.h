@@ -1,4 +1,5 @@
 PG_KEYWORD("all", ALL, RESERVED_KEYWORD)
+PG_KEYWORD("allshortestpaths", ALLSHORTESTPATHS, RESERVED_KEYWORD)
 PG_KEYWORD("analyze", ANALYZE, RESERVED_KEYWORD)
 PG_KEYWORD("and", AND, RESERVED_KEYWORD)
 PG_KEYWORD("as", AS, RESERVED_KEYWORD)
@@ -36,6 +37,7 @@ PG_KEYWORD("order", ORDER, RESERVED_KEYWORD)
 PG_KEYWORD("remove", REMOVE, RESERVED_KEYWORD)
 PG_KEYWORD("return", RETURN, RESERVED_KEYWORD)
 PG_KEYWORD("set", SET, RESERVED_KEYWORD)
+PG_KEYWORD("shortestpath", SHORTESTPATH, RESERVED_KEYWORD)
 PG_KEYWORD("skip", SKIP, RESERVED_KEYWORD)
 PG_KEYWORD("starts", STARTS, RESERVED_KEYWORD)
 PG_KEYWORD("then", THEN, RESERVED_KEYWORD)
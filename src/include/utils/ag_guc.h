@@ -0,0 +1,32 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef AG_AG_GUC_H
+#define AG_AG_GUC_H
+
+/* AGE configuration parameters, see ag_guc.c for their descriptions */
+extern bool age_enable_shared_global_graph;
+extern int age_global_graph_load_workers;
+extern bool age_global_graph_lazy_properties;
+extern int age_global_graph_memory_limit;
+extern int age_vle_local_context_cache_size;
+
+void define_config_params(void);
+
+#endif
@@ -20,6 +20,10 @@
 #ifndef AG_AGE_GLOBAL_GRAPH_H
 #define AG_AGE_GLOBAL_GRAPH_H
 
+#include "access/htup.h"
+#include "executor/tuptable.h"
+#include "utils/relcache.h"
+
 #include "utils/graphid.h"
 #include "utils/age_graphid_ds.h"
 
@@ -37,27 +41,81 @@ typedef struct edge_entry edge_entry;
 
 typedef struct GRAPH_global_context GRAPH_global_context;
 
+/* the edge lists of a vertex */
+typedef enum vertex_edge_direction
+{
+    VERTEX_EDGES_OUT,              /* exiting edges */
+    VERTEX_EDGES_IN,               /* entering edges */
+    VERTEX_EDGES_SELF,             /* selfloop edges */
+    NUM_VERTEX_EDGE_DIRECTIONS
+} vertex_edge_direction;
+
+/*
+ * One entry of a compressed sparse row (CSR) adjacency array. The edge is kept
+ * next to the dense index of the vertex at its other end.
+ */
+typedef struct adjacency_entry
+{
+    graphid edge_id;               /* the edge */
+    uint32 vertex_index;           /* the vertex at the other end of the edge */
+} adjacency_entry;
+
+/*
+ * Iterator over one edge list of a vertex. It walks the vertex's CSR entries
+ * and then any edges added to the graph after the CSR arrays were built.
+ */
+typedef struct vertex_edge_iterator
+{
+    GRAPH_global_context *ggctx;   /* the graph */
+    graphid vertex_id;             /* the vertex whose edges are iterated */
+    adjacency_entry *next_entry;   /* next CSR entry */
+    adjacency_entry *end_entry;    /* end of the vertex's CSR entries */
+    GraphIdNode *next_added;       /* next added edge */
+} vertex_edge_iterator;
+
 /* GRAPH global context functions */
 GRAPH_global_context *manage_GRAPH_global_contexts(char *graph_name,
                                                    Oid graph_oid);
 GRAPH_global_context *find_GRAPH_global_context(Oid graph_oid);
 bool is_ggctx_invalid(GRAPH_global_context *ggctx);
+int64 get_ggctx_version(GRAPH_global_context *ggctx);
+/* GRAPH global delta functions */
+void global_graph_hooks_init(void);
+void global_graph_hooks_fini(void);
+void log_GRAPH_global_insert(Relation label_relation, TupleTableSlot *slot);
+void log_GRAPH_global_update(Relation label_relation, TupleTableSlot *slot);
+void log_GRAPH_global_delete(Relation label_relation, HeapTuple tuple);
+void invalidate_GRAPH_global_contexts(Oid graph_oid);
+void delete_GRAPH_global_snapshot_file(Oid graph_oid);
+/* GRAPH global shared memory functions */
+void global_graph_shmem_init(void);
+void global_graph_shmem_fini(void);
+bool are_GRAPH_global_contexts_shared(void);
 /* GRAPH retrieval functions */
-ListGraphId *get_graph_vertices(GRAPH_global_context *ggctx);
 vertex_entry *get_vertex_entry(GRAPH_global_context *ggctx,
                                graphid vertex_id);
+vertex_entry *get_vertex_entry_by_index(GRAPH_global_context *ggctx,
+                                        uint32 vertex_index);
+uint32 get_ggctx_num_vertex_indexes(GRAPH_global_context *ggctx);
 edge_entry *get_edge_entry(GRAPH_global_context *ggctx, graphid edge_id);
 /* vertex entry accessor functions*/
 graphid get_vertex_entry_id(vertex_entry *ve);
-ListGraphId *get_vertex_entry_edges_in(vertex_entry *ve);
-ListGraphId *get_vertex_entry_edges_out(vertex_entry *ve);
-ListGraphId *get_vertex_entry_edges_self(vertex_entry *ve);
+uint32 get_vertex_entry_index(vertex_entry *ve);
+void init_vertex_edge_iterator(GRAPH_global_context *ggctx, vertex_entry *ve,
+                               vertex_edge_direction direction,
+                               vertex_edge_iterator *iterator);
+bool next_vertex_edge(vertex_edge_iterator *iterator, graphid *edge_id,
+                      graphid *vertex_id);
+int64 get_vertex_entry_degree(GRAPH_global_context *ggctx, vertex_entry *ve,
+                              vertex_edge_direction direction);
 Oid get_vertex_entry_label_table_oid(vertex_entry *ve);
 Datum get_vertex_entry_properties(vertex_entry *ve);
+void free_vertex_entry_properties(vertex_entry *ve, Datum properties);
 /* edge entry accessor functions */
 graphid get_edge_entry_id(edge_entry *ee);
 Oid get_edge_entry_label_table_oid(edge_entry *ee);
 Datum get_edge_entry_properties(edge_entry *ee);
+void free_edge_entry_properties(edge_entry *ee, Datum properties);
 graphid get_edge_entry_start_vertex_id(edge_entry *ee);
 graphid get_edge_entry_end_vertex_id(edge_entry *ee);
 #endif
@@ -58,6 +58,10 @@ GraphIdNode *peek_stack_head(ListGraphId *stack);
 GraphIdNode *peek_stack_tail(ListGraphId *stack);
 /* return the size of a ListGraphId stack */
 int64 get_stack_size(ListGraphId *stack);
+/* limit the memory of a ListGraphId stack, spilling to a file beyond it */
+void set_graphid_stack_mem_limit(ListGraphId *stack, int mem_limit_kb);
+/* return the number of bytes all ListGraphId stacks of this backend spilled */
+int64 get_graphid_stacks_spilled_bytes(void);
 
 /* graphid list functions */
 /*
@@ -65,6 +69,8 @@ int64 get_stack_size(ListGraphId *stack);
  * If the container is NULL, it creates the container with the entry.
  */
 ListGraphId *append_graphid(ListGraphId *container, graphid id);
+/* remove the first occurrence of a graphid from a ListGraphId container */
+bool remove_graphid(ListGraphId *container, graphid id);
 /* free a ListGraphId container */
 void free_ListGraphId(ListGraphId *container);
 /* return a reference to the head entry of a list */
@@ -46,4 +46,12 @@ agtype_value *agtv_materialize_vle_path(agtype *agt_arg_vpc);
  */
 agtype_value *agtv_materialize_vle_edges(agtype *agt_arg_vpc);
 
+/* VLE shared memory functions */
+void vle_shmem_init(void);
+void vle_shmem_fini(void);
+
+/* EXPLAIN hook functions */
+void vle_explain_hook_init(void);
+void vle_explain_hook_fini(void);
+
 #endif
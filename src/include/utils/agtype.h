@@ -532,6 +532,7 @@ void uniqueify_agtype_object(agtype_value *object);
 char *agtype_value_type_to_string(enum agtype_value_type type);
 bool is_decimal_needed(char *numstr);
 int compare_agtype_scalar_values(agtype_value *a, agtype_value *b);
+bool equals_agtype_scalar_value(const agtype_value *a, const agtype_value *b);
 agtype_value *alter_property_value(agtype_value *properties, char *var_name,
                                    agtype *new_v, bool remove_property);
 